@@ -41,6 +41,7 @@ void epicsThreadSleep(double secs);
 #define epicsMutexUnlock     semGive
 #define epicsMutexLockOK     OK
 #define epicsMutexLock(A)    semTake(A,WAIT_FOREVER)
+#define epicsMutexTryLock(A) semTake(A,NO_WAIT)
 /* For threads */
 #define epicsThreadId           int
  
@@ -67,3 +68,16 @@ void epicsThreadSleep(double secs);
 #endif
  
 #endif /* end 3.13 settings */
+
+/* Atomic access to int flags shared between threads without a lock:
+ * epicsAtomic from R3.15 on, before that a volatile access,
+ * which is atomic for an aligned int on the supported CPUs.
+ */
+#if EPICS_VERSION > 3  ||  (EPICS_VERSION == 3  &&  EPICS_REVISION >= 15)
+#  include "epicsAtomic.h"
+#  define EIP_atomic_get(V)   epicsAtomicGetIntT(&(V))
+#  define EIP_atomic_set(V,X) epicsAtomicSetIntT(&(V), (X))
+#else
+#  define EIP_atomic_get(V)   (*(volatile int *)&(V))
+#  define EIP_atomic_set(V,X) (*(volatile int *)&(V) = (X))
+#endif
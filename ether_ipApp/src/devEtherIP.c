@@ -8,6 +8,9 @@
  * kasemir@lanl.gov
  */
 
+/* Subsystem for EIP_printf */
+#define EIP_LOG_SUBSYSTEM EIP_LOG_DEVICE
+
 /* System */
 #include <stdlib.h>
 #include <stdio.h>
@@ -72,6 +75,7 @@ typedef enum
     SPCO_BIT                 = (1<<2),
     SPCO_FORCE               = (1<<3),
     SPCO_INDEX_INCLUDED      = (1<<4),
+    SPCO_SCAN_PHASE          = (1<<5),
     SPCO_PLC_ERRORS          = (1<<6),
     SPCO_PLC_TASK_SLOW       = (1<<7),
     SPCO_LIST_ERRORS         = (1<<8),
@@ -81,9 +85,25 @@ typedef enum
     SPCO_LIST_MAX_SCAN_TIME  = (1<<12),
     SPCO_TAG_TRANSFER_TIME   = (1<<13),
     SPCO_LIST_TIME           = (1<<14),
-    SPCO_INVALID             = (1<<15)
+    SPCO_INVALID             = (1<<15),
+    SPCO_PLC_CLOCK_OFFSET    = (1<<16),
+    SPCO_LIST_DATA_AGE       = (1<<17),
+    SPCO_LIST_MAX_DATA_AGE   = (1<<18),
+    SPCO_TAG_WRITE_QUEUE_TIME    = (1<<19),
+    SPCO_TAG_WRITE_TIME          = (1<<20),
+    SPCO_TAG_WRITE_CALLBACK_TIME = (1<<21),
+    SPCO_FIFO                    = (1<<22),
+    SPCO_TAG_WIRE_TRANSFER_TIME  = (1<<23),
+    SPCO_LIST_SYNC_SKEW          = (1<<24),
+    SPCO_PRIORITY                = (1<<25),
+    SPCO_AGGREGATE               = (1<<26),
+    SPCO_LATCH                   = (1<<27),
+    SPCO_EDGES                   = (1<<28)
 } SpecialOptions;
 
+/* Flags above SPCO_PLC_ERRORS that don't pick special values */
+#define SPCO_LINK_OPTIONS (SPCO_FIFO|SPCO_PRIORITY|SPCO_LATCH)
+
 static struct
 {
     const char *text;
@@ -92,6 +112,7 @@ static struct
 {
   { "E",                  SPCO_READ_SINGLE_ELEMENT }, /* Force a SCAN for a single element */
   { "S ",                 SPCO_SCAN_PERIOD        }, /* note <space> Set SCAN period for I/O */
+  { "P ",                 SPCO_SCAN_PHASE         }, /* note <space> Set phase within SCAN period */
   { "B ",                 SPCO_BIT                }, /* note <space>  Select Bit out of element */
   { "FORCE",              SPCO_FORCE              }, /* Force output records to write when!=tag */
   { "PLC_ERRORS",         SPCO_PLC_ERRORS         }, /* Connection error count for tag's PLC */
@@ -102,7 +123,20 @@ static struct
   { "LIST_MIN_SCAN_TIME", SPCO_LIST_MIN_SCAN_TIME }, /* min. of '' */
   { "LIST_MAX_SCAN_TIME", SPCO_LIST_MAX_SCAN_TIME }, /* max. of '' */
   { "TAG_TRANSFER_TIME",  SPCO_TAG_TRANSFER_TIME  }, /* Time for last round-trip data request */
+  { "TAG_WIRE_TRANSFER_TIME", SPCO_TAG_WIRE_TRANSFER_TIME }, /* '' per kernel time stamps */
   { "LIST_TIME",          SPCO_LIST_TIME          }, /* 3.14-# of seconds since 0000 Jan 1, 1990 */
+  { "PLC_CLOCK_OFFSET",   SPCO_PLC_CLOCK_OFFSET   }, /* PLC wall clock minus IOC clock */
+  { "LIST_DATA_AGE",      SPCO_LIST_DATA_AGE      }, /* Age of list's data per PLC time stamp */
+  { "LIST_MAX_DATA_AGE",  SPCO_LIST_MAX_DATA_AGE  }, /* max. of '' */
+  { "LIST_SYNC_SKEW",     SPCO_LIST_SYNC_SKEW     }, /* Send time spread of list's sync group */
+  { "TAG_WRITE_QUEUE_TIME",    SPCO_TAG_WRITE_QUEUE_TIME    }, /* Last write: record until sent */
+  { "TAG_WRITE_TIME",          SPCO_TAG_WRITE_TIME          }, /* Last write: round-trip */
+  { "TAG_WRITE_CALLBACK_TIME", SPCO_TAG_WRITE_CALLBACK_TIME }, /* Last write: response until callbacks done */
+  { "FIFO",               SPCO_FIFO               }, /* Drain PLC ring buffer: FIFO <index_tag> <size> */
+  { "PRIO",               SPCO_PRIORITY           }, /* Transfer before other tags of scan list */
+  { "AGG ",               SPCO_AGGREGATE          }, /* note <space> AGG <secs> MIN|MAX|MEAN|COUNT */
+  { "LATCH",              SPCO_LATCH              }, /* bi: 1 if bit was set since last processing */
+  { "EDGES",              SPCO_EDGES              }, /* ai: rising edges of bit since last processing */
   { "",                   0                       }, /*      when tag's list was checked */
 };
 
@@ -117,6 +151,15 @@ static struct
  * 1) element in the UDINT array
  * 2) mask then points to the bit inside that UDINT
  */
+/* Values of a driver aggregate that the AGG flag can select */
+typedef enum
+{
+    AGG_MIN,
+    AGG_MAX,
+    AGG_MEAN,
+    AGG_COUNT
+}   AggregateValue;
+
 typedef struct
 {
     char           *link_text;  /* Original text of INST_IO link  */
@@ -126,7 +169,14 @@ typedef struct
     CN_UDINT       mask;        /* For binaries: first bit of interest */
     SpecialOptions special;
     PLC            *plc;
-    TagInfo        *tag;
+    TagInfo        *tag;        /* for FIFO: the index tag */
+    EIPFifo        *fifo;
+    EIPAggregate   *aggregate;  /* for AGG: the driver's aggregate */
+    AggregateValue agg_value;   /* .. and which of its values to read */
+    eip_bool       latch_known; /* LATCH, EDGES: latch_last is valid, */
+    eip_bool       latch_last;  /* bit at last read by driver, */
+    eip_bool       latched;     /* bit was set since record processed, */
+    unsigned long  edges;       /* rising edges since record processed */
     IOSCANPVT      ioscanpvt;
 }   DevicePrivate;
 
@@ -160,7 +210,7 @@ static eip_bool lock_data(const dbCommon *rec)
             printf("devEtherIP lock_data (%s): no tag\n", rec->name);
         return false;
     }
-    if (epicsMutexLock(pvt->tag->data_lock) != epicsMutexLockOK)
+    if (EIP_lock_data(pvt->tag) != epicsMutexLockOK)
     {
         if (rec->sevr != INVALID_ALARM) /* don't flood w/ messages */
             printf("devEtherIP lock_data (%s): no lock\n", rec->name);
@@ -169,7 +219,7 @@ static eip_bool lock_data(const dbCommon *rec)
     if (pvt->tag->valid_data_size <= 0  ||
         pvt->tag->elements <= pvt->element)
     {
-        epicsMutexUnlock(pvt->tag->data_lock);
+        EIP_unlock_data(pvt->tag);
         if (rec->tpro &&
             rec->sevr != INVALID_ALARM) /* don't flood w/ messages */
             printf("devEtherIP lock_data (%s): no data\n", rec->name);
@@ -290,6 +340,17 @@ static eip_bool put_bits(dbCommon *rec, size_t bits, RVALTYPE rval)
     return true;
 }
 
+/* Helper for input records, data is locked:
+ * For "I/O Intr" records add delay since the driver
+ * received the data to the statistics
+ */
+static void add_update_delay(const dbCommon *rec, EIPRecordType type)
+{
+    DevicePrivate *pvt = (DevicePrivate *)rec->dpvt;
+    if (rec->scan == SCAN_IO_EVENT)
+        drvEtherIP_add_update_delay(pvt->tag, type);
+}
+
 /* Callback, registered with drvEtherIP, for input records.
  * Used _IF_ scan="I/O Event":
  * Driver has new value (or no value because of error), process record
@@ -303,6 +364,39 @@ static void scan_callback(void *arg)
     scanIoRequest(pvt->ioscanpvt);
 }
 
+/* Callback from driver for every received tag, for LATCH and EDGES:
+ * Accumulate the bit into the record's latch,
+ * the record consumes and clears it when processing.
+ * Both happen under the tag's data lock.
+ */
+static void latch_callback(void *arg)
+{
+    dbCommon      *rec = (dbCommon *) arg;
+    DevicePrivate *pvt = (DevicePrivate *)rec->dpvt;
+    RVALTYPE      bit;
+
+    if (lock_data(rec))
+    {
+        if (get_bits(rec, 1, &bit))
+        {
+            if (bit)
+            {
+                pvt->latched = true;
+                if (pvt->latch_known  &&  !pvt->latch_last)
+                    ++pvt->edges;
+            }
+            pvt->latch_last = bit ? true : false;
+            pvt->latch_known = true;
+        }
+        EIP_unlock_data(pvt->tag);
+    }
+    if (rec->tpro)
+        printf("EIP latch_callback('%s'): latched %d, %lu edges\n",
+               rec->name, (int)pvt->latched, pvt->edges);
+    if (rec->scan == SCAN_IO_EVENT)
+        scanIoRequest(pvt->ioscanpvt);
+}
+
 static void etherIP_scanOnce(void * pRec)
 {
     /*
@@ -737,8 +831,10 @@ static long analyze_link(dbCommon *rec,
 {
     DevicePrivate  *pvt = (DevicePrivate *)rec->dpvt;
     char           *p, *end;
-    size_t         i, tag_len, last_element, bit=0;
-    double         period = 0.0;
+    size_t         i, len, tag_len, last_element, bit=0;
+    long           fifo_size = 0;
+    char           fifo_index[EIP_MAX_TAG_LENGTH];
+    double         period = 0.0, phase = -1.0, agg_interval = 0.0;
     eip_bool       single_element = false;
 
     if (pvt->link_text)
@@ -815,10 +911,12 @@ static long analyze_link(dbCommon *rec,
         for (i=0;
              special_options[i].mask;
              ++i)
-        {
-            if (strncmp(p,
-                        special_options[i].text,
-                        strlen(special_options[i].text) ) == 0)
+        {   /* Match whole token, "E" must not match "EDGES".
+             * Flags with argument end in <space>, e.g. "S ".
+             */
+            len = strlen(special_options[i].text);
+            if (strncmp(p, special_options[i].text, len) == 0  &&
+                (special_options[i].text[len-1] == ' '  ||  p+len == end))
             {
                 pvt->special |= special_options[i].mask;
                 if (special_options[i].mask==SPCO_READ_SINGLE_ELEMENT)
@@ -844,6 +942,17 @@ static long analyze_link(dbCommon *rec,
                         return S_db_badField;
                     }
                 }
+                else if (special_options[i].mask==SPCO_SCAN_PHASE)
+                {
+                    phase = strtod(p+2, &end);
+                    if (end==p+2 || phase < 0.0 || phase==HUGE_VAL)
+                    {
+                        errlogPrintf("devEtherIP (%s): "
+                                     "Error in phase flag in link '%s'\n",
+                                     rec->name, pvt->link_text);
+                        return S_db_badField;
+                    }
+                }
                 else if (special_options[i].mask==SPCO_BIT)
                 {
                     bit = strtod(p+2, &end);
@@ -855,6 +964,63 @@ static long analyze_link(dbCommon *rec,
                         return S_db_badField;
                     }
                 }
+                else if (special_options[i].mask==SPCO_FIFO)
+                {   /* FIFO <index_tag> <size> */
+                    p = find_token(end, &end);
+                    if (p  &&  end-p < (int)sizeof(fifo_index))
+                    {
+                        memcpy(fifo_index, p, end-p);
+                        fifo_index[end-p] = '\0';
+                        p = find_token(end, &end);
+                    }
+                    else
+                        p = 0;
+                    if (p)
+                        fifo_size = strtol(p, 0, 0);
+                    if (cbtype != scan_callback  ||  !p  ||  fifo_size <= 0)
+                    {
+                        errlogPrintf("devEtherIP (%s): "
+                                     "Error in FIFO flag in link '%s'\n",
+                                     rec->name, pvt->link_text);
+                        return S_db_badField;
+                    }
+                }
+                else if (special_options[i].mask==SPCO_LATCH  ||
+                         special_options[i].mask==SPCO_EDGES)
+                {   /* LATCH for bi, EDGES for ai, both single bits */
+                    if (cbtype != scan_callback  ||  count != 1  ||
+                        bits != (special_options[i].mask==SPCO_LATCH ? 1 : 0))
+                    {
+                        errlogPrintf("devEtherIP (%s): "
+                                     "Cannot use flag '%s' in link '%s'\n",
+                                     rec->name, special_options[i].text,
+                                     pvt->link_text);
+                        return S_db_badField;
+                    }
+                }
+                else if (special_options[i].mask==SPCO_AGGREGATE)
+                {   /* AGG <secs> MIN|MAX|MEAN|COUNT */
+                    agg_interval = strtod(p+4, &end);
+                    p = (end==p+4) ? 0 : find_token(end, &end);
+                    if (p  &&  end-p==3  &&  strncmp(p, "MIN", 3)==0)
+                        pvt->agg_value = AGG_MIN;
+                    else if (p  &&  end-p==3  &&  strncmp(p, "MAX", 3)==0)
+                        pvt->agg_value = AGG_MAX;
+                    else if (p  &&  end-p==4  &&  strncmp(p, "MEAN", 4)==0)
+                        pvt->agg_value = AGG_MEAN;
+                    else if (p  &&  end-p==5  &&  strncmp(p, "COUNT", 5)==0)
+                        pvt->agg_value = AGG_COUNT;
+                    else
+                        p = 0;
+                    if (cbtype != scan_callback  ||  count != 1  ||  bits > 0  ||
+                        !p  ||  agg_interval <= 0.0  ||  agg_interval==HUGE_VAL)
+                    {
+                        errlogPrintf("devEtherIP (%s): "
+                                     "Error in AGG flag in link '%s'\n",
+                                     rec->name, pvt->link_text);
+                        return S_db_badField;
+                    }
+                }
                 break;
             }
         }
@@ -959,6 +1125,32 @@ static long analyze_link(dbCommon *rec,
         pvt->mask = 1U << bit;
     }
 
+    if (pvt->special & SPCO_FIFO)
+    {   /* tell driver to read the index and drain the FIFO */
+        pvt->fifo = drvEtherIP_add_fifo(pvt->plc, period, pvt->string_tag,
+                                        fifo_index, fifo_size, rec);
+        if (! pvt->fifo)
+        {
+            errlogPrintf("devEtherIP (%s): cannot register FIFO '%s'\n",
+                         rec->name, pvt->string_tag);
+            return S_db_badField;
+        }
+        pvt->tag = pvt->fifo->index;
+        if (pvt->special & SPCO_PRIORITY)
+            drvEtherIP_set_priority(pvt->plc, pvt->tag);
+        if (phase >= 0.0)
+            drvEtherIP_scanlist_phase(pvt->PLC_name,
+                                      pvt->tag->scanlist->period, phase);
+        if (rec->scan == SCAN_IO_EVENT)
+            drvEtherIP_add_fifo_callback(pvt->plc, pvt->fifo,
+                                         scan_callback, rec);
+        else
+            drvEtherIP_remove_fifo_callback(pvt->plc, pvt->fifo,
+                                            scan_callback, rec);
+        return 0;
+    }
+    pvt->fifo = 0;
+
     /* tell driver to read up to this record's elements */
     pvt->tag = drvEtherIP_add_tag(pvt->plc, period,
                                   pvt->string_tag,
@@ -969,8 +1161,40 @@ static long analyze_link(dbCommon *rec,
                      rec->name, pvt->string_tag);
         return S_db_badField;
     }
+    if (pvt->special & SPCO_PRIORITY)
+        drvEtherIP_set_priority(pvt->plc, pvt->tag);
+    if (phase >= 0.0)
+        drvEtherIP_scanlist_phase(pvt->PLC_name,
+                                  pvt->tag->scanlist->period, phase);
+
+    pvt->aggregate = 0;
+    if (pvt->special & SPCO_AGGREGATE)
+    {   /* driver accumulates each read, record gets the published values */
+        pvt->aggregate = drvEtherIP_add_aggregate(pvt->plc, pvt->tag,
+                                                  pvt->element, agg_interval);
+        if (! pvt->aggregate)
+        {
+            errlogPrintf("devEtherIP (%s): cannot register aggregate '%s'\n",
+                         rec->name, pvt->string_tag);
+            return S_db_badField;
+        }
+        if (rec->scan == SCAN_IO_EVENT)
+            drvEtherIP_add_aggregate_callback(pvt->plc, pvt->aggregate,
+                                              scan_callback, rec);
+        else
+            drvEtherIP_remove_aggregate_callback(pvt->plc, pvt->aggregate,
+                                                 scan_callback, rec);
+        return 0;
+    }
 
-    if (cbtype == scan_callback)
+    if (pvt->special & (SPCO_LATCH | SPCO_EDGES))
+    {   /* latch every read, latch_callback handles I/O Intr */
+        pvt->latch_known = pvt->latch_last = pvt->latched = false;
+        pvt->edges = 0;
+        drvEtherIP_remove_callback(pvt->plc, pvt->tag, scan_callback, rec);
+        drvEtherIP_add_callback(pvt->plc, pvt->tag, latch_callback, rec);
+    }
+    else if (cbtype == scan_callback)
     {   /* scan_callback only allowed for SCAN=I/O Intr */
         if (rec->scan == SCAN_IO_EVENT)
             drvEtherIP_add_callback(pvt->plc, pvt->tag,
@@ -1004,8 +1228,18 @@ static long check_link(dbCommon *rec, EIPCallback cbtype,
             printf("Rec '%s': EtherIP link has changed, restarting\n",
                    rec->name);
         rec->udf = TRUE;
-        if (pvt->plc && pvt->tag)
+        if (pvt->plc && pvt->fifo)
+            drvEtherIP_remove_fifo_callback(pvt->plc, pvt->fifo, cbtype, rec);
+        else if (pvt->plc && pvt->aggregate)
+            drvEtherIP_remove_aggregate_callback(pvt->plc, pvt->aggregate,
+                                                 cbtype, rec);
+        else if (pvt->plc && pvt->tag)
+        {
+            if (pvt->special & (SPCO_LATCH | SPCO_EDGES))
+                drvEtherIP_remove_callback(pvt->plc, pvt->tag,
+                                           latch_callback, rec);
             drvEtherIP_remove_callback(pvt->plc, pvt->tag, cbtype, rec);
+        }
         status = analyze_link(rec, cbtype, link, count, bits);
         if (status)
             return status;
@@ -1031,7 +1265,12 @@ static long init(int run)
 static long init_record(dbCommon *rec, EIPCallback cbtype,
                         const DBLINK *link, size_t count, size_t bits)
 {
-    DevicePrivate *pvt = calloc (sizeof (DevicePrivate), 1);
+    epicsTimeStamp start;
+    long status;
+    DevicePrivate *pvt;
+
+    epicsTimeGetCurrent(&start);
+    pvt = calloc (sizeof (DevicePrivate), 1);
     if (! pvt)
     {
         errlogPrintf("devEtherIP (%s): cannot allocate DPVT\n", rec->name);
@@ -1045,7 +1284,9 @@ static long init_record(dbCommon *rec, EIPCallback cbtype,
     scanIoInit(&pvt->ioscanpvt);
     rec->dpvt = pvt;
 
-    return analyze_link(rec, cbtype, link, count, bits);
+    status = analyze_link(rec, cbtype, link, count, bits);
+    drvEtherIP_boot_phase(EIP_BOOT_LINK, &start);
+    return status;
 }
 
 static long ai_init_record(aiRecord *rec)
@@ -1148,8 +1389,9 @@ static long ai_read(aiRecord *rec)
     if ((ok = lock_data((dbCommon *)rec)))
     {
         /* Most common case: ai reads a tag from PLC */
-        if (pvt->special < SPCO_PLC_ERRORS)
+        if ((pvt->special & ~SPCO_LINK_OPTIONS) < SPCO_PLC_ERRORS)
         {
+            add_update_delay((dbCommon *)rec, EIP_REC_AI);
             if (pvt->tag->valid_data_size>0 && pvt->tag->elements>pvt->element)
             {
                 if (get_CIP_typecode(pvt->tag->data) == T_CIP_REAL)
@@ -1192,10 +1434,45 @@ static long ai_read(aiRecord *rec)
                 rec->val = pvt->tag->scanlist->max_scan_time;
             else if (pvt->special & SPCO_TAG_TRANSFER_TIME)
                 rec->val = pvt->tag->transfer_time;
+            else if (pvt->special & SPCO_PLC_CLOCK_OFFSET)
+                rec->val = pvt->plc->clock_offset;
+            else if (pvt->special & SPCO_LIST_DATA_AGE)
+                rec->val = pvt->tag->scanlist->data_age;
+            else if (pvt->special & SPCO_LIST_MAX_DATA_AGE)
+                rec->val = pvt->tag->scanlist->max_data_age;
+            else if (pvt->special & SPCO_TAG_WRITE_QUEUE_TIME)
+                rec->val = pvt->tag->write_queue_time;
+            else if (pvt->special & SPCO_TAG_WRITE_TIME)
+                rec->val = pvt->tag->write_transfer_time;
+            else if (pvt->special & SPCO_TAG_WRITE_CALLBACK_TIME)
+                rec->val = pvt->tag->write_callback_time;
+            else if (pvt->special & SPCO_TAG_WIRE_TRANSFER_TIME)
+                rec->val = pvt->tag->wire_time;
+            else if ((pvt->special & SPCO_LIST_SYNC_SKEW)  &&
+                     pvt->tag->scanlist->sync)
+                rec->val = pvt->tag->scanlist->sync->skew;
+            else if (pvt->special & SPCO_EDGES)
+            {   /* consume edges counted since last time */
+                rec->val = (double) pvt->edges;
+                pvt->edges = 0;
+            }
+            else if (pvt->special & SPCO_AGGREGATE)
+            {
+                if (pvt->agg_value == AGG_COUNT)
+                    rec->val = (double) pvt->aggregate->pub_count;
+                else if (pvt->aggregate->pub_count == 0)
+                    ok = false; /* no reads in the last interval */
+                else if (pvt->agg_value == AGG_MIN)
+                    rec->val = pvt->aggregate->pub_min;
+                else if (pvt->agg_value == AGG_MAX)
+                    rec->val = pvt->aggregate->pub_max;
+                else
+                    rec->val = pvt->aggregate->pub_mean;
+            }
             else
                 ok = false;
         }
-        epicsMutexUnlock(pvt->tag->data_lock);
+        EIP_unlock_data(pvt->tag);
     }
     if (ok)
         rec->udf = FALSE;
@@ -1220,8 +1497,15 @@ static long bi_read(biRecord *rec)
     }
     if (lock_data((dbCommon *)rec))
     {
+        add_update_delay((dbCommon *)rec, EIP_REC_BI);
         ok = get_bits((dbCommon *)rec, 1, &rec->rval);
-        epicsMutexUnlock(pvt->tag->data_lock);
+        if (ok  &&  (pvt->special & SPCO_LATCH))
+        {   /* consume what was latched since last time */
+            if (pvt->latched)
+                rec->rval = 1;
+            pvt->latched = false;
+        }
+        EIP_unlock_data(pvt->tag);
     }
     else
         ok = false;
@@ -1249,8 +1533,9 @@ static long mbbi_read (mbbiRecord *rec)
     }
     if (lock_data((dbCommon *)rec))
     {
+        add_update_delay((dbCommon *)rec, EIP_REC_MBBI);
         ok = get_bits((dbCommon *)rec, rec->nobt, &rec->rval);
-        epicsMutexUnlock(pvt->tag->data_lock);
+        EIP_unlock_data(pvt->tag);
     }
     else
         ok = false;
@@ -1278,8 +1563,9 @@ static long mbbi_direct_read (mbbiDirectRecord *rec)
     }
     if (lock_data((dbCommon *)rec))
     {
+        add_update_delay((dbCommon *)rec, EIP_REC_MBBI_DIRECT);
         ok = get_bits((dbCommon *)rec, rec->nobt, &rec->rval);
-        epicsMutexUnlock(pvt->tag->data_lock);
+        EIP_unlock_data(pvt->tag);
     }
     else
         ok = false;
@@ -1306,8 +1592,9 @@ static long si_read(stringinRecord *rec)
     }
     if (lock_data((dbCommon *)rec))
     {
+        add_update_delay((dbCommon *)rec, EIP_REC_STRINGIN);
         ok = get_CIP_STRING(pvt->tag->data, &rec->val[0], MAX_STRING_SIZE);
-        epicsMutexUnlock(pvt->tag->data_lock);
+        EIP_unlock_data(pvt->tag);
     }
     else
         ok = false;
@@ -1318,6 +1605,56 @@ static long si_read(stringinRecord *rec)
     return status;
 }
 
+/* Waveform with FIFO flag: Get up to NELM of the elements
+ * that the driver read from the PLC's ring buffer.
+ * Processes again via I/O Intr while more elements are left.
+ */
+static long wf_read_fifo(waveformRecord *rec)
+{
+    DevicePrivate *pvt = (DevicePrivate *)rec->dpvt;
+    EIPFifo       *fifo = pvt->fifo;
+    size_t        n;
+    eip_bool      ok = true, more = false;
+
+    if (! lock_data((dbCommon *)rec))
+    {
+        recGblSetSevr(rec,READ_ALARM,INVALID_ALARM);
+        return 0;
+    }
+    add_update_delay((dbCommon *)rec, EIP_REC_WAVEFORM);
+    n = fifo->elements < rec->nelm ? fifo->elements : rec->nelm;
+    if (n > 0)
+    {
+        if (rec->ftvl == menuFtypeDOUBLE)
+            ok = get_CIP_double_array(fifo->data, 0, n, (double *)rec->bptr);
+        else if (rec->ftvl == menuFtypeLONG)
+            ok = get_CIP_DINT_array(fifo->data, 0, n, (CN_DINT *)rec->bptr);
+        else if ((rec->ftvl == menuFtypeCHAR || rec->ftvl == menuFtypeUCHAR)
+                 && get_CIP_typecode(fifo->data) == T_CIP_SINT)
+            ok = get_CIP_USINT_array(fifo->data, 0, n, (CN_USINT *)rec->bptr);
+        else
+        {
+            recGblRecordError(S_db_badField, (void *)rec,
+                              "EtherIP: FIFO requires "
+                              "waveform FTVL==DOUBLE, LONG or CHAR for SINT");
+            ok = false;
+        }
+    }
+    if (ok)
+    {
+        rec->nord = n;
+        drvEtherIP_fifo_consume(fifo, n);
+        more = fifo->elements > 0;
+        rec->udf = FALSE;
+    }
+    EIP_unlock_data(pvt->tag);
+    if (!ok)
+        recGblSetSevr(rec,READ_ALARM,INVALID_ALARM);
+    else if (more  &&  rec->scan == SCAN_IO_EVENT)
+        scanIoRequest(pvt->ioscanpvt);
+    return 0;
+}
+
 static long wf_read(waveformRecord *rec)
 {
     DevicePrivate *pvt = (DevicePrivate *)rec->dpvt;
@@ -1339,8 +1676,11 @@ static long wf_read(waveformRecord *rec)
         recGblSetSevr(rec,READ_ALARM,INVALID_ALARM);
         return status;
     }
+    if (pvt->fifo)
+        return wf_read_fifo(rec);
     if ((ok = lock_data((dbCommon *)rec)))
     {
+        add_update_delay((dbCommon *)rec, EIP_REC_WAVEFORM);
         if (pvt->tag->valid_data_size > 0 &&  pvt->tag->elements >= rec->nelm)
         {
             if (get_CIP_typecode(pvt->tag->data) == T_CIP_REAL)
@@ -1348,8 +1688,8 @@ static long wf_read(waveformRecord *rec)
                 if (rec->ftvl == menuFtypeDOUBLE)
                 {
                     dbl = (double *)rec->bptr;
-                    for (i=0; ok && i<rec->nelm; ++i, ++dbl)
-                        ok = get_CIP_double(pvt->tag->data, i, dbl);
+                    ok = get_CIP_double_array(pvt->tag->data, 0,
+                                              rec->nelm, dbl);
                     if (ok)
                         rec->nord = rec->nelm;
                 }
@@ -1366,8 +1706,8 @@ static long wf_read(waveformRecord *rec)
                 if (rec->ftvl == menuFtypeCHAR || rec->ftvl == menuFtypeUCHAR)
                 {
                     c = (char *)rec->bptr;
-                    for (i=0; ok && i<rec->nelm; ++i, ++c)
-                        ok = get_CIP_USINT(pvt->tag->data, i, (CN_USINT*)c);
+                    ok = get_CIP_USINT_array(pvt->tag->data, 0,
+                                             rec->nelm, (CN_USINT*)c);
                     if (ok)
                         rec->nord = rec->nelm;
                 }
@@ -1384,8 +1724,8 @@ static long wf_read(waveformRecord *rec)
                 if (rec->ftvl == menuFtypeLONG)
                 {
                     dint = (CN_DINT *)rec->bptr;
-                    for (i=0; ok && i<rec->nelm; ++i, ++dint)
-                        ok = get_CIP_DINT(pvt->tag->data, i, dint);
+                    ok = get_CIP_DINT_array(pvt->tag->data, 0,
+                                            rec->nelm, dint);
                     if (ok)
                         rec->nord = rec->nelm;
                 }
@@ -1409,7 +1749,7 @@ static long wf_read(waveformRecord *rec)
                 }
             }
         }
-        epicsMutexUnlock(pvt->tag->data_lock);
+        EIP_unlock_data(pvt->tag);
     }
     if (!ok)
         recGblSetSevr(rec,READ_ALARM,INVALID_ALARM);
@@ -1449,10 +1789,13 @@ static long ao_write(aoRecord *rec)
                 if (rec->tpro)
                     printf("'%s': write %g!\n", rec->name, rec->val);
                 ok = put_CIP_double(pvt->tag->data, pvt->element, rec->val);
-                if (pvt->tag->do_write)
+                if (EIP_atomic_get(pvt->tag->do_write))
                     EIP_printf(6,"'%s': already writing\n", rec->name);
                 else
-                    pvt->tag->do_write = true;
+                {
+                    EIP_atomic_set(pvt->tag->do_write, true);
+                    epicsTimeGetCurrent(&pvt->tag->write_request_time);
+                }
                 rec->pact=TRUE;
             }
         }
@@ -1465,14 +1808,17 @@ static long ao_write(aoRecord *rec)
                     printf("'%s': write %ld (0x%lX)!\n",
                            rec->name, (long)rec->rval, (long)rec->rval);
                 ok = put_CIP_DINT(pvt->tag->data, pvt->element, rec->rval);
-                if (pvt->tag->do_write)
+                if (EIP_atomic_get(pvt->tag->do_write))
                     EIP_printf(6,"'%s': already writing\n", rec->name);
                 else
-                    pvt->tag->do_write = true;
+                {
+                    EIP_atomic_set(pvt->tag->do_write, true);
+                    epicsTimeGetCurrent(&pvt->tag->write_request_time);
+                }
                 rec->pact=TRUE;
             }
         }
-        epicsMutexUnlock(pvt->tag->data_lock);
+        EIP_unlock_data(pvt->tag);
     }
     else
         ok = false;
@@ -1514,14 +1860,17 @@ static long bo_write(boRecord *rec)
                 if (rec->tpro)
                     printf("'%s': write %"RVALFMT"\n", rec->name, rec->rval);
                 ok = put_bits((dbCommon *)rec, 1, rec->rval);
-                if (pvt->tag->do_write)
+                if (EIP_atomic_get(pvt->tag->do_write))
                     EIP_printf(6,"'%s': already writing\n", rec->name);
                 else
-                    pvt->tag->do_write = true;
+                {
+                    EIP_atomic_set(pvt->tag->do_write, true);
+                    epicsTimeGetCurrent(&pvt->tag->write_request_time);
+                }
                 rec->pact=TRUE;
             }
         }
-        epicsMutexUnlock(pvt->tag->data_lock);
+        EIP_unlock_data(pvt->tag);
     }
     else
         ok = false;
@@ -1562,13 +1911,16 @@ static long mbbo_write (mbboRecord *rec)
             if (rec->tpro)
                 printf("'%s': write %"RVALFMT"\n", rec->name, rec->rval);
             ok = put_bits((dbCommon *)rec, rec->nobt, rec->rval);
-            if (pvt->tag->do_write)
+            if (EIP_atomic_get(pvt->tag->do_write))
                 EIP_printf(6,"'%s': already writing\n", rec->name);
             else
-                pvt->tag->do_write = true;
+            {
+                EIP_atomic_set(pvt->tag->do_write, true);
+                epicsTimeGetCurrent(&pvt->tag->write_request_time);
+            }
             rec->pact=TRUE;
         }
-        epicsMutexUnlock(pvt->tag->data_lock);
+        EIP_unlock_data(pvt->tag);
     }
     else
         ok = false;
@@ -1609,13 +1961,16 @@ static long mbbo_direct_write (mbboDirectRecord *rec)
             if (rec->tpro)
                 printf("'%s': write %"RVALFMT"\n", rec->name, rec->rval);
             ok = put_bits((dbCommon *)rec, rec->nobt, rec->rval);
-            if (pvt->tag->do_write)
+            if (EIP_atomic_get(pvt->tag->do_write))
                 EIP_printf(6,"'%s': already writing\n", rec->name);
             else
-                pvt->tag->do_write = true;
+            {
+                EIP_atomic_set(pvt->tag->do_write, true);
+                epicsTimeGetCurrent(&pvt->tag->write_request_time);
+            }
             rec->pact=TRUE;
         }
-        epicsMutexUnlock(pvt->tag->data_lock);
+        EIP_unlock_data(pvt->tag);
     }
     else
         ok = false;
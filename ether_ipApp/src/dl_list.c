@@ -15,3 +15,23 @@ void *DLL_decap (DL_List *list)
     return node;
 }
 
+/* Insert node before 'before', at end of list if 'before' is 0 */
+void DLL_insert_before (DL_List *list, void *node, void *before)
+{
+    DLL_Node *n = (DLL_Node *) node;
+    DLL_Node *b = (DLL_Node *) before;
+
+    if (! b)
+    {
+        DLL_append(list, n);
+        return;
+    }
+    n->next = b;
+    n->prev = (list->first == b) ? 0 : b->prev;
+    if (n->prev)
+        n->prev->next = n;
+    else
+        list->first = n;
+    b->prev = n;
+}
+
@@ -64,6 +64,9 @@ typedef struct
  */
 void *DLL_decap (DL_List *list);
 
+/* Insert node before 'before', at end of list if 'before' is 0 */
+void DLL_insert_before (DL_List *list, void *node, void *before);
+
 #endif
 
 
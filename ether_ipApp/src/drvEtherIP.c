@@ -8,11 +8,29 @@
  * kasemirk@ornl.gov
  */
 
+/* Subsystem for EIP_printf */
+#define EIP_LOG_SUBSYSTEM EIP_LOG_PLANNER
+
 /* System */
+#if defined(__linux__)  &&  !defined(_GNU_SOURCE)
+/* for CPU_SET, pthread_setaffinity_np */
+#define _GNU_SOURCE
+#endif
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <math.h>
+#ifdef __linux__
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#ifndef _WIN32
+#include <dirent.h>
+#endif
 /* Base */
 #include <drvSup.h>
 #include <errlog.h>
@@ -29,7 +47,35 @@ static int databaseIsReady = false;
 
 double drvEtherIP_default_rate = 0.0;
 
-DrvEtherIP_Private drvEtherIP_private = { {NULL, NULL}, 0 };
+/* See drvEtherIP_cluster(): New PLCs wait for the cluster to assign them */
+static eip_bool cluster_active = false;
+
+double drvEtherIP_clock_period = 0.0;
+
+double drvEtherIP_change_period = 0.0;
+
+int drvEtherIP_forbid_scan_alloc = 0;
+
+int drvEtherIP_lock_stats = 0;
+
+int drvEtherIP_stagger = 0;
+
+double drvEtherIP_sync_lead = 0.002;
+
+int drvEtherIP_congestion = 1;
+
+int drvEtherIP_read_after_write = 0;
+
+double drvEtherIP_congestion_latency = 0.0;
+
+DrvEtherIP_Private drvEtherIP_private =
+{
+    {NULL, NULL},       /* PLCs */
+    {NULL, NULL},       /* sync_groups */
+    0,                  /* lock */
+    { 0 },              /* lock_stats, guarded by lock itself */
+    { { 0, 0 }, 0 }     /* lock_hold */
+};
 
 /* Locking:
  *
@@ -68,31 +114,242 @@ DrvEtherIP_Private drvEtherIP_private = { {NULL, NULL}, 0 };
  *    But the device might want to switch from read to write.
  *    In the protocol, the "CIP Read Data" and "CIP Write Data"
  *    request/response are different in length.
- *    So the do_write flag is checked in a), the driver has to
- *    know in b and c) if this is a write access.
- *    -> write behavior must not change across a->c.
+ *    So the driver has to know in a), b) and c) if this is a write
+ *    access -> write behavior must not change across a->c.
  *    The network transfer between b) and c) takes time,
  *    so we avoid locking the data and do_write flag all that time
- *    from a) to c). Instead, the lock is released after b) and
- *    taken again in c).
+ *    from a) to c).
+ *
+ *    Only device support sets do_write, only the driver clears it,
+ *    and is_writing is only used by the driver.
+ *    do_write is always accessed via EIP_atomic_get/set,
+ *    so reading it without the lock is well defined.
+ *    So a) checks do_write without taking the data lock and
+ *    sets is_writing: Once a) sees do_write set, it's still
+ *    set in b). For a write, b) takes the data lock once to clear
+ *    do_write and to copy the data into the request.
+ *    A read request needs no lock.
  *    Data is locked in c) to keep the device from looking at
- *    immature data. The driver keeps the state of do_write from a)
- *    in is_writing. If the device sets do_write after a), it's
- *    ignored until the next scan. (Otherwise the device would
- *    be locked until the next scan!)
+ *    immature data. If the device sets do_write after a),
+ *    a read response is ignored and the write happens in the
+ *    next scan. (Otherwise the device would be locked until
+ *    the next scan!)
+ *    So each tag's data lock is taken once per read cycle,
+ *    twice per write cycle.
  *
  * do_write   is_writing
  *    1           0       -> Device support requested write
- *    0           1       -> Driver noticed the write request,
+ *    1           1       -> Driver noticed the write request,
  *    0           1       -> sends it
  *    0           0       -> Driver received write result from PLC
+ *
+ * 4) PLC.stats_lock is only held while updating or reading
+ *    statistics that device support adds, so it's always
+ *    taken last.
+ *    EIPSyncGroup.lock is likewise only held for the group's
+ *    statistics, never together with a PLC.stats_lock.
+ *    The statistics export only try-locks the PLC lock,
+ *    and holds its stats_cache_lock without any other lock.
+ *
+ * The first three are taken via EIP_lock_driver, EIP_lock_PLC
+ * and EIP_lock_data, which add statistics when drvEtherIP_lock_stats
+ * is set. Statistics of the driver and PLC locks are protected by
+ * the lock itself, those of the data locks by PLC.stats_lock.
  */
 
+/* ------------------------------------------------------------
+ * Lock statistics
+ * ------------------------------------------------------------ */
+#ifdef HAVE_314_API
+epicsMutexLockStatus drvEtherIP_lock(epicsMutexId lock, EIPLockStats *stats,
+                                     EIPLockHold *hold)
+{
+    epicsMutexLockStatus status;
+    epicsTimeStamp       start;
+    eip_bool             waited = false;
+
+    if (! stats)
+        return epicsMutexLock(lock);
+    status = epicsMutexTryLock(lock);
+    if (status != epicsMutexLockOK)
+    {   /* Contended, time the wait */
+        epicsTimeGetCurrent(&start);
+        status = epicsMutexLock(lock);
+        waited = true;
+    }
+    if (status != epicsMutexLockOK)
+        return status;
+    /* Nested lock by the owner: Keep timing the outermost one */
+    if (hold->depth++ > 0)
+        return status;
+    epicsTimeGetCurrent(&hold->since);
+    if (stats->guard)
+        epicsMutexLock(stats->guard);
+    ++stats->count;
+    if (waited)
+    {
+        ++stats->contended;
+        drvEtherIP_histogram_add(&stats->wait_histo,
+                                 epicsTimeDiffInSeconds(&hold->since, &start));
+    }
+    if (stats->guard)
+        epicsMutexUnlock(stats->guard);
+    return status;
+}
+
+void drvEtherIP_unlock(epicsMutexId lock, EIPLockStats *stats,
+                       EIPLockHold *hold)
+{
+    epicsTimeStamp now;
+    double         held;
+
+    /* Lock might have been taken before statistics were enabled,
+     * then depth is 0.
+     */
+    if (hold->depth > 0  &&  --hold->depth == 0  &&  stats)
+    {
+        epicsTimeGetCurrent(&now);
+        held = epicsTimeDiffInSeconds(&now, &hold->since);
+        if (stats->guard)
+            epicsMutexLock(stats->guard);
+        if (held > stats->max_hold)
+            stats->max_hold = held;
+        if (stats->guard)
+            epicsMutexUnlock(stats->guard);
+    }
+    epicsMutexUnlock(lock);
+}
+#endif
+
+static void show_lock_stats(const char *name, const EIPLockStats *stats)
+{
+    if (stats->count <= 0)
+        return;
+    printf("  %-12s %10lu %6.2f%% %10.6f %10.6f %10.6f %10.6f\n",
+           name, (unsigned long)stats->count,
+           100.0 * stats->contended / stats->count,
+           drvEtherIP_histogram_percentile(&stats->wait_histo, 0.5),
+           drvEtherIP_histogram_percentile(&stats->wait_histo, 0.99),
+           stats->wait_histo.max, stats->max_hold);
+}
+
+void drvEtherIP_lock_report()
+{
+    PLC          *plc;
+    EIPLockStats driver, plc_lock, data_lock;
+
+    if (drvEtherIP_private.lock == 0)
+    {
+        printf("drvEtherIP lock is 0, did you call drvEtherIP_init?\n");
+        return;
+    }
+    if (! drvEtherIP_lock_stats)
+        printf("Lock statistics are disabled, "
+               "set drvEtherIP_lock_stats=1 to enable\n");
+    printf("Lock statistics, wait times when contended [secs]\n");
+    printf("                    count  waited    50%%        99%%"
+           "        max   max held\n");
+    EIP_lock_driver();
+    driver = drvEtherIP_private.lock_stats;
+    printf("* Driver\n");
+    show_lock_stats("driver", &driver);
+    for (plc = DLL_first(PLC,&drvEtherIP_private.PLCs);
+         plc;  plc = DLL_next(PLC,plc))
+    {
+        EIP_lock_PLC(plc);
+        plc_lock = plc->lock_stats;
+        epicsMutexLock(plc->stats_lock);
+        data_lock = plc->data_lock_stats;
+        epicsMutexUnlock(plc->stats_lock);
+        EIP_unlock_PLC(plc);
+        printf("* PLC '%s'\n", plc->name);
+        show_lock_stats("PLC", &plc_lock);
+        show_lock_stats("tag data", &data_lock);
+    }
+    EIP_unlock_driver();
+}
+
+/* Clear statistics but keep the guard */
+static void reset_lock_stats(EIPLockStats *stats)
+{
+    epicsMutexId guard = stats->guard;
+    memset(stats, 0, sizeof(EIPLockStats));
+    stats->guard = guard;
+}
+
+/* ------------------------------------------------------------
+ * Histogram
+ * ------------------------------------------------------------ */
+void drvEtherIP_histogram_add(EIPHistogram *histo, double secs)
+{
+    size_t i;
+    double limit = EIP_HISTO_BASE;
+
+    for (i=0; i<EIP_HISTO_BINS-1; ++i)
+    {
+        if (secs < limit)
+            break;
+        limit *= 2;
+    }
+    ++histo->bins[i];
+    ++histo->count;
+    histo->total += secs;
+    if (secs > histo->max)
+        histo->max = secs;
+}
+
+void drvEtherIP_histogram_report(const char *title, const EIPHistogram *histo)
+{
+    size_t i;
+    double limit = EIP_HISTO_BASE;
+
+    if (histo->count <= 0)
+    {
+        printf("  %-22s: -no samples-\n", title);
+        return;
+    }
+    printf("  %-22s: %lu samples, average %g, max %g secs\n", title,
+           (unsigned long)histo->count, histo->total/histo->count, histo->max);
+    for (i=0; i<EIP_HISTO_BINS; ++i)
+    {
+        if (histo->bins[i] > 0)
+        {
+            if (i < EIP_HISTO_BINS-1)
+                printf("      < %8.4f secs: %lu\n",
+                       limit, (unsigned long)histo->bins[i]);
+            else
+                printf("      >=%8.4f secs: %lu\n",
+                       limit/2, (unsigned long)histo->bins[i]);
+        }
+        limit *= 2;
+    }
+}
+
+double drvEtherIP_histogram_percentile(const EIPHistogram *histo,
+                                       double fraction)
+{
+    size_t i, sum = 0;
+    double limit = EIP_HISTO_BASE;
+
+    if (histo->count <= 0)
+        return 0.0;
+    for (i=0; i<EIP_HISTO_BINS-1; ++i)
+    {
+        sum += histo->bins[i];
+        if (sum >= fraction * histo->count)
+            return limit < histo->max ? limit : histo->max;
+        limit *= 2;
+    }
+    return histo->max;
+}
+
 /* ------------------------------------------------------------
  * TagInfo
  * ------------------------------------------------------------ */
 static void dump_TagInfo(const TagInfo *info, int level)
 {
+    /* Locking updates the lock statistics of the tag */
+    TagInfo *locked = (TagInfo *) info;
     char buffer[EIP_MAX_TAG_LENGTH];
     printf("*** Tag '%s' @ 0x%lX:\n", info->string_tag, (unsigned long)info);
     if (level > 3)
@@ -102,6 +359,8 @@ static void dump_TagInfo(const TagInfo *info, int level)
         EIP_copy_ParsedTag(buffer, info->tag);
         printf("  compiled tag        : '%s', %d elements\n",
         	   buffer, (unsigned)info->elements);
+        if (info->priority)
+            printf("  priority            : yes\n");
         printf("  cip read requ./resp.: %u / %u\n",
         	   (unsigned)info->cip_r_request_size, (unsigned)info->cip_r_response_size);
         printf("  cip write req./resp.: %u / %u\n",
@@ -109,14 +368,14 @@ static void dump_TagInfo(const TagInfo *info, int level)
         printf("  data_lock ID        : 0x%lX\n",
                (unsigned long) info->data_lock);
     }
-    if (epicsMutexLock(info->data_lock) == epicsMutexLockOK)
+    if (EIP_lock_data(locked) == epicsMutexLockOK)
     {
         if (level > 3)
         {
             printf("  data_size / valid   : %u / %u\n",
             	   (unsigned)info->data_size,  (unsigned)info->valid_data_size);
             printf("  do_write/is_writing : %s / %s\n",
-                   (info->do_write ? "yes" : "no"),
+                   (EIP_atomic_get(info->do_write) ? "yes" : "no"),
                    (info->is_writing ? "yes" : "no"));
             EIP_printf(0, "  data                : ");
         }
@@ -124,12 +383,21 @@ static void dump_TagInfo(const TagInfo *info, int level)
             dump_raw_CIP_data(info->data, info->elements);
         else
             printf("-no data-\n");
-        epicsMutexUnlock(info->data_lock);
+        EIP_unlock_data(locked);
     }
     else
         printf("  (CANNOT GET DATA LOCK!)\n");
     if (level > 3)
+    {
         printf("  transfer time       : %g secs\n", info->transfer_time);
+        if (info->wire_time > 0.0)
+            printf("  wire transfer time  : %g secs\n", info->wire_time);
+        if (info->write_transfer_time > 0.0)
+            printf("  last write          : %g queued, %g transfer, "
+                   "%g callbacks [secs]\n",
+                   info->write_queue_time, info->write_transfer_time,
+                   info->write_callback_time);
+    }
 }
 
 static TagInfo *new_TagInfo(const char *string_tag, size_t elements)
@@ -189,6 +457,53 @@ eip_bool reserve_tag_data(TagInfo *info, size_t requested_size)
 	return true;
 }
 
+static void set_TagInfo_sizes(TagInfo *info,
+                              size_t request_size, size_t response_size);
+
+/* Is the caller the scan task of the PLC? */
+static eip_bool is_scan_task(const PLC *plc)
+{
+#ifdef HAVE_314_API
+    return plc->scan_task_id == epicsThreadGetIdSelf();
+#else
+    return plc->scan_task_id == taskIdSelf();
+#endif
+}
+
+/** Scan task: Get buffer for received data.
+ *  Buffers are reserved when the tag's sizes are set,
+ *  so this only allocates when the PLC returns more data
+ *  than planned. That is counted, and refused with
+ *  drvEtherIP_forbid_scan_alloc.
+ *  @return true when OK
+ */
+static eip_bool scan_tag_data(PLC *plc, TagInfo *info, size_t size)
+{
+    if (info->data_size >= size)
+        return true;
+    ++plc->scan_allocs;
+    if (drvEtherIP_forbid_scan_alloc)
+    {
+        EIP_printf(1, "EIP tag '%s': %lu bytes exceed buffer of %lu bytes\n",
+                   info->string_tag, (unsigned long)size,
+                   (unsigned long)info->data_size);
+        return false;
+    }
+    return reserve_tag_data(info, size);
+}
+
+/* Scan task: Set sizes of a tag that changed in the PLC.
+ * A bigger buffer is allocated via scan_tag_data.
+ * TagInfo is locked.
+ */
+static void rescan_TagInfo_sizes(PLC *plc, TagInfo *info,
+                                 size_t request_size, size_t response_size)
+{
+    if (response_size > 4  &&  !scan_tag_data(plc, info, response_size - 4))
+        request_size = response_size = 0;
+    set_TagInfo_sizes(info, request_size, response_size);
+}
+
 #if 0
 /* We never remove a tag */
 static void free_TagInfo(TagInfo *info)
@@ -224,12 +539,19 @@ void epicsTimeToStrftime(char *txt, size_t len, const char *fmt,
 
 static void dump_ScanList(const ScanList *list, int level)
 {
-    const TagInfo *info;
+    TagInfo   *info;
     char      tsString[50];
     printf("Scanlist %g secs @ 0x%lX:\n",
            list->period, (unsigned long)list);
     printf("  Status        : %s\n",
            (list->enabled ? "enabled" : "DISABLED"));
+    if (list->phase >= 0.0)
+        printf("  Phase         : %g secs\n", list->phase);
+    else if (drvEtherIP_stagger)
+        printf("  Phase         : %g secs (automatic)\n",
+               list->auto_phase * list->period);
+    if (list->sync)
+        printf("  Sync group    : '%s'\n", list->sync->name);
     epicsTimeToStrftime(tsString, sizeof(tsString),
                         "%Y/%m/%d %H:%M:%S.%04f", &list->scan_time);
     printf("  Last scan     : %s\n", tsString);
@@ -246,6 +568,9 @@ static void dump_ScanList(const ScanList *list, int level)
                list->max_scan_time);
         printf("  Last scan time: %g secs\n",
                list->last_scan_time);
+        if (list->plc->timestamp_tag)
+            printf("  Data age      : %g secs (min %g, max %g)\n",
+                   list->data_age, list->min_data_age, list->max_data_age);
     }
     if (level > 5)
     {
@@ -258,7 +583,6 @@ static void dump_ScanList(const ScanList *list, int level)
 /* Set counters etc. to initial values */
 static void reset_ScanList(ScanList *scanlist)
 {
-    scanlist->enabled        = true;
     scanlist->list_errors    = 0;
     scanlist->sched_errors   = 0;
     memset(&scanlist->scan_time,      0, sizeof(epicsTimeStamp));
@@ -266,20 +590,117 @@ static void reset_ScanList(ScanList *scanlist)
     scanlist->min_scan_time  = 0.0;
     scanlist->max_scan_time  = 0.0;
     scanlist->last_scan_time = 0.0;
+    scanlist->data_age       = 0.0;
+    scanlist->min_data_age   = 0.0;
+    scanlist->max_data_age   = 0.0;
 }
 
 static ScanList *new_ScanList(PLC *plc, double period)
 {
-    ScanList *list = (ScanList *) calloc(sizeof(ScanList), 1);
+    ScanList *list;
+    size_t   n = plc->index;
+
+    for (list = DLL_first(ScanList, &plc->scanlists); list;
+         list = DLL_next(ScanList, list))
+        ++n;
+    list = (ScanList *) calloc(sizeof(ScanList), 1);
     if (!list)
         return 0;
     DLL_init(&list->taginfos);
     list->plc = plc;
     list->period = period;
+    list->enabled = true;
+    /* Golden ratio sequence over PLCs and their lists
+     * spreads lists evenly, however many there are */
+    list->phase = -1.0;
+    list->auto_phase = fmod(n * 0.6180339887, 1.0);
     reset_ScanList (list);
     return list;
 }
 
+/* Schedule next scan of list at or after 'earliest'
+ * at its phase within the period.
+ * Phases refer to the start of the epoch,
+ * so they're the same for all scan tasks.
+ */
+static void schedule_ScanList(ScanList *list, const epicsTimeStamp *earliest)
+{
+#ifdef HAVE_314_API
+    double phase, offset;
+#endif
+
+    list->scheduled_time = *earliest;
+#ifdef HAVE_314_API
+    if (list->period <= 0.0)
+        return;
+    if (list->phase >= 0.0)
+        phase = fmod(list->phase, list->period);
+    else if (drvEtherIP_stagger)
+        phase = list->auto_phase * list->period;
+    else
+        return;
+    offset = fmod(earliest->secPastEpoch + earliest->nsec*1e-9, list->period);
+    if (phase < offset)
+        phase += list->period;
+    epicsTimeAddSeconds(&list->scheduled_time, phase - offset);
+#endif /* R3.13 time stamps are ticks, no phases */
+}
+
+/* Has time stamp been set? */
+static eip_bool is_time_set(const epicsTimeStamp *stamp)
+{
+#ifdef HAVE_314_API
+    return stamp->secPastEpoch != 0  ||  stamp->nsec != 0;
+#else
+    return *stamp != 0;
+#endif
+}
+
+/* When should the scan task handle the list?
+ * Lists in a sync group are handled a little early,
+ * process_ScanList then prepares the requests
+ * and waits for the exact time.
+ */
+static void get_due_time(const ScanList *list, epicsTimeStamp *due)
+{
+    *due = list->scheduled_time;
+    if (list->sync  &&  drvEtherIP_sync_lead > 0.0)
+        epicsTimeAddSeconds(due, -drvEtherIP_sync_lead);
+}
+
+/* Scan task sent the sample of a list in a sync group */
+static void add_sync_sample(ScanList *list, const epicsTimeStamp *sent)
+{
+    EIPSyncGroup *group = list->sync;
+
+    epicsMutexLock(group->lock);
+    if (group->reported == 0  ||
+        epicsTimeDiffInSeconds(&list->scheduled_time,
+                               &group->sample_time) != 0.0)
+    {   /* First member to send this sample */
+        if (group->reported > 0)
+            ++group->incomplete;
+        group->sample_time = list->scheduled_time;
+        group->first_send = group->last_send = *sent;
+        group->reported = 0;
+    }
+    else if (epicsTimeLessThan(sent, &group->first_send))
+        group->first_send = *sent;
+    else if (epicsTimeLessThan(&group->last_send, sent))
+        group->last_send = *sent;
+    if (++group->reported >= group->members)
+    {
+        group->skew = epicsTimeDiffInSeconds(&group->last_send,
+                                             &group->first_send);
+        if (group->skew > group->max_skew)
+            group->max_skew = group->skew;
+        drvEtherIP_histogram_add(&group->skew_histo, group->skew);
+        ++group->samples;
+        group->reported = 0;
+    }
+    epicsMutexUnlock(group->lock);
+}
+
 #if 0
 /* We never remove a scan list */
 static void free_ScanList(ScanList *scanlist)
@@ -312,10 +733,22 @@ static void remove_ScanList_TagInfo(ScanList *scanlist, TagInfo *info)
     DLL_unlink(&scanlist->taginfos, info);
 }
 
+/* Priority tags are kept at the start of the list,
+ * so they're in the first transfer */
 static void add_ScanList_TagInfo(ScanList *scanlist, TagInfo *info)
 {
-    DLL_append(&scanlist->taginfos, info);
+    TagInfo *before = 0;
+
+    if (info->priority)
+    {
+        for (before = DLL_first(TagInfo, &scanlist->taginfos);
+             before  &&  before->priority;
+             before = DLL_next(TagInfo, before))
+            ;
+    }
+    DLL_insert_before(&scanlist->taginfos, info, before);
     info->scanlist = scanlist;
+    info->lock_stats = &scanlist->plc->data_lock_stats;
 }
 
 /* Add new tag to taglist, compile tag
@@ -330,6 +763,116 @@ static TagInfo *add_ScanList_Tag(ScanList *scanlist,
     return info;
 }
 
+/* ------------------------------------------------------------
+ * Boot timeline
+ * ------------------------------------------------------------ */
+
+typedef struct
+{
+    size_t         count;       /* # of calls                        */
+    double         total;       /* time spent in them [secs]         */
+    epicsTimeStamp first;       /* start of first call               */
+    epicsTimeStamp last;        /* end of last call                  */
+}   BootPhase;
+
+/* Protected by boot.lock, which is taken after all other locks.
+ * It also protects PLC.boot_scanned and changes of PLC.owned,
+ * so 'unscanned' can be kept without locking the PLCs.
+ */
+static struct
+{
+    epicsMutexId   lock;
+    epicsTimeStamp start;       /* drvEtherIP_init                   */
+    epicsTimeStamp records;     /* records initialized               */
+    epicsTimeStamp done;        /* all PLCs scanned once             */
+    size_t         unscanned;   /* owned PLCs not yet scanned once   */
+    BootPhase      phase[EIP_BOOT_PHASES];
+}   boot;
+
+static const char *boot_phase_name[EIP_BOOT_PHASES] =
+{
+    "record links",
+    "drvEtherIP_add_tag"
+};
+
+void drvEtherIP_boot_phase(EIPBootPhase phase, const epicsTimeStamp *start)
+{
+    epicsTimeStamp begin = *start, now;
+    BootPhase      *p;
+
+    if (boot.lock == 0  ||  phase >= EIP_BOOT_PHASES)
+        return;
+    epicsTimeGetCurrent(&now);
+    epicsMutexLock(boot.lock);
+    if (! is_time_set(&boot.done))
+    {
+        p = &boot.phase[phase];
+        if (p->count == 0)
+            p->first = begin;
+        p->last = now;
+        p->total += epicsTimeDiffInSeconds(&now, &begin);
+        ++p->count;
+    }
+    epicsMutexUnlock(boot.lock);
+}
+
+/* Were all enabled lists of the PLC scanned? PLC is locked. */
+static eip_bool boot_all_scanned(PLC *plc)
+{
+    ScanList *list;
+
+    for (list = DLL_first(ScanList, &plc->scanlists);  list;
+         list = DLL_next(ScanList, list))
+        if (list->enabled  &&  !list->scanned_once)
+            return false;
+    return true;
+}
+
+/* Set whether this IOC scans the PLC, counting owned PLCs
+ * that weren't scanned, yet. Scan task reads 'owned' without lock.
+ */
+static void set_owned(PLC *plc, eip_bool owned)
+{
+    if (boot.lock == 0)
+    {
+        EIP_atomic_set(plc->owned, owned);
+        return;
+    }
+    epicsMutexLock(boot.lock);
+    if (EIP_atomic_get(plc->owned) != owned  &&
+        !is_time_set(&plc->boot_scanned))
+    {
+        if (owned)
+            ++boot.unscanned;
+        else
+            --boot.unscanned;
+    }
+    EIP_atomic_set(plc->owned, owned);
+    epicsMutexUnlock(boot.lock);
+}
+
+/* Called by scan task once all lists of the PLC were scanned,
+ * PLC not locked.
+ * Once all PLCs that this IOC owns were scanned, show the timeline
+ */
+static void boot_check_done(PLC *plc)
+{
+    eip_bool report = false;
+
+    epicsMutexLock(boot.lock);
+    epicsTimeGetCurrent(&plc->boot_scanned);
+    if (EIP_atomic_get(plc->owned)  &&  boot.unscanned > 0)
+        --boot.unscanned;
+    if (boot.unscanned == 0  &&  !is_time_set(&boot.done))
+    {
+        epicsTimeGetCurrent(&boot.done);
+        report = true;
+    }
+    epicsMutexUnlock(boot.lock);
+    if (report)
+        drvEtherIP_boot_report();
+}
+
 /* ------------------------------------------------------------
  * PLC
  * ------------------------------------------------------------ */
@@ -343,12 +886,18 @@ static PLC *new_PLC(const char *name)
     if (! plc->name)
         return 0;
     DLL_init (&plc->scanlists);
+    DLL_init (&plc->fifos);
+    DLL_init (&plc->aggregates);
+    DLL_init (&plc->free_callbacks);
     plc->lock = epicsMutexCreate();
-    if (! plc->lock)
+    plc->stats_lock = epicsMutexCreate();
+    if (! (plc->lock && plc->stats_lock))
     {
         EIP_printf (0, "new_PLC (%s): Cannot create mutex\n", name);
         return 0;
     }
+    plc->data_lock_stats.guard = plc->stats_lock;
+    plc->verbosity = -1;
     plc->connection = EIP_init();
     if (! plc->connection)
     {
@@ -375,6 +924,137 @@ static void free_PLC(PLC *plc)
 }
 #endif
 
+/* Set request/response sizes of a TagInfo from those of a read,
+ * derive the write sizes, and reserve the data buffer
+ * so that the scan task doesn't need to allocate it.
+ * Sizes of 0 mark a tag that cannot be read.
+ * TagInfo is locked.
+ */
+static void set_TagInfo_sizes(TagInfo *info,
+                              size_t request_size, size_t response_size)
+{
+    size_t type_and_data_len;
+
+    if (response_size > 4  &&  !reserve_tag_data(info, response_size - 4))
+        request_size = response_size = 0;
+
+    info->cip_r_request_size  = request_size;
+    info->cip_r_response_size = response_size;
+    /* Estimate write sizes from the request/response for read
+     * because we don't want to issue a 'write' just for the
+     * heck of it.
+     * Nevertheless, the write sizes calculated in here
+     * should be exact since we can determine the write
+     * request package from the read request
+     * (CIP service code, tag name, elements)
+     * plus the raw data size.
+     */
+    if (response_size <= 4)
+    {
+        info->cip_w_request_size  = 0;
+        info->cip_w_response_size = 0;
+    }
+    else
+    {
+        type_and_data_len = response_size - 4;
+        info->cip_w_request_size  = request_size + type_and_data_len;
+        info->cip_w_response_size = 4;
+    }
+}
+
+/* After TagInfo is defined (tag & elements are set),
+ * read the tag once to learn its sizes and fill the rest of TagInfo.
+ * Called on connection, PLC is locked and connected.
+ * Returns true when the tag could be read.
+ */
+static eip_bool complete_TagInfo(PLC *plc, TagInfo *info)
+{
+    const CN_USINT *data;
+    size_t         request_size, response_size;
+
+    if (EIP_lock_data(info) != epicsMutexLockOK)
+    {
+        EIP_printf(1, "EIP complete_TagInfo cannot lock %s\n",
+                   info->string_tag);
+        return false;
+    }
+    /* Need to get the read sizes */
+    data = EIP_read_tag(plc->connection,
+                        info->tag, info->elements,
+                        NULL /* data_size */,
+                        &request_size, &response_size);
+    if (data)
+    {
+        EIP_printf(5, "  tag '%s': req %d, resp %d bytes\n",
+                   info->string_tag, request_size, response_size);
+        set_TagInfo_sizes(info, request_size, response_size);
+    }
+    else
+    {
+        EIP_printf(3, "tag '%s': Cannot read!\n", info->string_tag);
+        set_TagInfo_sizes(info, 0, 0);
+    }
+    EIP_unlock_data(info);
+    return data != 0;
+}
+
+/* The time stamp tag is either a LINT
+ * or a DINT[2] array, which needs 2 elements.
+ */
+static void complete_timestamp_tag(PLC *plc)
+{
+    TagInfo        *info = plc->timestamp_tag;
+    const CN_USINT *data;
+    size_t         data_size;
+
+    if (! info)
+        return;
+    info->elements = 1;
+    if (! complete_TagInfo(plc, info))
+        return;
+    data = EIP_read_tag(plc->connection, info->tag, 1, &data_size, 0, 0);
+    if (data  &&  data_size > CIP_Typecode_size  &&
+        get_CIP_typecode(data) == T_CIP_DINT)
+    {
+        info->elements = 2;
+        complete_TagInfo(plc, info);
+    }
+}
+
+/* Read the first element of a FIFO to learn the data type,
+ * then allocate its buffer.
+ */
+static void complete_fifo(PLC *plc, EIPFifo *fifo)
+{
+    const CN_USINT *data;
+    size_t         data_size;
+
+    if (fifo->data)
+        return;
+    fifo->element->value.element = 0;
+    data = EIP_read_tag(plc->connection, fifo->tag, 1, &data_size, 0, 0);
+    if (!(data  &&  data_size > CIP_Typecode_size))
+    {
+        EIP_printf(3, "FIFO '%s': Cannot read!\n", fifo->string_tag);
+        return;
+    }
+    if (EIP_lock_data(fifo->index) != epicsMutexLockOK)
+        return;
+    fifo->element_size = CIP_Type_size(get_CIP_typecode(data));
+    if (fifo->element_size > 0)
+        fifo->data = (CN_USINT *) calloc(1, CIP_Typecode_size +
+                                         fifo->size*fifo->element_size);
+    if (fifo->data)
+        memcpy(fifo->data, data, CIP_Typecode_size);
+    else
+    {
+        EIP_printf(1, "EIP FIFO '%s': Cannot allocate buffer for type 0x%X\n",
+                   fifo->string_tag, (unsigned) get_CIP_typecode(data));
+        fifo->element_size = 0;
+    }
+    EIP_unlock_data(fifo->index);
+}
+
 /* After TagInfos are defined (tag & elements are set),
  * fill rest of TagInfo: request/response size.
  *
@@ -385,9 +1065,8 @@ static eip_bool complete_PLC_ScanList_TagInfos(PLC *plc)
 {
     ScanList       *list;
     TagInfo        *info;
-    const CN_USINT *data;
+    EIPFifo        *fifo;
     size_t         tried = 0, succeeded = 0;
-    size_t         type_and_data_len;
 
     EIP_printf(5, "complete_PLC_ScanList_TagInfos PLC '%s':\n", plc->name);
 
@@ -398,57 +1077,15 @@ static eip_bool complete_PLC_ScanList_TagInfos(PLC *plc)
         for (info=DLL_first(TagInfo, &list->taginfos);  info;
              info=DLL_next(TagInfo, info))
         {
-            if (epicsMutexLock(info->data_lock) != epicsMutexLockOK)
-            {
-                EIP_printf(1, "EIP complete_PLC_ScanList_TagInfos cannot lock %s\n",
-                           info->string_tag);
-                continue;
-            }
-            /* Need to get the read sizes */
             ++tried;
-            data = EIP_read_tag(plc->connection,
-                                info->tag, info->elements,
-                                NULL /* data_size */,
-                                &info->cip_r_request_size,
-                                &info->cip_r_response_size);
-            if (data)
-            {
-                EIP_printf(5, "  tag '%s': req %d, resp %d bytes\n",
-                           info->string_tag, info->cip_r_request_size, info->cip_r_response_size);
+            if (complete_TagInfo(plc, info))
                 ++succeeded;
-                /* Estimate write sizes from the request/response for read
-                 * because we don't want to issue a 'write' just for the
-                 * heck of it.
-                 * Nevertheless, the write sizes calculated in here
-                 * should be exact since we can determine the write
-                 * request package from the read request
-                 * (CIP service code, tag name, elements)
-                 * plus the raw data size.
-                 */
-                if (info->cip_r_response_size <= 4)
-                {
-                    info->cip_w_request_size  = 0;
-                    info->cip_w_response_size = 0;
-                }
-                else
-                {
-                    type_and_data_len = info->cip_r_response_size - 4;
-                    info->cip_w_request_size  = info->cip_r_request_size
-                        + type_and_data_len;
-                    info->cip_w_response_size = 4;
-                }
-            }
-            else
-            {
-                EIP_printf(3, "tag '%s': Cannot read!\n", info->string_tag);
-                info->cip_r_request_size  = 0;
-                info->cip_r_response_size = 0;
-                info->cip_w_request_size  = 0;
-                info->cip_w_response_size = 0;
-            }
-            epicsMutexUnlock(info->data_lock);
         }
     }
+    complete_timestamp_tag(plc);
+    for (fifo = DLL_first(EIPFifo, &plc->fifos);  fifo;
+         fifo = DLL_next(EIPFifo, fifo))
+        complete_fifo(plc, fifo);
     EIP_printf(5, "complete_PLC_ScanList_TagInfos PLC '%s': tried %lu tags, got %lu tags\n",
                plc->name, (unsigned long)tried, (unsigned long)succeeded);
     /* OK if we got at least one answer,
@@ -456,46 +1093,62 @@ static eip_bool complete_PLC_ScanList_TagInfos(PLC *plc)
     return (succeeded > 0) || (tried == 0);
 }
 
-static void invalidate_PLC_tags(PLC *plc)
+/* Drop the data of a tag and let its records show INVALID.
+ * With drop_write, a pending write is also dropped
+ * because its data no longer matches the tag.
+ * PLC is locked, TagInfo is not.
+ */
+static void invalidate_TagInfo(TagInfo *info, eip_bool drop_write)
 {
-    ScanList    *list;
-    TagInfo     *info;
     TagCallback *cb;
 
-    for (list=DLL_first(ScanList, &plc->scanlists);  list;
-         list=DLL_next(ScanList, list))
+    if (EIP_lock_data(info) == epicsMutexLockOK)
     {
-        for (info = DLL_first(TagInfo, &list->taginfos);  info;
-             info = DLL_next(TagInfo, info))
-        {
-            if (epicsMutexLock(info->data_lock) == epicsMutexLockOK)
-            {
-            	/** Reset all write flags: After an error, we skip all
-            	 *  writes to prevent writing garbage after a reconnect
-            	 */
-            	info->is_writing = false;
-                info->valid_data_size = 0;
-                epicsMutexUnlock(info->data_lock);
-                /* Call all registered callbacks for this tag
-                 * so that records can show INVALID */
-                for (cb = DLL_first(TagCallback, &info->callbacks);  cb;
-                     cb=DLL_next(TagCallback, cb))
-                    (*cb->callback) (cb->arg);
-            }
-            else
-            {
-            	EIP_printf(1, "EIP invalidate_PLC_tags cannot lock %s",
-            			   info->string_tag);
-            }
-        }
+        /** Reset all write flags: After an error, we skip all
+         *  writes to prevent writing garbage after a reconnect
+         */
+        info->is_writing = false;
+        if (drop_write)
+            EIP_atomic_set(info->do_write, false);
+        info->valid_data_size = 0;
+        EIP_unlock_data(info);
+        /* Call all registered callbacks for this tag
+         * so that records can show INVALID */
+        for (cb = DLL_first(TagCallback, &info->callbacks);  cb;
+             cb=DLL_next(TagCallback, cb))
+            (*cb->callback) (cb->arg);
+    }
+    else
+    {
+        EIP_printf(1, "EIP invalidate_TagInfo cannot lock %s",
+                   info->string_tag);
     }
 }
 
+static void invalidate_ScanList_tags(ScanList *list)
+{
+    TagInfo     *info;
+
+    for (info = DLL_first(TagInfo, &list->taginfos);  info;
+         info = DLL_next(TagInfo, info))
+        invalidate_TagInfo(info, false);
+}
+
+static void invalidate_PLC_tags(PLC *plc)
+{
+    ScanList    *list;
+
+    for (list=DLL_first(ScanList, &plc->scanlists);  list;
+         list=DLL_next(ScanList, list))
+        invalidate_ScanList_tags(list);
+}
+
 static void disconnect_PLC(PLC *plc)
 {
     if (plc->connection->sock)
     {
         EIP_printf_time(4, "EIP disconnecting %s\n", plc->name);
+        EIP_TRACE2(disconnect, plc->name, plc->connection->sock);
         EIP_shutdown(plc->connection);
         invalidate_PLC_tags(plc);
     }
@@ -504,16 +1157,25 @@ static void disconnect_PLC(PLC *plc)
 /* Test if we are connected, if not try to connect to PLC */
 static eip_bool assert_PLC_connect(PLC *plc)
 {
+    eip_bool ok;
+
     if (plc->connection->sock)
         return true;
     EIP_printf_time(4, "EIP connecting %s\n", plc->name);
-    if (! EIP_startup(plc->connection, plc->ip_addr,
-                      ETHERIP_PORT, plc->slot, ETHERIP_TIMEOUT))
+    if (! is_time_set(&plc->boot_connect))
+        epicsTimeGetCurrent(&plc->boot_connect);
+    ok = EIP_startup(plc->connection, plc->ip_addr,
+                     ETHERIP_PORT, plc->slot, ETHERIP_TIMEOUT);
+    /* sock remains 0 when the connection failed */
+    EIP_TRACE3(connect, plc->name, plc->ip_addr, plc->connection->sock);
+    if (! ok)
     {
         errlogPrintf("EIP connection failed for %s:%d\n",
                       plc->ip_addr, ETHERIP_PORT);
         return false;
     }
+    if (! is_time_set(&plc->boot_connected))
+        epicsTimeGetCurrent(&plc->boot_connected);
     if (! complete_PLC_ScanList_TagInfos(plc))
     {
         errlogPrintf("EIP error during scan list completion for %s:%d\n",
@@ -521,13 +1183,316 @@ static eip_bool assert_PLC_connect(PLC *plc)
         disconnect_PLC(plc);
         return false;
     }
+    if (! is_time_set(&plc->boot_sized))
+        epicsTimeGetCurrent(&plc->boot_sized);
+    /* All tags were just checked, get new reference status */
+    plc->have_status = false;
+    plc->revalidate = false;
+    return true;
+}
+
+/* Check controller status for changes that hint at a program download.
+ * Called by scan task, PLC is locked.
+ */
+static void check_PLC_change(PLC *plc)
+{
+    CN_UINT status;
+
+    epicsTimeGetCurrent(&plc->status_time);
+    if (! EIP_read_PLC_status(plc->connection, &status))
+    {
+        EIP_printf_time(4, "EIP PLC '%s': Cannot read status\n", plc->name);
+        return;
+    }
+    if (plc->have_status  &&  status != plc->plc_status)
+    {
+        EIP_printf_time(2, "EIP PLC '%s': Status changed from 0x%04X to 0x%04X,"
+                        " checking tags\n",
+                        plc->name, plc->plc_status, status);
+        ++plc->program_changes;
+        plc->revalidate = true;
+        plc->revalidate_index = 0;
+        plc->revalidate_single = 0;
+    }
+    plc->plc_status = status;
+    plc->have_status = true;
+}
+
+/* Get tag by its position in the PLC's scan lists, or 0 */
+static TagInfo *get_PLC_tag_by_index(PLC *plc, size_t index)
+{
+    ScanList *list;
+    TagInfo  *info;
+
+    for (list=DLL_first(ScanList, &plc->scanlists);  list;
+         list=DLL_next(ScanList, list))
+        for (info=DLL_first(TagInfo, &list->taginfos);  info;
+             info=DLL_next(TagInfo, info))
+            if (index-- == 0)
+                return info;
+    return 0;
+}
+
+/* Compare a tag with a fresh read of it: data is the read's
+ * type and data or 0 when the tag couldn't be read.
+ * A changed tag gets new sizes and is invalidated.
+ * Called by scan task, PLC is locked.
+ */
+static void revalidate_TagInfo(PLC *plc, TagInfo *info, const CN_USINT *data,
+                               size_t request_size, size_t response_size)
+{
+    eip_bool changed;
+
+    if (EIP_lock_data(info) != epicsMutexLockOK)
+        return;
+    if (data)
+        changed = info->cip_r_request_size != request_size  ||
+                  info->cip_r_response_size != response_size  ||
+                  (info->valid_data_size > 0  &&
+                   get_CIP_typecode(info->data) != get_CIP_typecode(data));
+    else
+        changed = info->cip_r_request_size != 0;
+    if (changed)
+    {
+        EIP_printf_time(3, "EIP tag '%s' changed\n", info->string_tag);
+        ++plc->changed_tags;
+        if (data)
+            rescan_TagInfo_sizes(plc, info, request_size, response_size);
+        else
+            set_TagInfo_sizes(info, 0, 0);
+    }
+    EIP_unlock_data(info);
+    /* Drop old data, also any pending write of it */
+    if (changed)
+        invalidate_TagInfo(info, true);
+}
+
+/* Check the next batch of tags after a program change.
+ *
+ * The new layout of a tag is only known after reading it,
+ * so all tags are read, but as many as fit into one transfer
+ * and only one transfer per call, so the scan lists continue
+ * to be processed in between.
+ * Tags with a different response size or type get new
+ * request/response sizes and lose their old data,
+ * tags that can no longer be read are skipped
+ * until they show up in a later check.
+ * When a batch fails as a whole, its tags are checked
+ * one per call.
+ *
+ * Returns false on communication error.
+ * Called by scan task, PLC is locked.
+ */
+static eip_bool revalidate_PLC_tags(PLC *plc)
+{
+    EIPConnection       *c = plc->connection;
+    ScanList            *list;
+    TagInfo             *info, *batch[EIP_REVALIDATE_BATCH];
+    size_t              request_sizes[EIP_REVALIDATE_BATCH];
+    size_t              skip, count, i, request_size, response_size;
+    size_t              requests_size, responses_size, multi_request_size;
+    size_t              single_response_size, data_size;
+    CN_USINT            *send_request, *multi_request, *request;
+    const CN_USINT      *response, *single_response, *data;
+    EncapsulationRRData rr_data;
+
+    if (plc->revalidate_single > 0)
+    {
+        info = get_PLC_tag_by_index(plc, plc->revalidate_index);
+        if (info)
+        {
+            data = EIP_read_tag(c, info->tag, info->elements, NULL,
+                                &request_size, &response_size);
+            revalidate_TagInfo(plc, info, data, request_size, response_size);
+        }
+        ++plc->revalidate_index;
+        --plc->revalidate_single;
+        return true;
+    }
+    /* Collect the next batch */
+    skip = plc->revalidate_index;
+    count = requests_size = responses_size = 0;
+    for (list=DLL_first(ScanList, &plc->scanlists);  list;
+         list=DLL_next(ScanList, list))
+    {
+        for (info=DLL_first(TagInfo, &list->taginfos);  info;
+             info=DLL_next(TagInfo, info))
+        {
+            if (skip > 0)
+            {
+                --skip;
+                continue;
+            }
+            request_size = CIP_ReadData_size(info->tag);
+            /* For a tag that was not readable, guess a small response */
+            response_size = info->cip_r_response_size > 0 ?
+                            info->cip_r_response_size : 8;
+            if (count >= EIP_REVALIDATE_BATCH  ||
+                CIP_MultiRequest_size(count+1, requests_size + request_size)
+                > c->transfer_buffer_limit  ||
+                CIP_MultiResponse_size(count+1, responses_size + response_size)
+                > c->transfer_buffer_limit)
+                break;
+            batch[count] = info;
+            request_sizes[count] = request_size;
+            requests_size  += request_size;
+            responses_size += response_size;
+            ++count;
+        }
+        if (info)
+            break;
+    }
+    if (count == 0)
+    {
+        EIP_printf_time(3, "EIP PLC '%s': Checked %lu tags\n",
+                        plc->name, (unsigned long)plc->revalidate_index);
+        plc->revalidate = false;
+        return true;
+    }
+    plc->revalidate_index += count;
+    multi_request_size = CIP_MultiRequest_size(count, requests_size);
+    send_request = EIP_make_SendRRData(c,
+                        CM_Unconnected_Send_size(multi_request_size));
+    if (! send_request)
+        return false;
+    multi_request = make_CM_Unconnected_Send(send_request,
+                                             multi_request_size, c->slot);
+    if (!(multi_request && prepare_CIP_MultiRequest(multi_request, count)))
+        return false;
+    for (i=0; i<count; ++i)
+    {
+        request = CIP_MultiRequest_item(multi_request, i, request_sizes[i]);
+        if (!(request &&
+              make_CIP_ReadData(request, batch[i]->tag, batch[i]->elements)))
+            return false;
+    }
+    if (!EIP_send_connection_buffer(c)  ||  !EIP_read_connection_buffer(c))
+    {
+        EIP_printf_time(2, "EIP PLC '%s': Tag check failed\n", plc->name);
+        return false;
+    }
+    response = EIP_unpack_RRData(c->buffer, &rr_data);
+    if (! check_CIP_MultiRequest_Response_partial(response,
+                                                  rr_data.data_length))
+    {   /* Maybe a response was much bigger than guessed.
+         * Check one by one, one per call to keep scanning in between.
+         */
+        EIP_printf_time(3, "EIP PLC '%s': Checking %lu tags individually\n",
+                        plc->name, (unsigned long)count);
+        plc->revalidate_index -= count;
+        plc->revalidate_single = count;
+        return true;
+    }
+    for (i=0; i<count; ++i)
+    {
+        info = batch[i];
+        single_response = get_CIP_MultiRequest_Response(
+            response, rr_data.data_length, i, &single_response_size);
+        if (! single_response)
+            return false;
+        data = check_CIP_ReadData_Response(single_response,
+                                           single_response_size, &data_size);
+        revalidate_TagInfo(plc, info, data, request_sizes[i],
+                           single_response_size);
+    }
     return true;
 }
 
+/* IOC time in microseconds since 1970 (UTC) */
+static double IOC_usecs(const epicsTimeStamp *stamp)
+{
+#ifdef HAVE_314_API
+    return ((double)stamp->secPastEpoch + POSIX_TIME_AT_EPICS_EPOCH) * 1e6
+           + stamp->nsec * 1e-3;
+#else
+    return 0.0; /* R3.13 time stamps are ticks, not wall clock */
+#endif
+}
+
+/* Read PLC wall clock, update NTP-style clock offset estimate.
+ *
+ * IOC time t1 before the request, t4 after the response,
+ * PLC time T somewhere in between:
+ *     delay  = t4 - t1
+ *     offset = T - (t1 + t4)/2,  error is within +-delay/2
+ * Of the last EIP_CLOCK_SAMPLES readings, the offset of the one
+ * with the shortest round trip is used.
+ *
+ * Called by scan task, PLC is locked.
+ */
+static void read_PLC_clock(PLC *plc)
+{
+    epicsTimeStamp t1, t4;
+    double         plc_usecs, delay;
+    size_t         i, best;
+
+    epicsTimeGetCurrent(&t1);
+    plc->clock_time = t1;
+    if (! EIP_read_PLC_wallclock(plc->connection, &plc_usecs))
+    {
+        ++plc->clock_errors;
+        EIP_printf_time(4, "EIP PLC '%s': Cannot read wall clock\n",
+                        plc->name);
+        return;
+    }
+    epicsTimeGetCurrent(&t4);
+    delay = epicsTimeDiffInSeconds(&t4, &t1);
+    /* Shift older samples, add new one at [0] */
+    if (plc->clock_samples < EIP_CLOCK_SAMPLES)
+        ++plc->clock_samples;
+    for (i=plc->clock_samples-1; i>0; --i)
+    {
+        plc->sample_offset[i] = plc->sample_offset[i-1];
+        plc->sample_delay[i]  = plc->sample_delay[i-1];
+    }
+    plc->sample_offset[0] = (plc_usecs - IOC_usecs(&t1))*1e-6 - delay/2;
+    plc->sample_delay[0]  = delay;
+    best = 0;
+    for (i=1; i<plc->clock_samples; ++i)
+        if (plc->sample_delay[i] < plc->sample_delay[best])
+            best = i;
+    plc->clock_offset = plc->sample_offset[best];
+    plc->clock_delay  = plc->sample_delay[best];
+    if (plc->clock_offset > plc->max_clock_offset  ||
+        plc->max_clock_offset == 0.0)
+        plc->max_clock_offset = plc->clock_offset;
+    if (plc->clock_offset < plc->min_clock_offset  ||
+        plc->min_clock_offset == 0.0)
+        plc->min_clock_offset = plc->clock_offset;
+    EIP_printf(8, "EIP PLC '%s' clock offset %g secs, delay %g secs\n",
+               plc->name, plc->clock_offset, plc->clock_delay);
+}
+
+/* Update list's data age from the PLC time stamp
+ * that was read along with the data.
+ * Called by scan task, PLC is locked.
+ */
+static void update_data_age(ScanList *list, const CN_USINT *data,
+                            size_t data_size, const epicsTimeStamp *received)
+{
+    double plc_usecs, age;
+
+    if (data_size < CIP_Typecode_size + 2*sizeof(CN_UDINT)  ||
+        !get_CIP_LINT_double(data, &plc_usecs))
+        return;
+    /* IOC time of reception, converted to PLC clock, minus stamp */
+    age = (IOC_usecs(received) - plc_usecs)*1e-6 + list->plc->clock_offset;
+    list->data_age = age;
+    if (age > list->max_data_age  ||  list->max_data_age == 0.0)
+        list->max_data_age = age;
+    if (age < list->min_data_age  ||  list->min_data_age == 0.0)
+        list->min_data_age = age;
+}
+
 /* Given a transfer buffer limit,
  * see how many requests/responses can be handled in one transfer,
  * starting with the current TagInfo and using the following ones.
  *
+ * When given, the PLC time stamp tag is the first request.
+ * max_count limits the number of requests, 0 for no limit.
+ * With drvEtherIP_read_after_write, a write is followed by
+ * a read of the same tag, see TagInfo.read_back.
+ *
  * Returns count,
  * fills sizes for total requests/responses as well as
  * size of MultiRequest/Response.
@@ -535,13 +1500,15 @@ static eip_bool assert_PLC_connect(PLC *plc)
  * Called by scan task, PLC is locked.
  */
 static size_t determine_MultiRequest_count(size_t limit,
+                                           size_t max_count,
+                                           TagInfo *stamp,
                                            TagInfo *info,
                                            size_t *requests_size,
                                            size_t *responses_size,
                                            size_t *multi_request_size,
                                            size_t *multi_response_size)
 {
-    size_t try_req, try_resp, count;
+    size_t try_req, try_resp, count, first, items;
 
     /* Sum sizes for requests and responses,
      * determine total for MultiRequest/Response,
@@ -549,27 +1516,43 @@ static size_t determine_MultiRequest_count(size_t limit,
      * Skip entries with empty cip_*_request_size!
      */
     count = *requests_size = *responses_size = 0;
+    if (stamp)
+    {
+        count = 1;
+        *requests_size  = stamp->cip_r_request_size;
+        *responses_size = stamp->cip_r_response_size;
+    }
+    first = count;
     EIP_printf(8, "EIP determine_MultiRequest_count, limit %lu\n",
                (unsigned long) limit);
     for (/**/; info; info = DLL_next(TagInfo, info))
     {
         if (info->cip_r_request_size <= 0  ||  info->cip_w_request_size <= 0)
             continue;
-        if (epicsMutexLock(info->data_lock) != epicsMutexLockOK)
-        {
-            EIP_printf(1, "EIP determine_MultiRequest_count cannot lock %s\n",
-                       info->string_tag);
-            return 0;
-        }
         /* Did device suppport request a 'write' cycle?
          * Or are we in one that's not completed?
+         * Checked without the data lock, see "Locking" above.
          */
-        info->is_writing = info->do_write | info->is_writing;
+        if (EIP_atomic_get(info->do_write))
+            info->is_writing = true;
+        items = 1;
         if (info->is_writing)
-        {   /* Yes, clear the flag, compute size of write command/reply */
-            info->do_write = false;
+        {   /* Yes, compute size of write command/reply */
             try_req  = *requests_size  + info->cip_w_request_size;
             try_resp = *responses_size + info->cip_w_response_size;
+            /* Read back unless write and read don't even fit alone */
+            info->read_back = drvEtherIP_read_after_write  &&
+                !(count <= first  &&
+                  (CIP_MultiRequest_size(count+2,
+                       try_req + info->cip_r_request_size) > limit  ||
+                   CIP_MultiResponse_size(count+2,
+                       try_resp + info->cip_r_response_size) > limit));
+            if (info->read_back)
+            {
+                items = 2;
+                try_req  += info->cip_r_request_size;
+                try_resp += info->cip_r_response_size;
+            }
             EIP_printf(5, " tag %lu '%s' (write): %lu (0x%X), %lu (0x%X)\n",
                        (unsigned long)count, info->string_tag,
                        (unsigned long)info->cip_w_request_size,
@@ -589,9 +1572,14 @@ static size_t determine_MultiRequest_count(size_t limit,
                        (unsigned long)info->cip_r_response_size,
                        (unsigned long)info->cip_r_response_size);
         }
-        epicsMutexUnlock(info->data_lock);
-        *multi_request_size  = CIP_MultiRequest_size (count+1, try_req);
-        *multi_response_size = CIP_MultiResponse_size(count+1, try_resp);
+        if (max_count > 0  &&  count > first  &&  count+items > max_count)
+        {
+            EIP_printf(8, " Skipping tag '%s', reached %lu requests\n",
+                       info->string_tag, (unsigned long)max_count);
+            return count;
+        }
+        *multi_request_size  = CIP_MultiRequest_size (count+items, try_req);
+        *multi_response_size = CIP_MultiResponse_size(count+items, try_resp);
         if (*multi_request_size  > limit ||
             *multi_response_size > limit)
         {
@@ -602,7 +1590,7 @@ static size_t determine_MultiRequest_count(size_t limit,
                        (unsigned long)*multi_request_size,
                        (unsigned long)*multi_response_size);
         	/* more won't fit */
-            if (count <= 0)
+            if (count <= (stamp ? 1 : 0))
             {   /* The one and only tag didn't fit?! */
                 EIP_printf(2, "Tag '%s' can never be read because it alone exceeds buffer limit of %lu bytes,\n",
                            info->string_tag, (unsigned long) limit);
@@ -611,7 +1599,7 @@ static size_t determine_MultiRequest_count(size_t limit,
             }
             return count;
         }
-        ++count; /* ok, include another request */
+        count += items; /* ok, include another request */
         *requests_size  = try_req;
         *responses_size = try_resp;
     }
@@ -621,6 +1609,122 @@ static size_t determine_MultiRequest_count(size_t limit,
     return count;
 }
 
+/* Congestion control:
+ * The scan task starts with the full transfer_buffer_limit and
+ * no limit on the number of requests per MultiRequest.
+ * When the PLC reports missing resources or a transfer is slower
+ * than drvEtherIP_congestion_latency, both are halved (but at least
+ * 'floor' requests), then increased by a little for each good transfer.
+ */
+#define EIP_CONGESTION_MIN  100 /* bytes */
+#define EIP_CONGESTION_STEP  32 /* bytes */
+
+/* Effective buffer limit and max. count of requests for next transfer */
+static void get_congestion_limits(PLC *plc, size_t *limit, size_t *max_count)
+{
+    size_t hard_limit = plc->connection->transfer_buffer_limit;
+
+    if (plc->congestion_limit <= 0  ||  plc->congestion_limit > hard_limit)
+        plc->congestion_limit = hard_limit;
+    if (drvEtherIP_congestion)
+    {
+        *limit = plc->congestion_limit;
+        *max_count = plc->congestion_count;
+    }
+    else
+    {
+        *limit = hard_limit;
+        *max_count = 0;
+    }
+}
+
+/* Response for 'count' requests indicates congestion.
+ * Returns true if limits were reduced,
+ * false if they're already at the minimum.
+ */
+static eip_bool congestion_decrease(PLC *plc, size_t count, size_t floor)
+{
+    size_t limit = plc->congestion_limit / 2;
+    size_t max_count = count / 2;
+
+    if (! drvEtherIP_congestion)
+        return false;
+    if (limit < EIP_CONGESTION_MIN)
+        limit = EIP_CONGESTION_MIN;
+    if (limit > plc->congestion_limit)
+        limit = plc->congestion_limit;
+    if (max_count < floor)
+        max_count = floor;
+    if (plc->congestion_count > 0  &&  max_count > plc->congestion_count)
+        max_count = plc->congestion_count;
+    if (limit == plc->congestion_limit  &&
+        max_count == plc->congestion_count)
+        return false;
+    plc->congestion_limit = limit;
+    plc->congestion_count = max_count;
+    ++plc->congestion_events;
+    EIP_printf_time(3, "EIP PLC '%s' congestion: %lu bytes, %lu requests\n",
+                    plc->name, (unsigned long)limit, (unsigned long)max_count);
+    return true;
+}
+
+/* Transfer of 'count' requests went fine, probe for more */
+static void congestion_increase(PLC *plc, size_t count)
+{
+    size_t hard_limit = plc->connection->transfer_buffer_limit;
+
+    if (plc->congestion_limit < hard_limit)
+    {
+        plc->congestion_limit += EIP_CONGESTION_STEP;
+        if (plc->congestion_limit > hard_limit)
+            plc->congestion_limit = hard_limit;
+    }
+    if (plc->congestion_count > 0  &&  count >= plc->congestion_count)
+        ++plc->congestion_count;
+}
+
+/* Does response indicate that the PLC or ENET module ran out
+ * of resources, as opposed to errors in the requests?
+ */
+static eip_bool is_congestion_response(const CN_USINT *response)
+{
+    CN_USINT general_status = response[2];
+    return general_status == 0x02  || /* Resource unavailable */
+           general_status == 0x11;    /* Reply data too large */
+}
+
+/* Longest busy-wait for the send time of a sync group sample */
+#define EIP_SYNC_MAX_SPIN 0.002 /* seconds */
+
+/* Wait until 'time', returning the current time in 'now'.
+ * Sleeps for all but the last scheduler quantum, then polls
+ * the clock for at most EIP_SYNC_MAX_SPIN.
+ */
+static void wait_until(const epicsTimeStamp *time, epicsTimeStamp *now)
+{
+    epicsTimeStamp until = *time, limit;
+    double quantum = epicsThreadSleepQuantum();
+    double spin, remaining;
+
+    epicsTimeGetCurrent(now);
+    remaining = epicsTimeDiffInSeconds(&until, now);
+    if (remaining <= 0.0)
+        return;
+    if (quantum <= 0.0  ||  quantum > EIP_SYNC_MAX_SPIN)
+        spin = EIP_SYNC_MAX_SPIN;
+    else
+        spin = quantum;
+    if (remaining > spin)
+    {
+        epicsThreadSleep(remaining - spin);
+        epicsTimeGetCurrent(now);
+    }
+    limit = *now;
+    epicsTimeAddSeconds(&limit, spin);
+    while (epicsTimeLessThan(now, &until)  &&  epicsTimeLessThan(now, &limit))
+        epicsTimeGetCurrent(now);
+}
+
 /* Read all tags in Scanlist,
  * using MultiRequests for as many as possible.
  * Called by scan task, PLC is locked.
@@ -631,20 +1735,27 @@ static size_t determine_MultiRequest_count(size_t limit,
  */
 static eip_bool process_ScanList(EIPConnection *c, ScanList *scanlist)
 {
-    TagInfo             *info, *info_position;
-    size_t              count, requests_size, responses_size;
+    TagInfo             *info, *info_position, *stamp;
+    size_t              count, first, requests_size, responses_size;
+    size_t              limit, max_count, items;
     size_t              multi_request_size = 0, multi_response_size = 0;
     size_t              send_size, i, elements;
     CN_USINT            *send_request, *multi_request, *request;
     const CN_USINT      *response, *single_response, *data;
     EncapsulationRRData rr_data;
     size_t              single_response_size, data_size;
-    epicsTimeStamp      start_time, end_time;
-    double              transfer_time;
+    epicsTimeStamp      start_time, end_time, done_time;
+    double              transfer_time, wire_time;
     TagCallback         *cb;
-    eip_bool            ok;
+    eip_bool            ok, wrote, sync;
 
     EIP_printf_time(10, "EIP process_ScanList %g s\n", scanlist->period);
+    sync = scanlist->sync != 0;
+    /* Optional PLC time stamp is read as first item of each transfer */
+    stamp = scanlist->plc->timestamp_tag;
+    if (stamp  &&  stamp->cip_r_request_size <= 0)
+        stamp = 0;
+    first = stamp ? 1 : 0;
     info = DLL_first(TagInfo, &scanlist->taginfos);
     while (info)
     {   /* keep position, we'll loop several times:
@@ -653,13 +1764,23 @@ static eip_bool process_ScanList(EIPConnection *c, ScanList *scanlist)
          * 2) to handle the responses
          */
         info_position = info;
+        get_congestion_limits(scanlist->plc, &limit, &max_count);
         count = determine_MultiRequest_count(
-            c->transfer_buffer_limit,
+            limit, max_count, stamp,
             info, &requests_size, &responses_size,
             &multi_request_size, &multi_response_size);
+        if (count <= first  &&  limit < c->transfer_buffer_limit)
+        {   /* Tag doesn't fit reduced limit, send it alone */
+            count = determine_MultiRequest_count(
+                c->transfer_buffer_limit, first+1, stamp,
+                info, &requests_size, &responses_size,
+                &multi_request_size, &multi_response_size);
+        }
         EIP_printf(10, "EIP process_ScanList %lu items\n",
                    (unsigned long)count);
-        if (count == 0) /* Empty, or nothing fits in one request. */
+        EIP_TRACE4(plan, scanlist->plc->name, count,
+                   multi_request_size, multi_response_size);
+        if (count <= first) /* Empty, or nothing fits in one request. */
             return true;
         /* send <count> requests as one transfer */
         send_size = CM_Unconnected_Send_size(multi_request_size);
@@ -670,29 +1791,51 @@ static eip_bool process_ScanList(EIPConnection *c, ScanList *scanlist)
                                                  multi_request_size, c->slot);
         if (!(multi_request && prepare_CIP_MultiRequest(multi_request, count)))
             return false;
+        i = 0;
+        if (stamp)
+        {
+            request = CIP_MultiRequest_item(multi_request,
+                                            0, stamp->cip_r_request_size);
+            if (!(request &&
+                  make_CIP_ReadData(request, stamp->tag, stamp->elements)))
+                return false;
+            i = 1;
+        }
         /* Add read/write requests to the multi requests */
-        for (i=0;  i<count;  info=DLL_next(TagInfo, info))
+        for (/* i */;  i<count;  info=DLL_next(TagInfo, info))
         {
             if (info->cip_r_request_size <= 0  ||  info->cip_w_request_size <= 0)
                 continue;
             EIP_printf(10, "Request #%d (%s):\n", i, info->string_tag);
             if (info->is_writing)
-            {
+            {   /* Clear the write request and copy the data
+                 * into the request under one data lock */
                 request = CIP_MultiRequest_item(multi_request,
                                                 i, info->cip_w_request_size);
-                if (epicsMutexLock(info->data_lock) != epicsMutexLockOK)
+                if (EIP_lock_data(info) != epicsMutexLockOK)
                 {
                     EIP_printf_time(1, "EIP process_ScanList '%s': "
                                "no data lock (write)\n", info->string_tag);
-                    info->is_writing = false;
                     return false;
                 }
+                if (EIP_atomic_get(info->do_write))
+                {
+                    info->write_start_time = info->write_request_time;
+                    EIP_atomic_set(info->do_write, false);
+                }
                 ok = request &&
                     make_CIP_WriteData(
                         request, info->tag,
                         (CIP_Type)get_CIP_typecode(info->data),
                         info->elements, info->data + CIP_Typecode_size);
-                epicsMutexUnlock(info->data_lock);
+                EIP_unlock_data(info);
+                if (ok  &&  info->read_back)
+                {   /* read the tag right after writing it */
+                    request = CIP_MultiRequest_item(
+                        multi_request, ++i, info->cip_r_request_size);
+                    ok = request &&
+                        make_CIP_ReadData(request, info->tag, info->elements);
+                }
             }
             else
             {   /* reading, !is_writing */
@@ -705,7 +1848,15 @@ static eip_bool process_ScanList(EIPConnection *c, ScanList *scanlist)
                 return false;
             ++i; /* increment here, not in for() -> skip empty tags */
         } /* for i=0..count */
-        epicsTimeGetCurrent(&start_time);
+        if (sync)
+        {   /* First request of a sync group sample is ready,
+             * wait for the exact time (scan task woke early) */
+            wait_until(&scanlist->scheduled_time, &start_time);
+            add_sync_sample(scanlist, &start_time);
+            sync = false;
+        }
+        else
+            epicsTimeGetCurrent(&start_time);
         if (!EIP_send_connection_buffer(c))
         {
             EIP_printf_time(2, "EIP process_ScanList: Error while sending request\n");
@@ -719,43 +1870,105 @@ static eip_bool process_ScanList(EIPConnection *c, ScanList *scanlist)
         }
         epicsTimeGetCurrent(&end_time);
         transfer_time = epicsTimeDiffInSeconds(&end_time, &start_time);
+        wire_time = c->wire_time;
+        drvEtherIP_histogram_add(&scanlist->plc->transfer_histo, transfer_time);
+        if (wire_time > 0.0)
+            drvEtherIP_histogram_add(&scanlist->plc->wire_histo, wire_time);
         response = EIP_unpack_RRData(c->buffer, &rr_data);
         if (! check_CIP_MultiRequest_Response(response, rr_data.data_length))
         {
-            EIP_printf_time(2, "EIP process_ScanList: Error in response\n");
-            for (info=info_position,i=0; i<count; info=DLL_next(TagInfo, info))
+            if (is_congestion_response(response)  &&
+                congestion_decrease(scanlist->plc, count, first+1))
+            {   /* Try same tags again with smaller transfers */
+                info = info_position;
+                continue;
+            }
+            if (drvEtherIP_change_period > 0.0  &&
+                check_CIP_MultiRequest_Response_partial(response,
+                                                        rr_data.data_length))
+            {   /* Only some tags failed, maybe because of a program change.
+                 * Handle the rest, check the tags instead of reconnecting.
+                 */
+                EIP_printf_time(3, "EIP process_ScanList: Some requests "
+                                "failed, checking tags\n");
+                if (! scanlist->plc->revalidate)
+                {
+                    scanlist->plc->revalidate = true;
+                    scanlist->plc->revalidate_index = 0;
+                    scanlist->plc->revalidate_single = 0;
+                }
+            }
+            else
             {
-                if (info->cip_r_request_size <= 0)
-                    continue;
-                EIP_printf(2, "Tag %i: '%s'\n", i, info->string_tag);
-                ++i;
+                EIP_printf_time(2, "EIP process_ScanList: Error in response\n");
+                for (info=info_position,i=first; i<count;
+                     info=DLL_next(TagInfo, info))
+                {
+                    if (info->cip_r_request_size <= 0)
+                        continue;
+                    EIP_printf(2, "Tag %i: '%s'\n", i, info->string_tag);
+                    if (info->is_writing  &&  info->read_back)
+                        ++i;
+                    ++i;
+                }
+                if (EIP_verbose(2))
+                    dump_CIP_MultiRequest_Response_Error(response,
+                                                         rr_data.data_length);
+                return false;
             }
-            if (EIP_verbosity >= 2)
-                dump_CIP_MultiRequest_Response_Error(response,
-                                                     rr_data.data_length);
-            return false;
         }
+        if (stamp)
+        {
+            single_response = get_CIP_MultiRequest_Response(
+                response, rr_data.data_length, 0, &single_response_size);
+            if (! single_response)
+                return false;
+            data = check_CIP_ReadData_Response(
+                single_response, single_response_size, &data_size);
+            if (data  &&
+                EIP_lock_data(stamp) == epicsMutexLockOK)
+            {
+                if (scan_tag_data(scanlist->plc, stamp, data_size))
+                {
+                    memcpy(stamp->data, data, data_size);
+                    stamp->valid_data_size = data_size;
+                    stamp->update_time = end_time;
+                }
+                EIP_unlock_data(stamp);
+                update_data_age(scanlist, data, data_size, &end_time);
+            }
+        }
+        if (drvEtherIP_congestion_latency > 0.0  &&
+            transfer_time > drvEtherIP_congestion_latency)
+            congestion_decrease(scanlist->plc, count, first+1);
+        else
+            congestion_increase(scanlist->plc, count);
         /* Handle individual read/write responses */
-        for (info=info_position, i=0; i<count; info=DLL_next(TagInfo, info))
+        for (info=info_position, i=first; i<count; info=DLL_next(TagInfo, info))
         {
             if (info->cip_r_request_size <= 0 ||  info->cip_w_request_size <= 0)
                 continue;
+            items = (info->is_writing  &&  info->read_back) ? 2 : 1;
             info->transfer_time = transfer_time;
+            info->wire_time = wire_time;
             single_response = get_CIP_MultiRequest_Response(
                 response, rr_data.data_length, i, &single_response_size);
             if (! single_response)
                 return false;
-            if (EIP_verbosity >= 10)
+            if (EIP_verbose(10))
             {
                 EIP_printf(10, "Response #%d (%s):\n", i, info->string_tag);
                 EIP_dump_raw_MR_Response(single_response, 0);
             }
-            if (epicsMutexLock(info->data_lock) != epicsMutexLockOK)
-            {
+            if (EIP_lock_data(info) != epicsMutexLockOK)
+            {   /* Skip this tag, a write will be repeated in next scan */
                 EIP_printf_time(1, "EIP process_ScanList '%s': "
                            "no data lock (receive)\n", info->string_tag);
-                return false;
+                i += items;
+                continue;
             }
+            info->update_time = end_time;
+            wrote = info->is_writing;
             if (info->is_writing)
             {
                 if (!check_CIP_WriteData_Response(single_response,
@@ -765,13 +1978,32 @@ static eip_bool process_ScanList(EIPConnection *c, ScanList *scanlist)
                                info->string_tag);
                     info->valid_data_size = 0;
                 }
+                else if (items > 1  &&  !EIP_atomic_get(info->do_write))
+                {   /* Replace written data with read-back from PLC */
+                    single_response = get_CIP_MultiRequest_Response(
+                        response, rr_data.data_length, i+1,
+                        &single_response_size);
+                    data = single_response ?
+                        check_CIP_ReadData_Response(single_response,
+                                                    single_response_size,
+                                                    &data_size) : 0;
+                    if (data  &&  data_size > 0  &&
+                        scan_tag_data(scanlist->plc, info, data_size))
+                    {
+                        memcpy(info->data, data, data_size);
+                        info->valid_data_size = data_size;
+                    }
+                }
                 info->is_writing = false;
+                info->write_queue_time = epicsTimeDiffInSeconds(
+                    &start_time, &info->write_start_time);
+                info->write_transfer_time = transfer_time;
             }
             else /* not writing, reading */
             {
                 data = check_CIP_ReadData_Response(
                     single_response, single_response_size, &data_size);
-                if (info->do_write)
+                if (EIP_atomic_get(info->do_write))
                 {   /* Possible: Read request ... network delay ... response
                      * and record requested write during the delay.
                      * Ignore the read, because that would replace the data
@@ -781,11 +2013,12 @@ static eip_bool process_ScanList(EIPConnection *c, ScanList *scanlist)
                 }
                 else
                 {
-                    if (data_size > 0  && reserve_tag_data(info, data_size))
+                    if (data  &&  data_size > 0  &&
+                        scan_tag_data(scanlist->plc, info, data_size))
                     {
                         memcpy(info->data, data, data_size);
                         info->valid_data_size = data_size;
-                        if (EIP_verbosity >= 10)
+                        if (EIP_verbose(10))
                         {
                             elements = CIP_Type_size(get_CIP_typecode(data));
                             if (elements > 0)
@@ -806,55 +2039,440 @@ static eip_bool process_ScanList(EIPConnection *c, ScanList *scanlist)
                         info->valid_data_size = 0;
                 }
             }
-            epicsMutexUnlock(info->data_lock);
+            EIP_TRACE4(decode, scanlist->plc->name, info->string_tag,
+                       wrote, info->valid_data_size);
+            EIP_unlock_data(info);
             /* Call all registered callbacks for this tag
              * so that records can show new value */
             for (cb = DLL_first(TagCallback, &info->callbacks);
                  cb; cb=DLL_next(TagCallback, cb))
+            {
+                EIP_TRACE3(callback, scanlist->plc->name, info->string_tag,
+                           cb->arg);
                 (*cb->callback) (cb->arg);
-            ++i;
+            }
+            if (wrote)
+            {   /* Write latency statistics, PLC is locked */
+                epicsTimeGetCurrent(&done_time);
+                info->write_callback_time =
+                    epicsTimeDiffInSeconds(&done_time, &end_time);
+                drvEtherIP_histogram_add(&scanlist->plc->write_queue_histo,
+                                         info->write_queue_time);
+                drvEtherIP_histogram_add(&scanlist->plc->write_transfer_histo,
+                                         info->write_transfer_time);
+                drvEtherIP_histogram_add(&scanlist->plc->write_callback_histo,
+                                         info->write_callback_time);
+            }
+            i += items;
         }
         /* "info" now on next unread TagInfo or 0 */
     } /* while "info" ... */
     return true;
 }
 
-/* Scan task, one per PLC */
-static void PLC_scan_task(PLC *plc)
+/* Append elements from CIP ReadData response to FIFO.
+ * Index tag's data_lock is taken.
+ */
+static eip_bool append_fifo_data(EIPFifo *fifo, const CN_USINT *data,
+                                 size_t data_size, size_t expected)
 {
-    ScanList *list;
-    epicsTimeStamp    next_schedule, start_time, end_time;
-    double            timeout, delay, quantum;
-    eip_bool          transfer_ok, reset_next_schedule;
+    size_t elements, drop;
 
-    quantum = epicsThreadSleepQuantum();
-    timeout = (double)ETHERIP_TIMEOUT/1000.0;
-scan_loop: /* --------- The Scan Loop for one PLC -------- */
-    if (epicsMutexLock(plc->lock) != epicsMutexLockOK)
+    if (data_size <= CIP_Typecode_size)
+        return false;
+    if (CIP_Type_size(get_CIP_typecode(data)) != fifo->element_size)
     {
-        EIP_printf_time(1, "drvEtherIP scan task for PLC '%s'"
-                   " cannot take plc->lock\n", plc->name);
-        return;
+        EIP_printf(1, "EIP FIFO '%s': Type changed to 0x%X\n",
+                   fifo->string_tag, (unsigned) get_CIP_typecode(data));
+        return false;
     }
-    if (!assert_PLC_connect(plc))
-    {   /* don't rush since connection takes network bandwidth */
-        epicsMutexUnlock(plc->lock);
-        EIP_printf_time(2, "drvEtherIP: PLC '%s' is disconnected\n", plc->name);
-        epicsThreadSleep(timeout);
-        goto scan_loop;
+    memcpy(fifo->data, data, CIP_Typecode_size);
+    elements = (data_size - CIP_Typecode_size) / fifo->element_size;
+    if (elements != expected)
+        return false;
+    if (fifo->elements + elements > fifo->size)
+    {   /* Not consumed fast enough, drop the oldest elements */
+        drop = fifo->elements + elements - fifo->size;
+        drvEtherIP_fifo_consume(fifo, drop);
+        fifo->overruns += drop;
     }
-    EIP_printf_time(10, "drvEtherIP scan PLC '%s'\n", plc->name);
-    reset_next_schedule = true;
-    epicsTimeGetCurrent(&start_time);
-    for (list = DLL_first(ScanList,&plc->scanlists);
-         list;  list = DLL_next(ScanList,list))
-    {
-        if (! list->enabled)
-            continue;
-        if (epicsTimeLessThanEqual(&list->scheduled_time, &start_time))
-        {
+    memcpy(fifo->data + CIP_Typecode_size + fifo->elements*fifo->element_size,
+           data + CIP_Typecode_size, elements*fifo->element_size);
+    fifo->elements += elements;
+    return true;
+}
+
+/* After a scan list was processed, read the new elements
+ * of each FIFO whose index tag is on that list.
+ *
+ * Reads at most the elements that fit into one transfer,
+ * as one or, when wrapping around the end of the ring buffer,
+ * two requests. Remaining elements are read after the next scan.
+ *
+ * Returns false on communication error.
+ * Called by scan task, PLC is locked.
+ */
+static eip_bool drain_PLC_fifos(PLC *plc, ScanList *list)
+{
+    EIPConnection       *c = plc->connection;
+    EIPFifo             *fifo;
+    CN_UDINT            index, count, start, n[2];
+    size_t              i, items, max, request_sizes[2];
+    size_t              requests_size, multi_request_size;
+    size_t              single_response_size, data_size;
+    CN_USINT            *send_request, *multi_request, *request;
+    const CN_USINT      *response, *single_response, *data;
+    EncapsulationRRData rr_data;
+    TagCallback         *cb;
+    eip_bool            ok;
+
+    for (fifo = DLL_first(EIPFifo, &plc->fifos);  fifo;
+         fifo = DLL_next(EIPFifo, fifo))
+    {
+        if (fifo->index->scanlist != list  ||  !fifo->data)
+            continue;
+        if (EIP_lock_data(fifo->index) != epicsMutexLockOK)
+            continue;
+        ok = fifo->index->valid_data_size > 0  &&
+             get_CIP_UDINT(fifo->index->data, 0, &index);
+        EIP_unlock_data(fifo->index);
+        if (! ok)
+            continue;
+        if (! fifo->have_next)
+        {   /* Start with the elements written from now on */
+            fifo->next = index;
+            fifo->have_next = true;
+            continue;
+        }
+        if (! drvEtherIP_fifo_pending(fifo, index, &count))
+        {   /* PLC restarted its counter? Start over */
+            EIP_printf_time(2, "EIP FIFO '%s': Index went back to %u\n",
+                            fifo->string_tag, (unsigned)index);
+            fifo->next = index;
+            continue;
+        }
+        if (count == 0)
+            continue;
+        /* Limit to what fits into one response */
+        max = 1;
+        if (c->transfer_buffer_limit > CIP_MultiResponse_size(2, 2*6))
+            max = (c->transfer_buffer_limit - CIP_MultiResponse_size(2, 2*6))
+                / fifo->element_size;
+        if (count > max)
+            count = max;
+        start = fifo->next % fifo->size;
+        n[0] = count;
+        n[1] = 0;
+        if (start + count > fifo->size)
+        {   /* wrap around */
+            n[0] = fifo->size - start;
+            n[1] = count - n[0];
+        }
+        items = n[1] > 0 ? 2 : 1;
+        requests_size = 0;
+        for (i=0; i<items; ++i)
+        {
+            fifo->element->value.element = i==0 ? start : 0;
+            request_sizes[i] = CIP_ReadData_size(fifo->tag);
+            requests_size += request_sizes[i];
+        }
+        multi_request_size = CIP_MultiRequest_size(items, requests_size);
+        send_request = EIP_make_SendRRData(c,
+                            CM_Unconnected_Send_size(multi_request_size));
+        if (! send_request)
+            return false;
+        multi_request = make_CM_Unconnected_Send(send_request,
+                                                 multi_request_size, c->slot);
+        if (!(multi_request && prepare_CIP_MultiRequest(multi_request, items)))
+            return false;
+        for (i=0; i<items; ++i)
+        {
+            fifo->element->value.element = i==0 ? start : 0;
+            request = CIP_MultiRequest_item(multi_request, i, request_sizes[i]);
+            if (!(request && make_CIP_ReadData(request, fifo->tag, n[i])))
+                return false;
+        }
+        if (!EIP_send_connection_buffer(c)  ||  !EIP_read_connection_buffer(c))
+        {
+            EIP_printf_time(2, "EIP FIFO '%s': Transfer failed\n",
+                            fifo->string_tag);
+            return false;
+        }
+        response = EIP_unpack_RRData(c->buffer, &rr_data);
+        ok = check_CIP_MultiRequest_Response_partial(response,
+                                                     rr_data.data_length);
+        if (EIP_lock_data(fifo->index) != epicsMutexLockOK)
+            continue;
+        for (i=0; ok && i<items; ++i)
+        {
+            single_response = get_CIP_MultiRequest_Response(
+                response, rr_data.data_length, i, &single_response_size);
+            data = single_response ?
+                check_CIP_ReadData_Response(single_response,
+                                            single_response_size, &data_size)
+                : 0;
+            ok = data  &&  append_fifo_data(fifo, data, data_size, n[i]);
+        }
+        if (ok)
+            drvEtherIP_fifo_advance(fifo, index, count);
+        else
+        {   /* Start over with the next index */
+            EIP_printf_time(2, "EIP FIFO '%s': Cannot read %u elements at %u\n",
+                            fifo->string_tag, (unsigned)count, (unsigned)start);
+            fifo->have_next = false;
+        }
+        EIP_unlock_data(fifo->index);
+        if (ok)
+            for (cb = DLL_first(TagCallback, &fifo->callbacks);
+                 cb; cb=DLL_next(TagCallback, cb))
+                (*cb->callback) (cb->arg);
+    }
+    return true;
+}
+
+/* Add the values just read for the tags of list to their aggregates,
+ * publish those whose interval has passed.
+ * Called by scan task, PLC is locked.
+ */
+static void aggregate_PLC_tags(PLC *plc, ScanList *list)
+{
+    EIPAggregate *agg;
+    TagCallback  *cb;
+    double       value;
+    eip_bool     publish;
+
+    for (agg = DLL_first(EIPAggregate, &plc->aggregates);  agg;
+         agg = DLL_next(EIPAggregate, agg))
+    {
+        if (agg->tag->scanlist != list)
+            continue;
+        if (EIP_lock_data(agg->tag) != epicsMutexLockOK)
+            continue;
+        if (agg->tag->valid_data_size > 0  &&
+            agg->tag->elements > agg->element  &&
+            get_CIP_double(agg->tag->data, agg->element, &value))
+        {
+            if (agg->count == 0  ||  value < agg->min)
+                agg->min = value;
+            if (agg->count == 0  ||  value > agg->max)
+                agg->max = value;
+            agg->sum += value;
+            ++agg->count;
+        }
+        if (! is_time_set(&agg->start))
+            agg->start = agg->tag->update_time;
+        publish = epicsTimeDiffInSeconds(&agg->tag->update_time, &agg->start)
+                  >= agg->interval;
+        if (publish)
+        {
+            agg->pub_count = agg->count;
+            if (agg->count > 0)
+            {
+                agg->pub_min = agg->min;
+                agg->pub_max = agg->max;
+                agg->pub_mean = agg->sum / agg->count;
+            }
+            agg->count = 0;
+            agg->sum = 0.0;
+            /* Keep the cadence unless we fell behind */
+            epicsTimeAddSeconds(&agg->start, agg->interval);
+            if (epicsTimeLessThan(&agg->start, &agg->tag->update_time)  &&
+                epicsTimeDiffInSeconds(&agg->tag->update_time, &agg->start)
+                >= agg->interval)
+                agg->start = agg->tag->update_time;
+        }
+        EIP_unlock_data(agg->tag);
+        if (publish)
+            for (cb = DLL_first(TagCallback, &agg->callbacks);
+                 cb; cb=DLL_next(TagCallback, cb))
+                (*cb->callback) (cb->arg);
+    }
+}
+
+/* Apply options from drvEtherIP_PLC_thread to the calling scan task.
+ * Called by scan task, PLC is locked.
+ */
+#ifdef __linux__
+/* Touch EIP_PREFAULT_STACK bytes of stack below the caller,
+ * one byte per page, so that the pages are mapped (and with
+ * mlockall, locked) before the scan task needs them.
+ * Separate function so the array only exists while prefaulting.
+ */
+static void __attribute__((noinline)) prefault_stack(void)
+{
+    char          stack[EIP_PREFAULT_STACK];
+    volatile char *p = stack;
+    long          page = sysconf(_SC_PAGESIZE);
+    size_t        i;
+
+    if (page <= 0)
+        page = 4096;
+    for (i=0; i<sizeof(stack); i += page)
+        p[i] = 0;
+    p[sizeof(stack)-1] = 0;
+}
+
+static void apply_thread_options(PLC *plc)
+{
+    struct sched_param param;
+    cpu_set_t          cpus;
+    int                policy, first, last, error;
+    const char         *p;
+    char               *end;
+
+    plc->thread_update = false;
+    if (plc->thread_priority != 0)
+    {   /* >0: real-time, <0: best effort */
+        memset(&param, 0, sizeof(param));
+        policy = SCHED_OTHER;
+        if (plc->thread_priority > 0)
+        {
+            policy = SCHED_FIFO;
+            param.sched_priority = plc->thread_priority;
+        }
+        error = pthread_setschedparam(pthread_self(), policy, &param);
+        if (error)
+            EIP_printf(1, "drvEtherIP PLC '%s': Cannot set priority %d: %s\n",
+                       plc->name, plc->thread_priority, strerror(error));
+    }
+    if (plc->thread_cpus)
+    {   /* List like "2,3" or "2-3" */
+        CPU_ZERO(&cpus);
+        p = plc->thread_cpus;
+        while (*p)
+        {
+            first = last = strtol(p, &end, 10);
+            if (end == p)
+                break;
+            if (*end == '-')
+            {
+                p = end+1;
+                last = strtol(p, &end, 10);
+                if (end == p)
+                    break;
+            }
+            for (/**/; first <= last; ++first)
+                if (first >= 0  &&  first < CPU_SETSIZE)
+                    CPU_SET(first, &cpus);
+            p = end;
+            if (*p == ',')
+                ++p;
+            else if (*p)
+                break;
+        }
+        if (*p  ||  CPU_COUNT(&cpus) <= 0)
+            EIP_printf(1, "drvEtherIP PLC '%s': Invalid CPU list '%s'\n",
+                       plc->name, plc->thread_cpus);
+        else if ((error = pthread_setaffinity_np(pthread_self(),
+                                                 sizeof(cpus), &cpus)))
+            EIP_printf(1, "drvEtherIP PLC '%s': Cannot use CPUs '%s': %s\n",
+                       plc->name, plc->thread_cpus, strerror(error));
+    }
+    if (plc->lock_memory)
+    {   /* Lock all current and future pages of the IOC, prefault stack */
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+            EIP_printf(1, "drvEtherIP PLC '%s': Cannot lock memory: %s\n",
+                       plc->name, strerror(errno));
+        prefault_stack();
+    }
+}
+#else
+static void apply_thread_options(PLC *plc)
+{
+    plc->thread_update = false;
+#ifdef HAVE_314_API
+    if (plc->thread_priority > 0)
+        epicsThreadSetPriority(epicsThreadGetIdSelf(),
+                               plc->thread_priority > epicsThreadPriorityMax
+                               ? epicsThreadPriorityMax : plc->thread_priority);
+    else if (plc->thread_priority < 0)
+        epicsThreadSetPriority(epicsThreadGetIdSelf(), epicsThreadPriorityLow);
+#endif
+    if (plc->thread_cpus  ||  plc->lock_memory)
+        EIP_printf(2, "drvEtherIP PLC '%s': CPU and memory options "
+                   "are only supported on Linux\n", plc->name);
+}
+#endif
+
+/* Scan task, one per PLC */
+static void PLC_scan_task(PLC *plc)
+{
+    ScanList *list;
+    epicsTimeStamp    next_schedule, start_time, end_time, due;
+    double            timeout, delay, quantum, busy;
+    eip_bool          transfer_ok, reset_next_schedule, first_scan;
+    int               verbosity = -1;
+
+    quantum = epicsThreadSleepQuantum();
+    timeout = (double)ETHERIP_TIMEOUT/1000.0;
+scan_loop: /* --------- The Scan Loop for one PLC -------- */
+    if (EIP_lock_PLC(plc) != epicsMutexLockOK)
+    {
+        EIP_printf_time(1, "drvEtherIP scan task for PLC '%s'"
+                   " cannot take plc->lock\n", plc->name);
+        return;
+    }
+    if (plc->thread_update)
+        apply_thread_options(plc);
+    if (plc->verbosity != verbosity)
+    {
+        verbosity = plc->verbosity;
+        EIP_log_thread_verbosity(verbosity);
+    }
+    if (! EIP_atomic_get(plc->owned))
+    {   /* Another node of the cluster scans this PLC */
+        disconnect_PLC(plc);
+        EIP_unlock_PLC(plc);
+        epicsThreadSleep(timeout);
+        goto scan_loop;
+    }
+    if (!assert_PLC_connect(plc))
+    {   /* don't rush since connection takes network bandwidth */
+        EIP_unlock_PLC(plc);
+        EIP_printf_time(2, "drvEtherIP: PLC '%s' is disconnected\n", plc->name);
+        epicsThreadSleep(timeout);
+        goto scan_loop;
+    }
+    EIP_printf_time(10, "drvEtherIP scan PLC '%s'\n", plc->name);
+    reset_next_schedule = true;
+    epicsTimeGetCurrent(&start_time);
+    if (drvEtherIP_clock_period > 0.0  &&
+        epicsTimeDiffInSeconds(&start_time, &plc->clock_time)
+        >= drvEtherIP_clock_period)
+    {
+        read_PLC_clock(plc);
+        epicsTimeGetCurrent(&start_time);
+    }
+    if (drvEtherIP_change_period > 0.0  &&
+        epicsTimeDiffInSeconds(&start_time, &plc->status_time)
+        >= drvEtherIP_change_period)
+        check_PLC_change(plc);
+    if (plc->revalidate)
+    {
+        if (! revalidate_PLC_tags(plc))
+        {
+            ++plc->plc_errors;
+            disconnect_PLC(plc);
+            EIP_unlock_PLC(plc);
+            goto scan_loop;
+        }
+        epicsTimeGetCurrent(&start_time);
+    }
+    for (list = DLL_first(ScanList,&plc->scanlists);
+         list;  list = DLL_next(ScanList,list))
+    {
+        if (! list->enabled)
+            continue;
+        if (! is_time_set(&list->scheduled_time))
+            schedule_ScanList(list, &start_time);
+        get_due_time(list, &due);
+        if (epicsTimeLessThanEqual(&due, &start_time))
+        {
             epicsTimeGetCurrent(&list->scan_time);
-            transfer_ok = process_ScanList(plc->connection, list);
+            transfer_ok = process_ScanList(plc->connection, list)  &&
+                          drain_PLC_fifos(plc, list);
+            if (transfer_ok)
+                aggregate_PLC_tags(plc, list);
             epicsTimeGetCurrent(&end_time);
             list->last_scan_time =
                 epicsTimeDiffInSeconds(&end_time, &list->scan_time);
@@ -866,29 +2484,52 @@ scan_loop: /* --------- The Scan Loop for one PLC -------- */
                 list->min_scan_time = list->last_scan_time;
             if (transfer_ok) /* re-schedule exactly */
             {
-                list->scheduled_time = list->scan_time;
-                epicsTimeAddSeconds(&list->scheduled_time, list->period);
+                list->scanned_once = true;
+                if (list->phase >= 0.0  ||  drvEtherIP_stagger)
+                {   /* Keep phase, skip to next one when late */
+                    epicsTimeAddSeconds(&list->scheduled_time, list->period);
+                    if (epicsTimeLessThan(&list->scheduled_time, &end_time))
+                        schedule_ScanList(list, &end_time);
+                }
+                else
+                {
+                    list->scheduled_time = list->scan_time;
+                    epicsTimeAddSeconds(&list->scheduled_time, list->period);
+                }
             }
             else
-            {  	/* end_time+fixed delay, ignore extra due to error */
-                list->scheduled_time = end_time;
-                epicsTimeAddSeconds(&list->scheduled_time, timeout);
+            {  	/* end_time+fixed delay, ignore extra due to error,
+                 * then back to the list's phase */
+                epicsTimeAddSeconds(&end_time, timeout);
+                schedule_ScanList(list, &end_time);
                 ++list->list_errors;
                 ++plc->plc_errors;
                 disconnect_PLC(plc);
-                epicsMutexUnlock(plc->lock);
+                EIP_unlock_PLC(plc);
                 goto scan_loop;
             }
         }
         /* Update time for list that's due next */
+        get_due_time(list, &due);
         if (reset_next_schedule ||
-            epicsTimeLessThan(&list->scheduled_time, &next_schedule))
+            epicsTimeLessThan(&due, &next_schedule))
         {
             reset_next_schedule = false;
-            next_schedule = list->scheduled_time;
+            next_schedule = due;
         }
     }
-    epicsMutexUnlock(plc->lock);
+    /* Time spent in transfers, for the cluster's load estimate */
+    busy = 0.0;
+    for (list = DLL_first(ScanList,&plc->scanlists);
+         list;  list = DLL_next(ScanList,list))
+        if (list->enabled  &&  list->period > 0.0)
+            busy += list->last_scan_time / list->period;
+    EIP_atomic_set(plc->busy, (int) (busy * 1000));
+    /* Only the scan task sets boot_scanned, can read it without boot.lock */
+    first_scan = !is_time_set(&plc->boot_scanned)  &&  boot_all_scanned(plc);
+    EIP_unlock_PLC(plc);
+    if (first_scan)
+        boot_check_done(plc);
     /* fallback for empty/degenerate scan list */
     if (reset_next_schedule)
         delay = EIP_MIN_TIMEOUT;
@@ -933,18 +2574,24 @@ scan_loop: /* --------- The Scan Loop for one PLC -------- */
 /* Find PLC entry by name, maybe create a new one if not found */
 static PLC *get_PLC(const char *name, eip_bool create)
 {
-    PLC *plc;
+    PLC    *plc;
+    size_t index = 0;
     for (plc = DLL_first(PLC,&drvEtherIP_private.PLCs);  plc;
          plc = DLL_next(PLC,plc))
     {
         if (strcmp(plc->name, name) == 0)
             return plc;
+        ++index;
     }
     if (! create)
         return 0;
     plc = new_PLC(name);
     if (plc)
+    {
+        plc->index = index;
         DLL_append(&drvEtherIP_private.PLCs, plc);
+        set_owned(plc, ! cluster_active);
+    }
     return plc;
 }
 
@@ -999,6 +2646,9 @@ void drvEtherIP_init ()
     if (! drvEtherIP_private.lock)
         EIP_printf (0, "drvEtherIP_init cannot create mutex!\n");
     DLL_init (&drvEtherIP_private.PLCs);
+    DLL_init (&drvEtherIP_private.sync_groups);
+    epicsTimeGetCurrent(&boot.start);
+    boot.lock = epicsMutexCreate();
 #ifdef HAVE_314_API
     drvEtherIP_Register();
 #endif
@@ -1020,6 +2670,34 @@ void drvEtherIP_help()
     printf("    double drvEtherIP_default_rate = <seconds>\n");
     printf("    -  define the default scan rate\n");
     printf("       (if neither SCAN nor INP/OUT provide one)\n");
+    printf("    double drvEtherIP_clock_period = <seconds> (currently %g)\n",
+           drvEtherIP_clock_period);
+    printf("    -  how often to read the PLC wall clock, 0 to disable\n");
+    printf("    double drvEtherIP_change_period = <seconds> (currently %g)\n",
+           drvEtherIP_change_period);
+    printf("    -  how often to check the PLC for program changes, 0 to disable\n");
+    printf("    int drvEtherIP_forbid_scan_alloc = 0/1 (currently %d)\n",
+           drvEtherIP_forbid_scan_alloc);
+    printf("    -  1 to drop data instead of allocating buffers in the scan task\n");
+    printf("    int drvEtherIP_stagger = 0/1 (currently %d)\n",
+           drvEtherIP_stagger);
+    printf("    -  1 to spread scan lists of all PLCs over their period\n");
+    printf("    int drvEtherIP_congestion = 0/1 (currently %d)\n",
+           drvEtherIP_congestion);
+    printf("    -  1 to reduce the transfer size when the PLC is overloaded\n");
+    printf("    double drvEtherIP_congestion_latency = <seconds> (currently %g)\n",
+           drvEtherIP_congestion_latency);
+    printf("    -  slower transfers also reduce the size, 0 to disable\n");
+    printf("    int drvEtherIP_read_after_write = 0/1 (currently %d)\n",
+           drvEtherIP_read_after_write);
+    printf("    -  1 to read tags back in the same transfer that writes them\n");
+    printf("    int EIP_log_subsystems = <mask> (currently 0x%X)\n",
+           EIP_log_subsystems);
+    printf("    -  subsystems that print messages: 1 transport, 2 CIP codec,\n");
+    printf("       4 scan lists and transfers, 8 device support\n");
+    printf("    drvEtherIP_PLC_verbosity <plc>, <level>\n");
+    printf("    -  use <level> instead of EIP_verbosity for the scan task\n");
+    printf("       of one PLC, -1 to go back to EIP_verbosity\n");
     printf("    int EIP_buffer_limit = <bytes> (currently %d)\n", EIP_buffer_limit);
     printf("    -  Set buffer limit enforced by driver. Default: %d\n", EIP_DEFAULT_BUFFER_LIMIT);
     printf("       The actual PLC limit is unknown, it might depend on the PLC or ENET model.\n");
@@ -1027,6 +2705,13 @@ void drvEtherIP_help()
     printf("    drvEtherIP_define_PLC <name>, <ip_addr>, <slot>\n");
     printf("    -  define a PLC name (used by EPICS records) as IP\n");
     printf("       (DNS name or dot-notation) and slot (0...)\n");
+    printf("    drvEtherIP_PLC_thread <plc>, <priority>, <cpus>, <lock_memory>\n");
+    printf("    -  scan task of PLC: priority >0 real-time (SCHED_FIFO),\n");
+    printf("       <0 best effort, 0 default; CPU list like \"2,3\" or \"\";\n");
+    printf("       lock_memory 1 to lock IOC memory and prefault the stack\n");
+    printf("    drvEtherIP_define_timestamp_tag <plc>, <tag>\n");
+    printf("    -  LINT or DINT[2] tag with PLC wall clock microseconds,\n");
+    printf("       read with each transfer to determine the data age\n");
     printf("    drvEtherIP_read_tag <ip>, <slot>, <tag>, <elm.>, <timeout>\n");
     printf("    -  call to test a round-trip single tag read\n");
     printf("       ip: IP address (numbers or name known by IOC\n");
@@ -1037,11 +2722,53 @@ void drvEtherIP_help()
     printf("    drvEtherIP_dump\n");
     printf("    -  dump all tags and values; short version of ..._report\n");
     printf("    drvEtherIP_reset_statistics\n");
-    printf("    -  reset error counts and min/max scan times\n");
+    printf("    -  reset error counts, min/max scan times and histograms\n");
+    printf("    int drvEtherIP_lock_stats = 0/1 (currently %d)\n",
+           drvEtherIP_lock_stats);
+    printf("    drvEtherIP_lock_report\n");
+    printf("    -  show use of driver locks, waits and hold times\n");
+    printf("    drvEtherIP_delay_report\n");
+    printf("    -  show delay from received data to I/O Intr record processing\n");
     printf("    drvEtherIP_restart\n");
     printf("    -  in case of communication errors, driver will restart,\n");
     printf("       so calling this one directly shouldn't be necessary\n");
     printf("       but is possible\n");
+    printf("    drvEtherIP_restart_PLC <plc>\n");
+    printf("    -  disconnect one PLC, its scan task reconnects\n");
+    printf("    drvEtherIP_scanlist_period <plc>, <period>, <new period>\n");
+    printf("    -  change period of a scan list, merging it into an\n");
+    printf("       existing list of the new period\n");
+    printf("    drvEtherIP_scanlist_enable <plc>, <period>, <0/1>\n");
+    printf("    -  disable (invalidating its tags) or enable a scan list\n");
+    printf("    drvEtherIP_scanlist_phase <plc>, <period>, <phase>\n");
+    printf("    -  start scans of the list at <phase> seconds within\n");
+    printf("       each period, -1 for automatic\n");
+    printf("    drvEtherIP_sync_group <group>, <plc>, <period>, <phase>\n");
+    printf("    -  read the scan list of the PLC with the other lists of\n");
+    printf("       the group at the same instant\n");
+    printf("    double drvEtherIP_sync_lead = <seconds> (currently %g)\n",
+           drvEtherIP_sync_lead);
+    printf("    -  how early scan tasks prepare sync group requests\n");
+    printf("    drvEtherIP_move_tag <plc>, <tag>, <period>\n");
+    printf("    -  move tag to the scan list of given period\n");
+    printf("    drvEtherIP_snapshot_save <plc>, <file>\n");
+    printf("    -  save last known data of all tags of the PLC to file\n");
+    printf("    drvEtherIP_snapshot_restore <plc>, <file>\n");
+    printf("    -  write tags from snapshot file to the PLC, then read back\n");
+    printf("       to verify. Blocks the PLC's scan task while running.\n");
+    printf("    drvEtherIP_stats_write <file>, <format>\n");
+    printf("    -  write statistics of all PLCs, lists and tags to file,\n");
+    printf("       format \"json\" or \"prometheus\"\n");
+    printf("    drvEtherIP_stats_export <file>, <format>, <period>\n");
+    printf("    -  write the statistics file every <period> seconds,\n");
+    printf("       0 to stop\n");
+    printf("    drvEtherIP_boot_report\n");
+    printf("    -  show time spent in boot phases and per PLC\n");
+    printf("    drvEtherIP_boot_trace <file>\n");
+    printf("    -  write boot timeline as Chrome trace JSON\n");
+    printf("    drvEtherIP_cluster <directory>, <node>, <period>, <timeout>\n");
+    printf("    -  share the PLCs with other IOCs that use the directory,\n");
+    printf("       scanning only those that this node owns. 0 to stop\n");
     printf("\n");
 }
 
@@ -1049,8 +2776,11 @@ void drvEtherIP_help()
 long drvEtherIP_report(int level)
 {
     PLC *plc;
+    EIPSyncGroup *group;
     EIPIdentityInfo *ident;
     ScanList *list;
+    EIPFifo *fifo;
+    EIPAggregate *agg;
     epicsTimeStamp now;
     char tsString[50];
 
@@ -1074,6 +2804,9 @@ long drvEtherIP_report(int level)
          plc;  plc = DLL_next(PLC,plc))
     {
         printf ("* PLC '%s', IP '%s'\n", plc->name, plc->ip_addr);
+        if (cluster_active)
+            printf("  cluster owner         : '%s'%s\n", plc->owner,
+                   EIP_atomic_get(plc->owned) ? ", scanned by this IOC" : "");
         if (level > 1)
         {
             ident = &plc->connection->info;
@@ -1085,7 +2818,76 @@ long drvEtherIP_report(int level)
                    (unsigned)ident->serial_number);
 
             printf("  scan thread slow count: %u\n", (unsigned)plc->slow_scans);
+            if (plc->thread_priority  ||  plc->thread_cpus  ||
+                plc->lock_memory)
+                printf("  scan thread options   : priority %d, CPUs '%s'%s\n",
+                       plc->thread_priority,
+                       (plc->thread_cpus ? plc->thread_cpus : "any"),
+                       (plc->lock_memory ? ", memory locked" : ""));
+            if (plc->verbosity >= 0)
+                printf("  scan thread verbosity : %d\n", plc->verbosity);
             printf("  connection errors     : %u\n", (unsigned)plc->plc_errors);
+            if (plc->scan_allocs > 0)
+                printf("  scan task allocations : %u\n",
+                       (unsigned)plc->scan_allocs);
+            if (plc->congestion_events > 0)
+            {
+                printf("  congestion events     : %u\n",
+                       (unsigned)plc->congestion_events);
+                printf("  transfer limit        : %u of %u bytes, ",
+                       (unsigned)plc->congestion_limit,
+                       (unsigned)plc->connection->transfer_buffer_limit);
+                printf("%u requests\n", (unsigned)plc->congestion_count);
+            }
+            if (plc->clock_samples > 0  ||  plc->clock_errors > 0)
+            {
+                printf("  PLC clock offset      : %g secs +- %g\n",
+                       plc->clock_offset, plc->clock_delay/2);
+                printf("  min/max clock offset  : %g / %g secs\n",
+                       plc->min_clock_offset, plc->max_clock_offset);
+                printf("  clock read errors     : %u\n",
+                       (unsigned)plc->clock_errors);
+            }
+            if (plc->timestamp_tag)
+                printf("  time stamp tag        : '%s'\n",
+                       plc->timestamp_tag->string_tag);
+            if (plc->have_status)
+                printf("  controller status     : 0x%04X\n",
+                       (unsigned)plc->plc_status);
+            if (plc->program_changes > 0)
+                printf("  program changes       : %u, %u changed tags%s\n",
+                       (unsigned)plc->program_changes,
+                       (unsigned)plc->changed_tags,
+                       (plc->revalidate ? " (checking)" : ""));
+            for (fifo = DLL_first(EIPFifo, &plc->fifos);  fifo;
+                 fifo = DLL_next(EIPFifo, fifo))
+                printf("  FIFO '%s'[%u], index '%s': "
+                       "%u buffered, %u overruns\n",
+                       fifo->string_tag, (unsigned)fifo->size,
+                       fifo->index->string_tag,
+                       (unsigned)fifo->elements, (unsigned)fifo->overruns);
+            for (agg = DLL_first(EIPAggregate, &plc->aggregates);  agg;
+                 agg = DLL_next(EIPAggregate, agg))
+                printf("  Aggregate '%s'[%u] every %g secs: "
+                       "%u reads, min %g, max %g, mean %g\n",
+                       agg->tag->string_tag, (unsigned)agg->element,
+                       agg->interval, (unsigned)agg->pub_count,
+                       agg->pub_min, agg->pub_max, agg->pub_mean);
+            if (plc->transfer_histo.count > 0)
+                drvEtherIP_histogram_report("transfer time",
+                                            &plc->transfer_histo);
+            if (plc->wire_histo.count > 0)
+                drvEtherIP_histogram_report("wire transfer time",
+                                            &plc->wire_histo);
+            if (plc->write_transfer_histo.count > 0)
+            {
+                drvEtherIP_histogram_report("write queue time",
+                                            &plc->write_queue_histo);
+                drvEtherIP_histogram_report("write transfer time",
+                                            &plc->write_transfer_histo);
+                drvEtherIP_histogram_report("write callback time",
+                                            &plc->write_callback_histo);
+            }
         }
         if (level > 2)
         {
@@ -1120,6 +2922,24 @@ long drvEtherIP_report(int level)
             }
         }
     }
+    for (group = DLL_first(EIPSyncGroup, &drvEtherIP_private.sync_groups);
+         group;  group = DLL_next(EIPSyncGroup, group))
+    {
+        printf("* Sync group '%s', %g secs, phase %g secs, %u scan lists\n",
+               group->name, group->period, group->phase,
+               (unsigned)group->members);
+        if (level > 1)
+        {
+            epicsMutexLock(group->lock);
+            printf("  samples               : %u, %u incomplete\n",
+                   (unsigned)group->samples, (unsigned)group->incomplete);
+            printf("  skew                  : %g secs, max %g secs\n",
+                   group->skew, group->max_skew);
+            if (group->skew_histo.count > 0)
+                drvEtherIP_histogram_report("skew", &group->skew_histo);
+            epicsMutexUnlock(group->lock);
+        }
+    }
     printf("\n");
     return 0;
 }
@@ -1130,11 +2950,11 @@ void drvEtherIP_dump ()
     ScanList *list;
     TagInfo  *info;
 
-    epicsMutexLock(drvEtherIP_private.lock);
+    EIP_lock_driver();
     for (plc = DLL_first(PLC,&drvEtherIP_private.PLCs);
          plc;  plc=DLL_next(PLC,plc))
     {
-        epicsMutexLock(plc->lock);
+        EIP_lock_PLC(plc);
         printf ("PLC %s\n", plc->name);
         for (list=DLL_first(ScanList, &plc->scanlists); list;
              list=DLL_next(ScanList, list))
@@ -1143,38 +2963,150 @@ void drvEtherIP_dump ()
                  info=DLL_next(TagInfo, info))
             {
                 EIP_printf(0, "%s ", info->string_tag);
-                epicsMutexLock(info->data_lock);
+                EIP_lock_data(info);
                 if (info->valid_data_size > 0)
                     dump_raw_CIP_data(info->data, info->elements);
                 else
                     printf(" - no data -\n");
-                epicsMutexUnlock(info->data_lock);
+                EIP_unlock_data(info);
             }
         }
-        epicsMutexUnlock(plc->lock);
+        EIP_unlock_PLC(plc);
     }
-    epicsMutexUnlock(drvEtherIP_private.lock);
+    EIP_unlock_driver();
     printf("\n");
 }
 
 void drvEtherIP_reset_statistics ()
 {
     PLC *plc;
+    EIPSyncGroup *group;
     ScanList *list;
+    EIPFifo *fifo;
 
-    epicsMutexLock(drvEtherIP_private.lock);
+    EIP_lock_driver();
+    reset_lock_stats(&drvEtherIP_private.lock_stats);
     for (plc = DLL_first(PLC,&drvEtherIP_private.PLCs);
          plc;  plc = DLL_next(PLC,plc))
     {
-        epicsMutexLock(plc->lock);
+        EIP_lock_PLC(plc);
+        reset_lock_stats(&plc->lock_stats);
         plc->plc_errors = 0;
         plc->slow_scans = 0;
+        plc->clock_errors = 0;
+        plc->scan_allocs = 0;
+        plc->congestion_events = 0;
+        plc->program_changes = plc->changed_tags = 0;
+        for (fifo = DLL_first(EIPFifo, &plc->fifos);  fifo;
+             fifo = DLL_next(EIPFifo, fifo))
+            fifo->overruns = 0;
+        plc->min_clock_offset = plc->max_clock_offset = 0.0;
+        memset(&plc->write_queue_histo, 0, sizeof(EIPHistogram));
+        memset(&plc->write_transfer_histo, 0, sizeof(EIPHistogram));
+        memset(&plc->write_callback_histo, 0, sizeof(EIPHistogram));
+        memset(&plc->transfer_histo, 0, sizeof(EIPHistogram));
+        memset(&plc->wire_histo, 0, sizeof(EIPHistogram));
         for (list=DLL_first(ScanList, &plc->scanlists); list;
              list=DLL_next(ScanList, list))
             reset_ScanList (list);
-        epicsMutexUnlock(plc->lock);
+        epicsMutexLock(plc->stats_lock);
+        reset_lock_stats(&plc->data_lock_stats);
+        memset(plc->update_delay_histo, 0, sizeof(plc->update_delay_histo));
+        epicsMutexUnlock(plc->stats_lock);
+        EIP_unlock_PLC(plc);
     }
-    epicsMutexUnlock(drvEtherIP_private.lock);
+    for (group = DLL_first(EIPSyncGroup, &drvEtherIP_private.sync_groups);
+         group;  group = DLL_next(EIPSyncGroup, group))
+    {
+        epicsMutexLock(group->lock);
+        group->skew = group->max_skew = 0.0;
+        group->samples = group->incomplete = 0;
+        memset(&group->skew_histo, 0, sizeof(EIPHistogram));
+        epicsMutexUnlock(group->lock);
+    }
+    EIP_unlock_driver();
+}
+
+static const char *record_type_names[EIP_REC_TYPES] =
+{
+    "ai", "bi", "mbbi", "mbbiDirect", "stringin", "waveform"
+};
+
+void drvEtherIP_add_update_delay(TagInfo *tag, EIPRecordType type)
+{
+    PLC            *plc = tag->scanlist->plc;
+    epicsTimeStamp now;
+    double         delay;
+
+    /* Record processed without new data, e.g. after a disconnect */
+    if (tag->valid_data_size == 0  ||  !is_time_set(&tag->update_time))
+        return;
+    epicsTimeGetCurrent(&now);
+    delay = epicsTimeDiffInSeconds(&now, &tag->update_time);
+    if (epicsMutexLock(plc->stats_lock) != epicsMutexLockOK)
+        return;
+    drvEtherIP_histogram_add(&plc->update_delay_histo[type], delay);
+    epicsMutexUnlock(plc->stats_lock);
+}
+
+static void show_update_delay(const char *name, const EIPHistogram *histo)
+{
+    if (histo->count <= 0)
+        return;
+    printf("  %-12s %8lu %10.6f %10.6f %10.6f %10.6f\n",
+           name, (unsigned long)histo->count,
+           drvEtherIP_histogram_percentile(histo, 0.5),
+           drvEtherIP_histogram_percentile(histo, 0.9),
+           drvEtherIP_histogram_percentile(histo, 0.99),
+           histo->max);
+}
+
+static void add_histogram(EIPHistogram *sum, const EIPHistogram *histo)
+{
+    size_t i;
+    sum->count += histo->count;
+    sum->total += histo->total;
+    if (histo->max > sum->max)
+        sum->max = histo->max;
+    for (i=0; i<EIP_HISTO_BINS; ++i)
+        sum->bins[i] += histo->bins[i];
+}
+
+void drvEtherIP_delay_report()
+{
+    PLC          *plc;
+    EIPHistogram per_type[EIP_REC_TYPES], copy[EIP_REC_TYPES], per_plc;
+    size_t       t;
+
+    if (drvEtherIP_private.lock == 0)
+    {
+        printf("drvEtherIP lock is 0, did you call drvEtherIP_init?\n");
+        return;
+    }
+    printf("Delay from receiving data until I/O Intr records read it [secs]\n");
+    printf("               count     50%%        90%%        99%%        max\n");
+    memset(per_type, 0, sizeof(per_type));
+    EIP_lock_driver();
+    for (plc = DLL_first(PLC,&drvEtherIP_private.PLCs);
+         plc;  plc = DLL_next(PLC,plc))
+    {
+        epicsMutexLock(plc->stats_lock);
+        memcpy(copy, plc->update_delay_histo, sizeof(copy));
+        epicsMutexUnlock(plc->stats_lock);
+        printf("* PLC '%s'\n", plc->name);
+        memset(&per_plc, 0, sizeof(per_plc));
+        for (t=0; t<EIP_REC_TYPES; ++t)
+        {
+            show_update_delay(record_type_names[t], &copy[t]);
+            add_histogram(&per_plc, &copy[t]);
+            add_histogram(&per_type[t], &copy[t]);
+        }
+        show_update_delay("all", &per_plc);
+    }
+    EIP_unlock_driver();
+    printf("* All PLCs\n");
+    for (t=0; t<EIP_REC_TYPES; ++t)
+        show_update_delay(record_type_names[t], &per_type[t]);
 }
 
 /* Create a PLC entry:
@@ -1186,7 +3118,7 @@ eip_bool drvEtherIP_define_PLC(const char *PLC_name,
 {
     PLC *plc;
 
-    epicsMutexLock(drvEtherIP_private.lock);
+    EIP_lock_driver();
     plc = get_PLC(PLC_name, true);
     if (plc)
     {
@@ -1198,31 +3130,116 @@ eip_bool drvEtherIP_define_PLC(const char *PLC_name,
     	plc->ip_addr = EIP_strdup(ip_addr);
         plc->slot = slot;
     }
-    epicsMutexUnlock(drvEtherIP_private.lock);
+    EIP_unlock_driver();
     return plc  &&  plc->ip_addr;
 }
 
+/* Configure scan task of PLC.
+ * priority: >0 real-time priority, <0 best effort, 0 default
+ * cpus: CPU list like "2,3" or "0-3", empty for any
+ * lock_memory: lock IOC memory and prefault scan task stack
+ */
+eip_bool drvEtherIP_PLC_thread(const char *PLC_name, int priority,
+                               const char *cpus, int lock_memory)
+{
+    PLC *plc;
+
+    plc = drvEtherIP_find_PLC(PLC_name);
+    if (! plc)
+    {
+        EIP_printf(1, "drvEtherIP_PLC_thread: Unknown PLC '%s'\n", PLC_name);
+        return false;
+    }
+    EIP_lock_PLC(plc);
+    plc->thread_priority = priority;
+    free(plc->thread_cpus);
+    plc->thread_cpus = (cpus && *cpus) ? EIP_strdup(cpus) : 0;
+    plc->lock_memory = lock_memory != 0;
+    /* Running scan task applies them on the next turn */
+    plc->thread_update = true;
+    EIP_unlock_PLC(plc);
+    return true;
+}
+
+/* Set verbosity for the scan task of one PLC, -1 for EIP_verbosity */
+eip_bool drvEtherIP_PLC_verbosity(const char *PLC_name, int level)
+{
+    PLC *plc, *p;
+    int max = -1;
+
+    EIP_lock_driver();
+    plc = get_PLC(PLC_name, /*create*/ false);
+    if (plc)
+    {   /* Scan task picks it up on its next turn */
+        plc->verbosity = level < 0 ? -1 : level;
+        for (p = DLL_first(PLC,&drvEtherIP_private.PLCs);
+             p;  p = DLL_next(PLC,p))
+            if (p->verbosity > max)
+                max = p->verbosity;
+        EIP_log_max_verbosity = max;
+    }
+    EIP_unlock_driver();
+    if (! plc)
+    {
+        EIP_printf(1, "drvEtherIP_PLC_verbosity: Unknown PLC '%s'\n",
+                   PLC_name);
+        return false;
+    }
+    return true;
+}
+
 /* Returns PLC or 0 if not found */
 PLC *drvEtherIP_find_PLC (const char *PLC_name)
 {
     PLC *plc;
 
-    epicsMutexLock(drvEtherIP_private.lock);
+    EIP_lock_driver();
     plc = get_PLC(PLC_name, /*create*/ false);
-    epicsMutexUnlock (drvEtherIP_private.lock);
+    EIP_unlock_driver();
     return plc;
 }
 
+eip_bool drvEtherIP_define_timestamp_tag(const char *PLC_name,
+                                         const char *string_tag)
+{
+    PLC     *plc;
+    TagInfo *info;
+
+    plc = drvEtherIP_find_PLC(PLC_name);
+    if (! plc)
+    {
+        EIP_printf(1, "drvEtherIP_define_timestamp_tag: Unknown PLC '%s'\n",
+                   PLC_name);
+        return false;
+    }
+    info = new_TagInfo(string_tag, 1);
+    if (! info)
+        return false;
+    info->lock_stats = &plc->data_lock_stats;
+    EIP_lock_PLC(plc);
+    if (plc->timestamp_tag)
+        EIP_printf(1, "Redefining time stamp tag of PLC %s?\n", PLC_name);
+    plc->timestamp_tag = info;
+    if (plc->connection->sock)
+        complete_timestamp_tag(plc);
+    EIP_unlock_PLC(plc);
+    return true;
+}
+
 /* After the PLC is defined with drvEtherIP_define_PLC,
  * tags can be added
  */
 TagInfo *drvEtherIP_add_tag(PLC *plc, double period,
                             const char *string_tag, size_t elements)
 {
-    ScanList *list;
-    TagInfo  *info;
+    ScanList    *list;
+    TagInfo     *info;
+    TagCallback *cb;
 
-    epicsMutexLock(plc->lock);
+    epicsTimeStamp start;
+
+    epicsTimeGetCurrent(&start);
+    EIP_lock_PLC(plc);
     if (find_PLC_tag(plc, string_tag, &list, &info))
     {   /* check if period is OK */
         if (list->period > period)
@@ -1231,9 +3248,10 @@ TagInfo *drvEtherIP_add_tag(PLC *plc, double period,
             list = get_PLC_ScanList(plc, period, true);
             if (!list)
             {
-                epicsMutexUnlock(plc->lock);
+                EIP_unlock_PLC(plc);
                 EIP_printf(2, "drvEtherIP: cannot create list at %g secs"
                            "for tag '%s'\n", period, string_tag);
+                drvEtherIP_boot_phase(EIP_BOOT_ADD_TAG, &start);
                 return 0;
             }
             add_ScanList_TagInfo(list, info);
@@ -1253,49 +3271,283 @@ TagInfo *drvEtherIP_add_tag(PLC *plc, double period,
             info = 0;
         }
     }
-    epicsMutexUnlock(plc->lock);
+    if (info)
+    {   /* Spare for the callback of the record that added the tag,
+         * so drvEtherIP_add_callback doesn't allocate later */
+        cb = (TagCallback *) calloc(1, sizeof (TagCallback));
+        if (cb)
+            DLL_append(&plc->free_callbacks, cb);
+    }
+    EIP_unlock_PLC(plc);
+    drvEtherIP_boot_phase(EIP_BOOT_ADD_TAG, &start);
     return info;
 }
 
-void  drvEtherIP_add_callback (PLC *plc, TagInfo *info,
-                               EIPCallback callback, void *arg)
+void drvEtherIP_set_priority(PLC *plc, TagInfo *info)
+{
+    ScanList *list;
+
+    EIP_lock_PLC(plc);
+    if (! info->priority)
+    {   /* move to the end of the priority tags */
+        info->priority = true;
+        list = info->scanlist;
+        remove_ScanList_TagInfo(list, info);
+        add_ScanList_TagInfo(list, info);
+    }
+    EIP_unlock_PLC(plc);
+}
+
+/* Add callback to list unless already there.
+ * Reuses removed TagCallbacks of the PLC.
+ * PLC is locked.
+ */
+static void add_TagCallback(PLC *plc, DL_List *callbacks,
+                            EIPCallback callback, void *arg)
 {
     TagCallback *cb;
-    epicsMutexLock(plc->lock);
-    for (cb = DLL_first(TagCallback, &info->callbacks);
+    for (cb = DLL_first(TagCallback, callbacks);
          cb;  cb = DLL_next(TagCallback, cb))
     {
         if (cb->callback == callback  &&  cb->arg == arg)
+            return;
+    }
+    /* Add new one, normally the spare from drvEtherIP_add_tag */
+    cb = DLL_decap(&plc->free_callbacks);
+    if (! cb)
+    {   /* Allocate even with drvEtherIP_forbid_scan_alloc,
+         * a missing callback would silently stop a record */
+        if (is_scan_task(plc))
+            ++plc->scan_allocs;
+        if (!(cb = (TagCallback *) malloc(sizeof (TagCallback))))
         {
-            epicsMutexUnlock(plc->lock);
+            EIP_printf(0, "EIP PLC '%s': No memory for callback\n",
+                       plc->name);
             return;
         }
     }
-    /* Add new one */
-    if (!(cb = (TagCallback *) malloc(sizeof (TagCallback))))
-        return;
     cb->callback = callback;
     cb->arg      = arg;
-    DLL_append(&info->callbacks, cb);
-    epicsMutexUnlock(plc->lock);
+    DLL_append(callbacks, cb);
 }
 
-void drvEtherIP_remove_callback (PLC *plc, TagInfo *info,
-                                 EIPCallback callback, void *arg)
+/* Remove callback from list, keep it for reuse. PLC is locked. */
+static void remove_TagCallback(PLC *plc, DL_List *callbacks,
+                               EIPCallback callback, void *arg)
 {
     TagCallback *cb;
-    epicsMutexLock(plc->lock);
-    for (cb = DLL_first(TagCallback, &info->callbacks);
+    for (cb = DLL_first(TagCallback, callbacks);
          cb;  cb=DLL_next(TagCallback, cb))
     {
         if (cb->callback == callback  &&  cb->arg == arg)
         {
-            DLL_unlink(&info->callbacks, cb);
-            free(cb);
+            DLL_unlink(callbacks, cb);
+            DLL_append(&plc->free_callbacks, cb);
             break;
         }
     }
-    epicsMutexUnlock(plc->lock);
+}
+
+void  drvEtherIP_add_callback (PLC *plc, TagInfo *info,
+                               EIPCallback callback, void *arg)
+{
+    EIP_lock_PLC(plc);
+    add_TagCallback(plc, &info->callbacks, callback, arg);
+    EIP_unlock_PLC(plc);
+}
+
+void drvEtherIP_remove_callback (PLC *plc, TagInfo *info,
+                                 EIPCallback callback, void *arg)
+{
+    EIP_lock_PLC(plc);
+    remove_TagCallback(plc, &info->callbacks, callback, arg);
+    EIP_unlock_PLC(plc);
+}
+
+EIPFifo *drvEtherIP_add_fifo(PLC *plc, double period,
+                             const char *string_tag,
+                             const char *index_tag, size_t size,
+                             void *owner)
+{
+    EIPFifo   *fifo;
+    TagInfo   *index;
+    ParsedTag *node;
+    char      buffer[EIP_MAX_TAG_LENGTH];
+
+    if (size <= 0  ||  strlen(string_tag) + 4 >= sizeof(buffer))
+    {
+        EIP_printf(2, "drvEtherIP: invalid FIFO '%s', size %lu\n",
+                   string_tag, (unsigned long)size);
+        return 0;
+    }
+    index = drvEtherIP_add_tag(plc, period, index_tag, 1);
+    if (! index)
+        return 0;
+    EIP_lock_PLC(plc);
+    for (fifo = DLL_first(EIPFifo, &plc->fifos);  fifo;
+         fifo = DLL_next(EIPFifo, fifo))
+    {
+        if (strcmp(fifo->string_tag, string_tag) != 0)
+            continue;
+        EIP_unlock_PLC(plc);
+        /* Consuming elements removes them, so a FIFO can't be shared */
+        if (fifo->owner != owner  ||  fifo->index != index  ||
+            fifo->size != size)
+        {
+            EIP_printf(1, "drvEtherIP: FIFO '%s' is already used "
+                       "with index '%s', size %lu\n", string_tag,
+                       fifo->index->string_tag, (unsigned long)fifo->size);
+            return 0;
+        }
+        return fifo;
+    }
+    fifo = (EIPFifo *) calloc(1, sizeof(EIPFifo));
+    if (! fifo)
+    {
+        EIP_unlock_PLC(plc);
+        return 0;
+    }
+    /* Parse as "tag[0]", then update the element for each read */
+    sprintf(buffer, "%s[0]", string_tag);
+    fifo->string_tag = EIP_strdup(string_tag);
+    fifo->tag = EIP_parse_tag(buffer);
+    for (node = fifo->tag;  node && node->next;  node = node->next)
+        /* find last */;
+    if (!(fifo->string_tag  &&  node  &&  node->type == te_element))
+    {
+        EIP_printf(2, "drvEtherIP: cannot parse FIFO tag '%s'\n", string_tag);
+        EIP_unlock_PLC(plc);
+        if (fifo->tag)
+            EIP_free_ParsedTag(fifo->tag);
+        if (fifo->string_tag)
+            free(fifo->string_tag);
+        free(fifo);
+        return 0;
+    }
+    fifo->owner = owner;
+    fifo->element = node;
+    fifo->size = size;
+    fifo->index = index;
+    DLL_init(&fifo->callbacks);
+    DLL_append(&plc->fifos, fifo);
+    EIP_unlock_PLC(plc);
+    return fifo;
+}
+
+void drvEtherIP_add_fifo_callback(PLC *plc, EIPFifo *fifo,
+                                  EIPCallback callback, void *arg)
+{
+    EIP_lock_PLC(plc);
+    add_TagCallback(plc, &fifo->callbacks, callback, arg);
+    EIP_unlock_PLC(plc);
+}
+
+void drvEtherIP_remove_fifo_callback(PLC *plc, EIPFifo *fifo,
+                                     EIPCallback callback, void *arg)
+{
+    EIP_lock_PLC(plc);
+    remove_TagCallback(plc, &fifo->callbacks, callback, arg);
+    EIP_unlock_PLC(plc);
+}
+
+EIPAggregate *drvEtherIP_add_aggregate(PLC *plc, TagInfo *tag,
+                                       size_t element, double interval)
+{
+    EIPAggregate *agg;
+
+    if (interval <= 0.0)
+    {
+        EIP_printf(2, "drvEtherIP: invalid aggregate interval %g for '%s'\n",
+                   interval, tag->string_tag);
+        return 0;
+    }
+    EIP_lock_PLC(plc);
+    for (agg = DLL_first(EIPAggregate, &plc->aggregates);  agg;
+         agg = DLL_next(EIPAggregate, agg))
+    {
+        if (agg->tag == tag  &&  agg->element == element  &&
+            agg->interval == interval)
+        {
+            EIP_unlock_PLC(plc);
+            return agg;
+        }
+    }
+    agg = (EIPAggregate *) calloc(1, sizeof(EIPAggregate));
+    if (! agg)
+    {
+        EIP_unlock_PLC(plc);
+        return 0;
+    }
+    agg->tag = tag;
+    agg->element = element;
+    agg->interval = interval;
+    DLL_init(&agg->callbacks);
+    DLL_append(&plc->aggregates, agg);
+    EIP_unlock_PLC(plc);
+    return agg;
+}
+
+void drvEtherIP_add_aggregate_callback(PLC *plc, EIPAggregate *agg,
+                                       EIPCallback callback, void *arg)
+{
+    EIP_lock_PLC(plc);
+    add_TagCallback(plc, &agg->callbacks, callback, arg);
+    EIP_unlock_PLC(plc);
+}
+
+void drvEtherIP_remove_aggregate_callback(PLC *plc, EIPAggregate *agg,
+                                          EIPCallback callback, void *arg)
+{
+    EIP_lock_PLC(plc);
+    remove_TagCallback(plc, &agg->callbacks, callback, arg);
+    EIP_unlock_PLC(plc);
+}
+
+/* The PLC's index either wraps within the ring, staying below 'size',
+ * or is a free-running counter. For a ring, 'next' stays in [0, size),
+ * for a counter it follows the counter.
+ * A counter that is still below 'size' is handled like a ring,
+ * which gives the same 'next' until the counter passes 'size'.
+ */
+eip_bool drvEtherIP_fifo_pending(EIPFifo *fifo, CN_UDINT index,
+                                 CN_UDINT *count)
+{
+    if (index < fifo->size)
+    {   /* Ring: Can't tell whether the PLC overwrote unread elements */
+        *count = (index + fifo->size - fifo->next % fifo->size) % fifo->size;
+        return true;
+    }
+    if (index < fifo->next)
+        return false;
+    *count = index - fifo->next;
+    if (*count > fifo->size)
+    {   /* PLC overwrote elements that we didn't read */
+        fifo->overruns += *count - fifo->size;
+        fifo->next = index - fifo->size;
+        *count = fifo->size;
+    }
+    return true;
+}
+
+void drvEtherIP_fifo_advance(EIPFifo *fifo, CN_UDINT index, CN_UDINT count)
+{
+    if (index < fifo->size)
+        fifo->next = (fifo->next % fifo->size + count) % fifo->size;
+    else
+        fifo->next += count;
+}
+
+void drvEtherIP_fifo_consume(EIPFifo *fifo, size_t elements)
+{
+    if (elements >= fifo->elements)
+    {
+        fifo->elements = 0;
+        return;
+    }
+    fifo->elements -= elements;
+    memmove(fifo->data + CIP_Typecode_size,
+            fifo->data + CIP_Typecode_size + elements*fifo->element_size,
+            fifo->elements*fifo->element_size);
 }
 
 
@@ -1309,13 +3561,16 @@ int drvEtherIP_restart()
     char   taskname[20];
     int    tasks = 0;
     size_t len;
+#ifdef HAVE_314_API
+    unsigned int priority;
+#endif
 
     if (drvEtherIP_private.lock == 0) return 0;
-    epicsMutexLock(drvEtherIP_private.lock);
+    EIP_lock_driver();
 
 #ifdef HAVE_314_API
     if (!databaseIsReady) {
-        epicsMutexUnlock(drvEtherIP_private.lock);
+        EIP_unlock_driver();
         for (plc = DLL_first(PLC,&drvEtherIP_private.PLCs);
              plc;  plc = DLL_next(PLC,plc))
         {
@@ -1333,7 +3588,7 @@ int drvEtherIP_restart()
          plc;  plc = DLL_next(PLC,plc))
     {
         /* block scan task (if running): */
-        epicsMutexLock(plc->lock);
+        EIP_lock_PLC(plc);
         /* restart the connection:
          * disconnect, PLC_scan_task will reconnect */
         disconnect_PLC(plc);
@@ -1352,10 +3607,17 @@ int drvEtherIP_restart()
             taskname[2] = 'P';
             memcpy(&taskname[3], plc->name, len);
             taskname[len+3] = '\0';
+            plc->thread_update = true;
 #ifdef HAVE_314_API
+            priority = epicsThreadPriorityHigh;
+            if (plc->thread_priority > 0)
+                priority = plc->thread_priority > epicsThreadPriorityMax ?
+                           epicsThreadPriorityMax : plc->thread_priority;
+            else if (plc->thread_priority < 0)
+                priority = epicsThreadPriorityLow;
             plc->scan_task_id = epicsThreadCreate(
               taskname,
-              epicsThreadPriorityHigh,
+              priority,
               epicsThreadGetStackSize(epicsThreadStackMedium),
               (EPICSTHREADFUNC)PLC_scan_task,
               (void *)plc);
@@ -1372,12 +3634,318 @@ int drvEtherIP_restart()
                        plc->name);
             ++tasks;
         }
-        epicsMutexUnlock(plc->lock);
+        EIP_unlock_PLC(plc);
     }
-    epicsMutexUnlock(drvEtherIP_private.lock);
+    EIP_unlock_driver();
     return tasks;
 }
 
+/* ------------------------------------------------------------
+ * Live reconfiguration.
+ * The scan task holds the PLC lock for a complete turn
+ * over all scan lists, so changes made under the PLC lock
+ * take effect together at the start of the next turn.
+ * ------------------------------------------------------------ */
+
+/* Change period of scan list. If there is already a list
+ * with the new period, the tags are moved into that list.
+ */
+eip_bool drvEtherIP_scanlist_period(const char *PLC_name, double period,
+                                    double new_period)
+{
+    PLC      *plc;
+    ScanList *list, *other;
+    TagInfo  *info;
+    epicsTimeStamp next;
+
+    if (new_period <= 0.0)
+    {
+        EIP_printf(1, "drvEtherIP_scanlist_period: Invalid period %g\n",
+                   new_period);
+        return false;
+    }
+    plc = drvEtherIP_find_PLC(PLC_name);
+    if (! plc)
+    {
+        EIP_printf(1, "drvEtherIP_scanlist_period: Unknown PLC '%s'\n",
+                   PLC_name);
+        return false;
+    }
+    EIP_lock_PLC(plc);
+    list = get_PLC_ScanList(plc, period, false);
+    if (! list)
+    {
+        EIP_unlock_PLC(plc);
+        EIP_printf(1, "drvEtherIP_scanlist_period: PLC '%s' has no "
+                   "%g sec scan list\n", PLC_name, period);
+        return false;
+    }
+    if (list->sync)
+    {
+        EIP_unlock_PLC(plc);
+        EIP_printf(1, "drvEtherIP_scanlist_period: PLC '%s' %g sec scan list "
+                   "is in sync group '%s'\n", PLC_name, period,
+                   list->sync->name);
+        return false;
+    }
+    other = get_PLC_ScanList(plc, new_period, false);
+    if (other  &&  other != list)
+    {   /* Merge, leaving an empty list */
+        while ((info = DLL_decap(&list->taginfos)) != 0)
+            add_ScanList_TagInfo(other, info);
+    }
+    else
+    {   /* Next scan is about one new period after the last one */
+        list->period = new_period;
+        next = list->scan_time;
+        epicsTimeAddSeconds(&next, new_period);
+        schedule_ScanList(list, &next);
+    }
+    EIP_unlock_PLC(plc);
+    return true;
+}
+
+/* Enable or disable a scan list.
+ * Tags of a disabled list are invalidated.
+ */
+eip_bool drvEtherIP_scanlist_enable(const char *PLC_name, double period,
+                                    int enable)
+{
+    PLC      *plc;
+    ScanList *list;
+
+    plc = drvEtherIP_find_PLC(PLC_name);
+    if (! plc)
+    {
+        EIP_printf(1, "drvEtherIP_scanlist_enable: Unknown PLC '%s'\n",
+                   PLC_name);
+        return false;
+    }
+    EIP_lock_PLC(plc);
+    list = get_PLC_ScanList(plc, period, false);
+    if (! list)
+    {
+        EIP_unlock_PLC(plc);
+        EIP_printf(1, "drvEtherIP_scanlist_enable: PLC '%s' has no "
+                   "%g sec scan list\n", PLC_name, period);
+        return false;
+    }
+    if (enable  &&  !list->enabled)
+    {   /* Scan right away */
+        memset(&list->scheduled_time, 0, sizeof(epicsTimeStamp));
+        list->enabled = true;
+    }
+    else if (!enable  &&  list->enabled)
+    {
+        list->enabled = false;
+        invalidate_ScanList_tags(list);
+    }
+    EIP_unlock_PLC(plc);
+    return true;
+}
+
+/* Set phase of scan list, the start of its scans within the period.
+ * Negative phase selects the automatic one.
+ */
+eip_bool drvEtherIP_scanlist_phase(const char *PLC_name, double period,
+                                   double phase)
+{
+    PLC      *plc;
+    ScanList *list;
+
+    plc = drvEtherIP_find_PLC(PLC_name);
+    if (! plc)
+    {
+        EIP_printf(1, "drvEtherIP_scanlist_phase: Unknown PLC '%s'\n",
+                   PLC_name);
+        return false;
+    }
+    EIP_lock_PLC(plc);
+    list = get_PLC_ScanList(plc, period, false);
+    if (! list)
+    {
+        EIP_unlock_PLC(plc);
+        EIP_printf(1, "drvEtherIP_scanlist_phase: PLC '%s' has no "
+                   "%g sec scan list\n", PLC_name, period);
+        return false;
+    }
+    if (list->sync)
+    {
+        EIP_unlock_PLC(plc);
+        EIP_printf(1, "drvEtherIP_scanlist_phase: PLC '%s' %g sec scan list "
+                   "is in sync group '%s'\n", PLC_name, period,
+                   list->sync->name);
+        return false;
+    }
+    if (list->phase >= 0.0  &&  phase >= 0.0  &&  list->phase != phase)
+        EIP_printf(2, "drvEtherIP: Changing phase of PLC '%s' "
+                   "%g sec scan list from %g to %g secs\n",
+                   PLC_name, period, list->phase, phase);
+    list->phase = phase < 0.0 ? -1.0 : phase;
+    /* Re-schedule from the last scan */
+    if (! is_time_set(&list->scan_time))
+        memset(&list->scheduled_time, 0, sizeof(epicsTimeStamp));
+    else
+        schedule_ScanList(list, &list->scan_time);
+    EIP_unlock_PLC(plc);
+    return true;
+}
+
+/* Add the PLC's scan list for period to a sync group.
+ * All lists of the group are scheduled at the group's phase,
+ * handled first by their scan task, which wakes
+ * drvEtherIP_sync_lead early, prepares the requests
+ * and then waits for the exact time to send them.
+ */
+eip_bool drvEtherIP_sync_group(const char *group_name, const char *PLC_name,
+                               double period, double phase)
+{
+    PLC          *plc;
+    ScanList     *list;
+    EIPSyncGroup *group;
+
+    if (period <= 0.0)
+    {
+        EIP_printf(1, "drvEtherIP_sync_group: Invalid period %g\n", period);
+        return false;
+    }
+    plc = drvEtherIP_find_PLC(PLC_name);
+    if (! plc)
+    {
+        EIP_printf(1, "drvEtherIP_sync_group: Unknown PLC '%s'\n", PLC_name);
+        return false;
+    }
+    EIP_lock_driver();
+    for (group = DLL_first(EIPSyncGroup, &drvEtherIP_private.sync_groups);
+         group;  group = DLL_next(EIPSyncGroup, group))
+        if (strcmp(group->name, group_name) == 0)
+            break;
+    if (! group)
+    {
+        group = (EIPSyncGroup *) calloc(1, sizeof(EIPSyncGroup));
+        if (group)
+        {
+            group->name = EIP_strdup(group_name);
+            group->lock = epicsMutexCreate();
+        }
+        if (!(group  &&  group->name  &&  group->lock))
+        {
+            EIP_unlock_driver();
+            EIP_printf(0, "drvEtherIP_sync_group: Cannot create group\n");
+            return false;
+        }
+        group->period = period;
+        group->phase = phase < 0.0 ? 0.0 : phase;
+        DLL_append(&drvEtherIP_private.sync_groups, group);
+    }
+    EIP_unlock_driver();
+    if (group->period != period)
+    {
+        EIP_printf(1, "drvEtherIP_sync_group: Group '%s' uses %g secs, "
+                   "not %g\n", group_name, group->period, period);
+        return false;
+    }
+    EIP_lock_PLC(plc);
+    list = get_PLC_ScanList(plc, period, true);
+    if (! list)
+    {
+        EIP_unlock_PLC(plc);
+        EIP_printf(2, "drvEtherIP: cannot create list at %g secs\n", period);
+        return false;
+    }
+    if (list->sync  &&  list->sync != group)
+    {
+        EIP_unlock_PLC(plc);
+        EIP_printf(1, "drvEtherIP_sync_group: PLC '%s' %g sec scan list "
+                   "is already in group '%s'\n",
+                   PLC_name, period, list->sync->name);
+        return false;
+    }
+    if (! list->sync)
+    {
+        epicsMutexLock(group->lock);
+        ++group->members;
+        epicsMutexUnlock(group->lock);
+        list->sync = group;
+        list->phase = group->phase;
+        memset(&list->scheduled_time, 0, sizeof(epicsTimeStamp));
+        /* Move list to the front of the PLC's lists */
+        while (DLL_first(ScanList, &plc->scanlists) != list)
+        {
+            ScanList *other = DLL_decap(&plc->scanlists);
+            DLL_append(&plc->scanlists, other);
+        }
+    }
+    EIP_unlock_PLC(plc);
+    return true;
+}
+
+/* Move tag to the scan list for period, creating it if necessary.
+ * Unlike drvEtherIP_add_tag, this can also move to a slower list.
+ */
+eip_bool drvEtherIP_move_tag(const char *PLC_name, const char *string_tag,
+                             double period)
+{
+    PLC      *plc;
+    ScanList *list, *new_list;
+    TagInfo  *info;
+
+    if (period <= 0.0)
+    {
+        EIP_printf(1, "drvEtherIP_move_tag: Invalid period %g\n", period);
+        return false;
+    }
+    plc = drvEtherIP_find_PLC(PLC_name);
+    if (! plc)
+    {
+        EIP_printf(1, "drvEtherIP_move_tag: Unknown PLC '%s'\n", PLC_name);
+        return false;
+    }
+    EIP_lock_PLC(plc);
+    if (! find_PLC_tag(plc, string_tag, &list, &info))
+    {
+        EIP_unlock_PLC(plc);
+        EIP_printf(1, "drvEtherIP_move_tag: PLC '%s' has no tag '%s'\n",
+                   PLC_name, string_tag);
+        return false;
+    }
+    if (list->period != period)
+    {
+        new_list = get_PLC_ScanList(plc, period, true);
+        if (! new_list)
+        {
+            EIP_unlock_PLC(plc);
+            EIP_printf(2, "drvEtherIP: cannot create list at %g secs"
+                       "for tag '%s'\n", period, string_tag);
+            return false;
+        }
+        remove_ScanList_TagInfo(list, info);
+        add_ScanList_TagInfo(new_list, info);
+    }
+    EIP_unlock_PLC(plc);
+    return true;
+}
+
+/* Restart the connection to one PLC.
+ * Its scan task reconnects on the next turn.
+ */
+eip_bool drvEtherIP_restart_PLC(const char *PLC_name)
+{
+    PLC *plc;
+
+    plc = drvEtherIP_find_PLC(PLC_name);
+    if (! plc)
+    {
+        EIP_printf(1, "drvEtherIP_restart_PLC: Unknown PLC '%s'\n",
+                   PLC_name);
+        return false;
+    }
+    EIP_lock_PLC(plc);
+    disconnect_PLC(plc);
+    EIP_unlock_PLC(plc);
+    return true;
+}
+
 /* Command-line communication test,
  * not used by the driver */
 int drvEtherIP_read_tag(const char *ip_addr,
@@ -1410,21 +3978,1895 @@ int drvEtherIP_read_tag(const char *ip_addr,
 }
 
 
-/* Jeff Hill noticed that driver could invoke for example ao record callbacks,
- * i.e. call scanOnce() on a record, while the IOC is still starting up
- * and the "onceQ" ring buffer is not initalized.
+/* ------------------------------------------------------------
+ * Snapshot save/restore
+ * ------------------------------------------------------------
  *
- * drvEtherIP_restart will therefore not perform anything until the database
- * is available as indicated by the init hook setting databaseIsReady
+ * A snapshot file lists tags of one PLC with their raw CIP data,
+ * one tag per line:
+ *
+ *    <tag> <elements> <hex dump of CIP type and data>
+ *
+ * Lines starting with '#' are comments.
+ * Only atomic types (BOOL, SINT, INT, DINT, LINT, REAL, BOOL arrays)
+ * are handled, structures are skipped.
  */
-#ifdef HAVE_314_API
-void drvEtherIP_initHook ( initHookState state )
+
+#define SNAPSHOT_LINE_LENGTH (EIP_MAX_TAG_LENGTH + 20 + 2*EIP_BUFFER_SIZE)
+
+typedef struct
 {
-    if (drvEtherIP_private.lock == 0) return;
-    if ( state == initHookAfterScanInit ) {
-        epicsMutexLock(drvEtherIP_private.lock);
-        databaseIsReady = true;
-        epicsMutexUnlock(drvEtherIP_private.lock);
+    char      *string_tag;
+    ParsedTag *tag;
+    size_t    elements;
+    CN_USINT  *data;          /* raw CIP type and data */
+    size_t    data_size;      /* bytes in data, including type */
+    size_t    request_size;   /* of the current write resp. read */
+    size_t    response_size;
+    eip_bool  written;
+    eip_bool  verified;
+} SnapshotTag;
+
+/* Save what the driver last read for all tags of a PLC.
+ * The data is copied under the locks and written without them.
+ * Tags are counted first, tags added in between are skipped.
+ * Returns number of saved tags or -1 on error.
+ */
+int drvEtherIP_snapshot_save(const char *PLC_name, const char *filename)
+{
+    PLC            *plc;
+    ScanList       *list;
+    TagInfo        *info;
+    SnapshotTag    *tags, *s;
+    FILE           *f;
+    epicsTimeStamp now;
+    char           tsString[50];
+    size_t         i, t, num = 0, saved = 0, skipped = 0;
+    eip_bool       ok = true;
+
+    plc = drvEtherIP_find_PLC(PLC_name);
+    if (! plc)
+    {
+        printf("drvEtherIP_snapshot_save: Unknown PLC '%s'\n", PLC_name);
+        return -1;
+    }
+    EIP_lock_PLC(plc);
+    for (list=DLL_first(ScanList, &plc->scanlists); list;
+         list=DLL_next(ScanList, list))
+        for (info=DLL_first(TagInfo, &list->taginfos); info;
+             info=DLL_next(TagInfo, info))
+            ++num;
+    EIP_unlock_PLC(plc);
+    tags = (SnapshotTag *) calloc(num+1, sizeof(SnapshotTag));
+    if (! tags)
+    {
+        printf("drvEtherIP_snapshot_save: No memory\n");
+        return -1;
+    }
+    EIP_lock_PLC(plc);
+    for (list=DLL_first(ScanList, &plc->scanlists); list  &&  ok;
+         list=DLL_next(ScanList, list))
+    {
+        for (info=DLL_first(TagInfo, &list->taginfos);
+             info  &&  saved < num;
+             info=DLL_next(TagInfo, info))
+        {
+            if (EIP_lock_data(info) != epicsMutexLockOK)
+            {
+                ++skipped;
+                continue;
+            }
+            if (info->valid_data_size > CIP_Typecode_size  &&
+                CIP_Type_size(get_CIP_typecode(info->data)) > 0)
+            {
+                s = &tags[saved];
+                s->data = (CN_USINT *) malloc(info->valid_data_size);
+                if (s->data)
+                {   /* TagInfos are never freed, keep the tag name */
+                    s->string_tag = info->string_tag;
+                    s->elements = info->elements;
+                    s->data_size = info->valid_data_size;
+                    memcpy(s->data, info->data, s->data_size);
+                    ++saved;
+                }
+                else
+                    ok = false;
+            }
+            else
+                ++skipped;
+            EIP_unlock_data(info);
+            if (! ok)
+                break;
+        }
+    }
+    EIP_unlock_PLC(plc);
+
+    f = 0;
+    if (! ok)
+        printf("drvEtherIP_snapshot_save: No memory\n");
+    else if (! (f = fopen(filename, "w")))
+    {
+        printf("drvEtherIP_snapshot_save: Cannot create '%s'\n", filename);
+        ok = false;
+    }
+    else
+    {
+        epicsTimeGetCurrent(&now);
+        epicsTimeToStrftime(tsString, sizeof(tsString),
+                            "%Y/%m/%d %H:%M:%S.%04f", &now);
+        fprintf(f, "# drvEtherIP snapshot of PLC '%s', %s\n",
+                plc->name, tsString);
+        fprintf(f, "# <tag> <elements> <CIP type and data>\n");
+        for (t=0; t<saved; ++t)
+        {
+            s = &tags[t];
+            fprintf(f, "%s %u ", s->string_tag, (unsigned)s->elements);
+            for (i=0; i<s->data_size; ++i)
+                fprintf(f, "%02X", s->data[i]);
+            fprintf(f, "\n");
+        }
+        if (ferror(f))
+            ok = false;
+        if (fclose(f) != 0)
+            ok = false;
+        if (! ok)
+            printf("drvEtherIP_snapshot_save: Error writing '%s'\n",
+                   filename);
+    }
+    for (t=0; t<saved; ++t)
+        free(tags[t].data);
+    free(tags);
+    if (! ok)
+        return -1;
+    printf("Saved %u tags of PLC '%s' to '%s'",
+           (unsigned)saved, plc->name, filename);
+    if (skipped)
+        printf(", skipped %u tags without data or of structure type",
+               (unsigned)skipped);
+    printf("\n");
+    return saved;
+}
+
+static void free_snapshot(SnapshotTag *tags, size_t num)
+{
+    size_t i;
+    for (i=0; i<num; ++i)
+    {
+        free(tags[i].string_tag);
+        if (tags[i].tag)
+            EIP_free_ParsedTag(tags[i].tag);
+        free(tags[i].data);
+    }
+    free(tags);
+}
+
+static int hex_digit(char c)
+{
+    if (c >= '0'  &&  c <= '9')
+        return c - '0';
+    if (c >= 'A'  &&  c <= 'F')
+        return c - 'A' + 10;
+    if (c >= 'a'  &&  c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+/* Parse snapshot file.
+ * Returns array of tags (to be free'ed via free_snapshot) or 0.
+ */
+static SnapshotTag *read_snapshot(const char *filename, size_t *num)
+{
+    FILE        *f;
+    char        *line, *hex, name[EIP_MAX_TAG_LENGTH], format[20];
+    unsigned    elements;
+    int         pos, line_no = 0, complete;
+    size_t      i, len, type_size, max = 0;
+    SnapshotTag *tags = 0, *t;
+
+    *num = 0;
+    f = fopen(filename, "r");
+    if (! f)
+    {
+        printf("drvEtherIP snapshot: Cannot open '%s'\n", filename);
+        return 0;
+    }
+    line = (char *) malloc(SNAPSHOT_LINE_LENGTH);
+    if (! line)
+    {
+        fclose(f);
+        return 0;
+    }
+    /* "%99s %u %n", width limited to the name buffer */
+    sprintf(format, "%%%ds %%u %%n", EIP_MAX_TAG_LENGTH-1);
+    while (fgets(line, SNAPSHOT_LINE_LENGTH, f))
+    {
+        ++line_no;
+        if (line[0] == '#'  ||  line[0] == '\n')
+            continue;
+        if (sscanf(line, format, name, &elements, &pos) < 2)
+        {
+            printf("drvEtherIP snapshot: '%s' line %d: Cannot parse\n",
+                   filename, line_no);
+            continue;
+        }
+        hex = line + pos;
+        for (len=0; hex_digit(hex[len]) >= 0; ++len)
+            /**/;
+        if (len < 2*(CIP_Typecode_size+1)  ||  (len % 2) != 0)
+        {
+            printf("drvEtherIP snapshot: '%s' line %d: Invalid data\n",
+                   filename, line_no);
+            continue;
+        }
+        if (*num >= max)
+        {
+            max += 50;
+            t = (SnapshotTag *) realloc(tags, max * sizeof(SnapshotTag));
+            if (! t)
+                break;
+            tags = t;
+        }
+        t = &tags[*num];
+        memset(t, 0, sizeof(SnapshotTag));
+        t->data_size = len/2;
+        t->data = (CN_USINT *) malloc(t->data_size);
+        if (! t->data)
+            break;
+        for (i=0; i<t->data_size; ++i)
+            t->data[i] = (CN_USINT)
+                ((hex_digit(hex[2*i]) << 4) | hex_digit(hex[2*i+1]));
+        /* Element count is determined by the data, not the comment field */
+        type_size = CIP_Type_size(get_CIP_typecode(t->data));
+        if (type_size <= 0  ||
+            ((t->data_size - CIP_Typecode_size) % type_size) != 0)
+        {
+            printf("drvEtherIP snapshot: '%s' line %d: Unsupported type\n",
+                   filename, line_no);
+            free(t->data);
+            continue;
+        }
+        t->elements = (t->data_size - CIP_Typecode_size) / type_size;
+        t->string_tag = EIP_strdup(name);
+        t->tag = EIP_parse_tag(name);
+        ++*num;
+        if (! (t->string_tag && t->tag))
+        {
+            printf("drvEtherIP snapshot: '%s' line %d: Invalid tag '%s'\n",
+                   filename, line_no, name);
+            break;
+        }
+    }
+    complete = feof(f);
+    free(line);
+    fclose(f);
+    if (*num <= 0  ||  ! complete)
+    {
+        free_snapshot(tags, *num);
+        return 0;
+    }
+    return tags;
+}
+
+/* Write snapshot tags resp. read them back for comparison,
+ * packing as many requests as possible into each MultiRequest.
+ * Called with PLC locked and connected.
+ *
+ * Returns number of network transfers or -1 on error.
+ */
+static int transfer_snapshot(EIPConnection *c, SnapshotTag *tags, size_t num,
+                             eip_bool write)
+{
+    SnapshotTag         *t;
+    size_t              first, i, count, requests_size, responses_size;
+    size_t              multi_request_size, single_response_size, data_size;
+    CN_USINT            *send_request, *multi_request, *request;
+    const CN_USINT      *response, *single_response, *data;
+    EncapsulationRRData rr_data;
+    int                 transfers = 0;
+
+    for (i=0; i<num; ++i)
+    {
+        t = &tags[i];
+        if (write)
+        {
+            t->written = false;
+            t->request_size = CIP_WriteData_size(t->tag,
+                                        t->data_size - CIP_Typecode_size);
+            t->response_size = 4;
+        }
+        else
+        {
+            t->verified = false;
+            t->request_size = CIP_ReadData_size(t->tag);
+            t->response_size = 4 + t->data_size;
+        }
+    }
+    first = 0;
+    while (first < num)
+    {
+        count = requests_size = responses_size = 0;
+        while (first+count < num  &&
+               CIP_MultiRequest_size(count+1,
+                   requests_size + tags[first+count].request_size)
+                   <= c->transfer_buffer_limit  &&
+               CIP_MultiResponse_size(count+1,
+                   responses_size + tags[first+count].response_size)
+                   <= c->transfer_buffer_limit)
+        {
+            requests_size  += tags[first+count].request_size;
+            responses_size += tags[first+count].response_size;
+            ++count;
+        }
+        if (count == 0)
+        {
+            EIP_printf(1, "drvEtherIP snapshot: Tag '%s' exceeds buffer limit\n",
+                       tags[first].string_tag);
+            ++first;
+            continue;
+        }
+        multi_request_size = CIP_MultiRequest_size(count, requests_size);
+        send_request = EIP_make_SendRRData(c,
+                            CM_Unconnected_Send_size(multi_request_size));
+        if (! send_request)
+            return -1;
+        multi_request = make_CM_Unconnected_Send(send_request,
+                                                 multi_request_size, c->slot);
+        if (!(multi_request && prepare_CIP_MultiRequest(multi_request, count)))
+            return -1;
+        for (i=0; i<count; ++i)
+        {
+            t = &tags[first+i];
+            request = CIP_MultiRequest_item(multi_request, i, t->request_size);
+            if (! request)
+                return -1;
+            if (write)
+                request = make_CIP_WriteData(request, t->tag,
+                                   (CIP_Type)get_CIP_typecode(t->data),
+                                   t->elements, t->data + CIP_Typecode_size);
+            else
+                request = make_CIP_ReadData(request, t->tag, t->elements);
+            if (! request)
+                return -1;
+        }
+        if (!EIP_send_connection_buffer(c)  ||  !EIP_read_connection_buffer(c))
+        {
+            EIP_printf_time(2, "drvEtherIP snapshot: Transfer failed\n");
+            return -1;
+        }
+        ++transfers;
+        response = EIP_unpack_RRData(c->buffer, &rr_data);
+        if (! check_CIP_MultiRequest_Response_partial(response,
+                                                      rr_data.data_length))
+        {
+            EIP_printf_time(2, "drvEtherIP snapshot: Error in response\n");
+            if (EIP_verbose(2))
+                dump_CIP_MultiRequest_Response_Error(response,
+                                                     rr_data.data_length);
+            return -1;
+        }
+        for (i=0; i<count; ++i)
+        {
+            t = &tags[first+i];
+            single_response = get_CIP_MultiRequest_Response(
+                response, rr_data.data_length, i, &single_response_size);
+            if (! single_response)
+                return -1;
+            if (write)
+                t->written = check_CIP_WriteData_Response(single_response,
+                                                     single_response_size);
+            else
+            {
+                data = check_CIP_ReadData_Response(single_response,
+                                                   single_response_size,
+                                                   &data_size);
+                t->verified = data  &&  data_size == t->data_size  &&
+                              memcmp(data, t->data, data_size) == 0;
+            }
+        }
+        first += count;
+    }
+    return transfers;
+}
+
+/* Write tags from snapshot file to PLC, then read them back to verify.
+ * The scan task of the PLC is blocked while this runs.
+ * Returns number of verified tags or -1 on error.
+ */
+int drvEtherIP_snapshot_restore(const char *PLC_name, const char *filename)
+{
+    PLC            *plc;
+    SnapshotTag    *tags;
+    size_t         i, num, written = 0, verified = 0;
+    int            writes, reads = -1;
+    epicsTimeStamp start_time, write_time, end_time;
+
+    plc = drvEtherIP_find_PLC(PLC_name);
+    if (! plc)
+    {
+        printf("drvEtherIP_snapshot_restore: Unknown PLC '%s'\n", PLC_name);
+        return -1;
+    }
+    tags = read_snapshot(filename, &num);
+    if (! tags)
+    {
+        printf("drvEtherIP_snapshot_restore: No tags in '%s'\n", filename);
+        return -1;
+    }
+    EIP_lock_PLC(plc);
+    if (! assert_PLC_connect(plc))
+    {
+        EIP_unlock_PLC(plc);
+        printf("drvEtherIP_snapshot_restore: PLC '%s' is disconnected\n",
+               plc->name);
+        free_snapshot(tags, num);
+        return -1;
+    }
+    epicsTimeGetCurrent(&start_time);
+    writes = transfer_snapshot(plc->connection, tags, num, true);
+    epicsTimeGetCurrent(&write_time);
+    if (writes >= 0)
+        reads = transfer_snapshot(plc->connection, tags, num, false);
+    epicsTimeGetCurrent(&end_time);
+    if (writes < 0  ||  reads < 0)
+        disconnect_PLC(plc); /* scan task will reconnect */
+    EIP_unlock_PLC(plc);
+
+    for (i=0; i<num; ++i)
+    {
+        if (tags[i].written)
+            ++written;
+        if (tags[i].verified)
+            ++verified;
+        else if (writes >= 0  &&  reads >= 0)
+            printf("  %-30s: %s\n", tags[i].string_tag,
+                   tags[i].written ? "read-back differs" : "write failed");
+    }
+    printf("PLC '%s', snapshot '%s':\n", plc->name, filename);
+    if (writes < 0)
+        printf("  Write failed after %.3f secs\n",
+               epicsTimeDiffInSeconds(&write_time, &start_time));
+    else
+        printf("  Wrote    %u of %u tags in %d requests, %.3f secs\n",
+               (unsigned)written, (unsigned)num, writes,
+               epicsTimeDiffInSeconds(&write_time, &start_time));
+    if (reads < 0)
+    {
+        if (writes >= 0)
+            printf("  Read-back failed after %.3f secs\n",
+                   epicsTimeDiffInSeconds(&end_time, &write_time));
+    }
+    else
+        printf("  Verified %u of %u tags in %d requests, %.3f secs\n",
+               (unsigned)verified, (unsigned)num, reads,
+               epicsTimeDiffInSeconds(&end_time, &write_time));
+    free_snapshot(tags, num);
+    return (writes < 0  ||  reads < 0) ? -1 : (int)verified;
+}
+
+/* ------------------------------------------------------------
+ * Statistics export
+ * ------------------------------------------------------------
+ *
+ * drvEtherIP_report prints while walking the PLCs,
+ * which is fine for a human but not for a monitoring system
+ * that polls many IOCs.
+ * The export first copies the counters of each PLC
+ * under its locks, which are held only for the copy,
+ * then formats the copy as JSON or Prometheus text
+ * without holding any lock.
+ * It never waits for a PLC lock: The scan task holds it for
+ * a whole scan, or while connecting. For a busy PLC, the export
+ * uses the copy of the previous export, marked as stale.
+ * The file is written under a temporary name and then renamed,
+ * so readers never see a partial file.
+ */
+
+typedef struct
+{
+    const char *string_tag;     /* TagInfos are never freed while running */
+    double     period;
+    eip_bool   valid;
+    eip_bool   priority;
+    double     transfer_time;
+    double     wire_time;
+    double     write_transfer_time;
+}   StatsTag;
+
+typedef struct
+{
+    double     period;
+    eip_bool   enabled;
+    size_t     tags;
+    size_t     list_errors;
+    size_t     sched_errors;
+    double     last_scan_time;
+    double     min_scan_time;
+    double     max_scan_time;
+    double     data_age;
+    double     max_data_age;
+}   StatsList;
+
+typedef struct
+{
+    PLC          *plc;          /* for the constant name and IP */
+    eip_bool     stale;         /* PLC was busy, copy of last export */
+    eip_bool     connected;
+    size_t       plc_errors;
+    size_t       slow_scans;
+    size_t       scan_allocs;
+    size_t       congestion_events;
+    size_t       congestion_limit;
+    size_t       program_changes;
+    size_t       changed_tags;
+    size_t       clock_errors;
+    double       clock_offset;
+    EIPHistogram transfer_histo;
+    EIPHistogram wire_histo;
+    EIPHistogram write_transfer_histo;
+    EIPHistogram update_delay_histo; /* all record types */
+    size_t       num_lists, num_tags;
+    StatsList    *lists;
+    StatsTag     *tags;
+}   StatsPLC;
+
+typedef struct
+{
+    EIPSyncGroup *group;        /* for the constant name */
+    double       skew;
+    double       max_skew;
+    size_t       samples;
+    size_t       incomplete;
+}   StatsGroup;
+
+/* Copy of the last export, used for PLCs that are busy.
+ * stats_cache_lock is created under the driver lock
+ * and never held together with another lock.
+ */
+static epicsMutexId stats_cache_lock = 0;
+static StatsPLC     *stats_cache = 0;
+static size_t       stats_cache_num = 0;
+
+static void free_stats(StatsPLC *plcs, size_t num_plcs);
+
+/* PLC lock is busy: Use lists and counters of the last export.
+ * Keeps the update delays, those don't need the PLC lock.
+ */
+static void use_cached_PLC_stats(StatsPLC *stats)
+{
+    EIPHistogram update_delay_histo = stats->update_delay_histo;
+    StatsPLC     *cached = 0;
+    size_t       i;
+
+    if (stats->lists)
+        free(stats->lists);
+    if (stats->tags)
+        free(stats->tags);
+    epicsMutexLock(stats_cache_lock);
+    for (i=0; i<stats_cache_num; ++i)
+        if (stats_cache[i].plc == stats->plc)
+        {
+            cached = &stats_cache[i];
+            break;
+        }
+    if (cached)
+    {
+        *stats = *cached;
+        stats->lists = 0;
+        stats->tags = 0;
+        if (stats->num_lists > 0  &&
+            (stats->lists = (StatsList *)
+             calloc(stats->num_lists, sizeof(StatsList))))
+            memcpy(stats->lists, cached->lists,
+                   stats->num_lists * sizeof(StatsList));
+        else
+            stats->num_lists = 0;
+        if (stats->num_tags > 0  &&
+            (stats->tags = (StatsTag *)
+             calloc(stats->num_tags, sizeof(StatsTag))))
+            memcpy(stats->tags, cached->tags,
+                   stats->num_tags * sizeof(StatsTag));
+        else
+            stats->num_tags = 0;
+    }
+    else
+    {   /* Nothing known, yet */
+        PLC *plc = stats->plc;
+        memset(stats, 0, sizeof(StatsPLC));
+        stats->plc = plc;
+    }
+    epicsMutexUnlock(stats_cache_lock);
+    stats->update_delay_histo = update_delay_histo;
+    stats->stale = true;
+}
+
+/* Keep the copy of this export for the next one */
+static void cache_stats(StatsPLC *plcs, size_t num_plcs)
+{
+    StatsPLC *old;
+    size_t   old_num;
+
+    epicsMutexLock(stats_cache_lock);
+    old = stats_cache;
+    old_num = stats_cache_num;
+    stats_cache = plcs;
+    stats_cache_num = num_plcs;
+    epicsMutexUnlock(stats_cache_lock);
+    if (old)
+        free_stats(old, old_num);
+}
+
+/* Copy what can be read without the PLC lock,
+ * then lists and tags under the PLC lock.
+ * Lists and tags are counted first and copied after allocating
+ * outside of the lock. Tags added in between are skipped.
+ * Only tries to get the PLC lock, see use_cached_PLC_stats.
+ * Returns false when out of memory.
+ */
+static eip_bool collect_PLC_stats(PLC *plc, StatsPLC *stats)
+{
+    ScanList *list;
+    TagInfo  *info;
+    size_t   t, max_lists, max_tags;
+
+    memset(stats, 0, sizeof(StatsPLC));
+    stats->plc = plc;
+    epicsMutexLock(plc->stats_lock);
+    for (t=0; t<EIP_REC_TYPES; ++t)
+        add_histogram(&stats->update_delay_histo, &plc->update_delay_histo[t]);
+    epicsMutexUnlock(plc->stats_lock);
+
+    if (epicsMutexTryLock(plc->lock) != epicsMutexLockOK)
+    {
+        use_cached_PLC_stats(stats);
+        return true;
+    }
+    max_lists = max_tags = 0;
+    for (list=DLL_first(ScanList, &plc->scanlists); list;
+         list=DLL_next(ScanList, list))
+    {
+        ++max_lists;
+        for (info=DLL_first(TagInfo, &list->taginfos); info;
+             info=DLL_next(TagInfo, info))
+            ++max_tags;
+    }
+    epicsMutexUnlock(plc->lock);
+    if (max_lists > 0  &&
+        !(stats->lists = (StatsList *)calloc(max_lists, sizeof(StatsList))))
+        return false;
+    if (max_tags > 0  &&
+        !(stats->tags = (StatsTag *)calloc(max_tags, sizeof(StatsTag))))
+        return false;
+
+    if (epicsMutexTryLock(plc->lock) != epicsMutexLockOK)
+    {
+        use_cached_PLC_stats(stats);
+        return true;
+    }
+    stats->connected = plc->connection->sock != 0;
+    stats->plc_errors = plc->plc_errors;
+    stats->slow_scans = plc->slow_scans;
+    stats->scan_allocs = plc->scan_allocs;
+    stats->congestion_events = plc->congestion_events;
+    stats->congestion_limit = plc->congestion_limit;
+    stats->program_changes = plc->program_changes;
+    stats->changed_tags = plc->changed_tags;
+    stats->clock_errors = plc->clock_errors;
+    stats->clock_offset = plc->clock_offset;
+    stats->transfer_histo = plc->transfer_histo;
+    stats->wire_histo = plc->wire_histo;
+    stats->write_transfer_histo = plc->write_transfer_histo;
+    for (list=DLL_first(ScanList, &plc->scanlists);
+         list  &&  stats->num_lists < max_lists;
+         list=DLL_next(ScanList, list))
+    {
+        StatsList *l = &stats->lists[stats->num_lists++];
+        l->period = list->period;
+        l->enabled = list->enabled;
+        l->list_errors = list->list_errors;
+        l->sched_errors = list->sched_errors;
+        l->last_scan_time = list->last_scan_time;
+        l->min_scan_time = list->min_scan_time;
+        l->max_scan_time = list->max_scan_time;
+        l->data_age = list->data_age;
+        l->max_data_age = list->max_data_age;
+        /* Data lock is not needed for the statistics of the tag,
+         * those are only changed by the scan task under the PLC lock */
+        for (info=DLL_first(TagInfo, &list->taginfos);
+             info  &&  stats->num_tags < max_tags;
+             info=DLL_next(TagInfo, info))
+        {
+            StatsTag *s = &stats->tags[stats->num_tags++];
+            ++l->tags;
+            s->string_tag = info->string_tag;
+            s->period = list->period;
+            s->valid = info->valid_data_size > 0;
+            s->priority = info->priority;
+            s->transfer_time = info->transfer_time;
+            s->wire_time = info->wire_time;
+            s->write_transfer_time = info->write_transfer_time;
+        }
+    }
+    epicsMutexUnlock(plc->lock);
+    return true;
+}
+
+static void free_stats(StatsPLC *plcs, size_t num_plcs)
+{
+    size_t i;
+
+    for (i=0; i<num_plcs; ++i)
+    {
+        if (plcs[i].lists)
+            free(plcs[i].lists);
+        if (plcs[i].tags)
+            free(plcs[i].tags);
+    }
+    free(plcs);
+}
+
+/* Write string with '"', '\' and newlines escaped,
+ * as needed for both JSON strings and Prometheus label values.
+ */
+static void print_escaped(FILE *f, const char *text)
+{
+    for (/**/; *text; ++text)
+    {
+        if (*text == '"'  ||  *text == '\\')
+            fprintf(f, "\\%c", *text);
+        else if (*text == '\n')
+            fprintf(f, "\\n");
+        else
+            fputc(*text, f);
+    }
+}
+
+static void json_histogram(FILE *f, const char *name,
+                           const EIPHistogram *histo, eip_bool more)
+{
+    fprintf(f, "      \"%s\": { \"count\": %lu, \"sum\": %g, \"max\": %g, "
+            "\"p50\": %g, \"p99\": %g }%s\n",
+            name, (unsigned long)histo->count, histo->total, histo->max,
+            drvEtherIP_histogram_percentile(histo, 0.5),
+            drvEtherIP_histogram_percentile(histo, 0.99),
+            (more ? "," : ""));
+}
+
+static void write_stats_json(FILE *f, const char *stamp,
+                             StatsPLC *plcs, size_t num_plcs,
+                             StatsGroup *groups, size_t num_groups)
+{
+    StatsPLC   *p;
+    StatsList  *l;
+    StatsTag   *s;
+    StatsGroup *g;
+    size_t     i, j;
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"driver\": \"drvEtherIP\",\n");
+    fprintf(f, "  \"version\": \"%d.%d\",\n", ETHERIP_MAYOR, ETHERIP_MINOR);
+    fprintf(f, "  \"time\": \"%s\",\n", stamp);
+    fprintf(f, "  \"plcs\": [\n");
+    for (i=0; i<num_plcs; ++i)
+    {
+        p = &plcs[i];
+        fprintf(f, "    {\n");
+        fprintf(f, "      \"name\": \"");
+        print_escaped(f, p->plc->name);
+        fprintf(f, "\",\n      \"ip\": \"");
+        print_escaped(f, p->plc->ip_addr);
+        fprintf(f, "\",\n");
+        fprintf(f, "      \"stale\": %s,\n",
+                (p->stale ? "true" : "false"));
+        fprintf(f, "      \"connected\": %s,\n",
+                (p->connected ? "true" : "false"));
+        fprintf(f, "      \"errors\": %lu,\n", (unsigned long)p->plc_errors);
+        fprintf(f, "      \"slow_scans\": %lu,\n",
+                (unsigned long)p->slow_scans);
+        fprintf(f, "      \"scan_allocations\": %lu,\n",
+                (unsigned long)p->scan_allocs);
+        fprintf(f, "      \"congestion_events\": %lu,\n",
+                (unsigned long)p->congestion_events);
+        fprintf(f, "      \"transfer_limit\": %lu,\n",
+                (unsigned long)p->congestion_limit);
+        fprintf(f, "      \"program_changes\": %lu,\n",
+                (unsigned long)p->program_changes);
+        fprintf(f, "      \"changed_tags\": %lu,\n",
+                (unsigned long)p->changed_tags);
+        fprintf(f, "      \"clock_errors\": %lu,\n",
+                (unsigned long)p->clock_errors);
+        fprintf(f, "      \"clock_offset\": %g,\n", p->clock_offset);
+        json_histogram(f, "transfer_time", &p->transfer_histo, true);
+        json_histogram(f, "wire_time", &p->wire_histo, true);
+        json_histogram(f, "write_transfer_time",
+                       &p->write_transfer_histo, true);
+        json_histogram(f, "update_delay", &p->update_delay_histo, true);
+        fprintf(f, "      \"scanlists\": [\n");
+        for (j=0; j<p->num_lists; ++j)
+        {
+            l = &p->lists[j];
+            fprintf(f, "        { \"period\": %g, \"enabled\": %s, "
+                    "\"tags\": %lu, \"errors\": %lu, "
+                    "\"schedule_errors\": %lu, \"last_scan_time\": %g, "
+                    "\"min_scan_time\": %g, \"max_scan_time\": %g, "
+                    "\"data_age\": %g, \"max_data_age\": %g }%s\n",
+                    l->period, (l->enabled ? "true" : "false"),
+                    (unsigned long)l->tags, (unsigned long)l->list_errors,
+                    (unsigned long)l->sched_errors, l->last_scan_time,
+                    l->min_scan_time, l->max_scan_time,
+                    l->data_age, l->max_data_age,
+                    (j+1 < p->num_lists ? "," : ""));
+        }
+        fprintf(f, "      ],\n");
+        fprintf(f, "      \"tags\": [\n");
+        for (j=0; j<p->num_tags; ++j)
+        {
+            s = &p->tags[j];
+            fprintf(f, "        { \"tag\": \"");
+            print_escaped(f, s->string_tag);
+            fprintf(f, "\", \"period\": %g, \"valid\": %s, "
+                    "\"priority\": %s, \"transfer_time\": %g, "
+                    "\"wire_time\": %g, \"write_transfer_time\": %g }%s\n",
+                    s->period, (s->valid ? "true" : "false"),
+                    (s->priority ? "true" : "false"),
+                    s->transfer_time, s->wire_time, s->write_transfer_time,
+                    (j+1 < p->num_tags ? "," : ""));
+        }
+        fprintf(f, "      ]\n");
+        fprintf(f, "    }%s\n", (i+1 < num_plcs ? "," : ""));
+    }
+    fprintf(f, "  ],\n");
+    fprintf(f, "  \"sync_groups\": [\n");
+    for (i=0; i<num_groups; ++i)
+    {
+        g = &groups[i];
+        fprintf(f, "    { \"name\": \"");
+        print_escaped(f, g->group->name);
+        fprintf(f, "\", \"samples\": %lu, \"incomplete\": %lu, "
+                "\"skew\": %g, \"max_skew\": %g }%s\n",
+                (unsigned long)g->samples, (unsigned long)g->incomplete,
+                g->skew, g->max_skew, (i+1 < num_groups ? "," : ""));
+    }
+    fprintf(f, "  ]\n");
+    fprintf(f, "}\n");
+}
+
+/* Prometheus text format: All samples of a metric
+ * follow its HELP and TYPE lines.
+ */
+static void prom_header(FILE *f, const char *name, const char *type,
+                        const char *help)
+{
+    fprintf(f, "# HELP ether_ip_%s %s\n", name, help);
+    fprintf(f, "# TYPE ether_ip_%s %s\n", name, type);
+}
+
+static void prom_PLC_label(FILE *f, const char *name, const PLC *plc)
+{
+    fprintf(f, "ether_ip_%s{plc=\"", name);
+    print_escaped(f, plc->name);
+    fprintf(f, "\"");
+}
+
+static void prom_PLC_value(FILE *f, const char *name, const PLC *plc,
+                           double value)
+{
+    prom_PLC_label(f, name, plc);
+    fprintf(f, "} %.9g\n", value);
+}
+
+static void prom_histogram(FILE *f, const char *name, const PLC *plc,
+                           const EIPHistogram *histo)
+{
+    size_t i, sum = 0;
+    double limit = EIP_HISTO_BASE;
+
+    for (i=0; i<EIP_HISTO_BINS-1; ++i)
+    {
+        sum += histo->bins[i];
+        fprintf(f, "ether_ip_%s_bucket{plc=\"", name);
+        print_escaped(f, plc->name);
+        fprintf(f, "\",le=\"%g\"} %lu\n", limit, (unsigned long)sum);
+        limit *= 2;
+    }
+    fprintf(f, "ether_ip_%s_bucket{plc=\"", name);
+    print_escaped(f, plc->name);
+    fprintf(f, "\",le=\"+Inf\"} %lu\n", (unsigned long)histo->count);
+    fprintf(f, "ether_ip_%s_sum{plc=\"", name);
+    print_escaped(f, plc->name);
+    fprintf(f, "\"} %.9g\n", histo->total);
+    fprintf(f, "ether_ip_%s_count{plc=\"", name);
+    print_escaped(f, plc->name);
+    fprintf(f, "\"} %lu\n", (unsigned long)histo->count);
+}
+
+static void write_stats_prometheus(FILE *f,
+                                   StatsPLC *plcs, size_t num_plcs,
+                                   StatsGroup *groups, size_t num_groups)
+{
+    size_t i, j;
+
+#define PROM_PLC(NAME, TYPE, HELP, VALUE)                   \
+    prom_header(f, NAME, TYPE, HELP);                       \
+    for (i=0; i<num_plcs; ++i)                              \
+        prom_PLC_value(f, NAME, plcs[i].plc, (double)(VALUE))
+#define PROM_HISTO(NAME, HELP, HISTO)                       \
+    prom_header(f, NAME, "histogram", HELP);                \
+    for (i=0; i<num_plcs; ++i)                              \
+        prom_histogram(f, NAME, plcs[i].plc, &plcs[i].HISTO)
+
+    PROM_PLC("stale", "gauge", "1 if the PLC was busy, "
+             "values of the previous export", plcs[i].stale);
+    PROM_PLC("connected", "gauge", "1 if connected to the PLC",
+             plcs[i].connected);
+    PROM_PLC("errors_total", "counter", "Communication errors",
+             plcs[i].plc_errors);
+    PROM_PLC("slow_scans_total", "counter", "Scan task was late",
+             plcs[i].slow_scans);
+    PROM_PLC("scan_allocations_total", "counter",
+             "Buffers allocated by scan task", plcs[i].scan_allocs);
+    PROM_PLC("congestion_events_total", "counter",
+             "Transfer size was reduced", plcs[i].congestion_events);
+    PROM_PLC("transfer_limit_bytes", "gauge",
+             "Current transfer size limit", plcs[i].congestion_limit);
+    PROM_PLC("program_changes_total", "counter",
+             "Detected PLC program changes", plcs[i].program_changes);
+    PROM_PLC("changed_tags_total", "counter",
+             "Tags found changed after program change", plcs[i].changed_tags);
+    PROM_PLC("clock_errors_total", "counter",
+             "Failed PLC clock readings", plcs[i].clock_errors);
+    PROM_PLC("clock_offset_seconds", "gauge",
+             "PLC clock minus IOC clock", plcs[i].clock_offset);
+    PROM_HISTO("transfer_seconds", "Round trip of transfers",
+               transfer_histo);
+    PROM_HISTO("wire_seconds", "Round trip of transfers on the wire",
+               wire_histo);
+    PROM_HISTO("write_transfer_seconds", "Write request to response",
+               write_transfer_histo);
+    PROM_HISTO("update_delay_seconds",
+               "Received data until I/O Intr record read it",
+               update_delay_histo);
+#undef PROM_PLC
+#undef PROM_HISTO
+
+#define PROM_LIST(NAME, TYPE, HELP, VALUE)                  \
+    prom_header(f, NAME, TYPE, HELP);                       \
+    for (i=0; i<num_plcs; ++i)                              \
+        for (j=0; j<plcs[i].num_lists; ++j)                 \
+        {                                                   \
+            prom_PLC_label(f, NAME, plcs[i].plc);           \
+            fprintf(f, ",period=\"%g\"} %.9g\n",            \
+                    plcs[i].lists[j].period,                \
+                    (double)plcs[i].lists[j].VALUE);        \
+        }
+    PROM_LIST("scanlist_enabled", "gauge", "1 if scan list is enabled",
+              enabled);
+    PROM_LIST("scanlist_tags", "gauge", "Tags on scan list", tags);
+    PROM_LIST("scanlist_errors_total", "counter",
+              "Communication errors of scan list", list_errors);
+    PROM_LIST("scanlist_schedule_errors_total", "counter",
+              "Scheduling errors of scan list", sched_errors);
+    PROM_LIST("scanlist_scan_seconds", "gauge",
+              "Duration of last scan", last_scan_time);
+    PROM_LIST("scanlist_max_scan_seconds", "gauge",
+              "Longest scan", max_scan_time);
+    PROM_LIST("scanlist_data_age_seconds", "gauge",
+              "Age of data per PLC time stamp tag", data_age);
+#undef PROM_LIST
+
+#define PROM_TAG(NAME, TYPE, HELP, VALUE)                   \
+    prom_header(f, NAME, TYPE, HELP);                       \
+    for (i=0; i<num_plcs; ++i)                              \
+        for (j=0; j<plcs[i].num_tags; ++j)                  \
+        {                                                   \
+            prom_PLC_label(f, NAME, plcs[i].plc);           \
+            fprintf(f, ",tag=\"");                          \
+            print_escaped(f, plcs[i].tags[j].string_tag);   \
+            fprintf(f, "\"} %.9g\n",                        \
+                    (double)plcs[i].tags[j].VALUE);         \
+        }
+    PROM_TAG("tag_valid", "gauge", "1 if tag has data", valid);
+    PROM_TAG("tag_transfer_seconds", "gauge",
+             "Last transfer that included the tag", transfer_time);
+#undef PROM_TAG
+
+    prom_header(f, "sync_skew_seconds", "gauge",
+                "Send time spread of last sync group sample");
+    for (i=0; i<num_groups; ++i)
+    {
+        fprintf(f, "ether_ip_sync_skew_seconds{group=\"");
+        print_escaped(f, groups[i].group->name);
+        fprintf(f, "\"} %.9g\n", groups[i].skew);
+    }
+    prom_header(f, "sync_incomplete_total", "counter",
+                "Sync group samples that missed members");
+    for (i=0; i<num_groups; ++i)
+    {
+        fprintf(f, "ether_ip_sync_incomplete_total{group=\"");
+        print_escaped(f, groups[i].group->name);
+        fprintf(f, "\"} %lu\n", (unsigned long)groups[i].incomplete);
+    }
+}
+
+eip_bool drvEtherIP_stats_write(const char *filename, const char *format)
+{
+    PLC            *plc;
+    EIPSyncGroup   *group;
+    StatsPLC       *plcs = 0;
+    StatsGroup     *groups = 0;
+    size_t         i, num_plcs = 0, num_groups = 0;
+    eip_bool       json, ok = true;
+    epicsTimeStamp now;
+    char           tsString[50], *tmpname;
+    FILE           *f;
+
+    if (!(filename  &&  filename[0]))
+    {
+        printf("drvEtherIP_stats_write: Missing file name\n");
+        return false;
+    }
+    if (format  &&  strncmp(format, "prom", 4) == 0)
+        json = false;
+    else if (!format  ||  !format[0]  ||  strcmp(format, "json") == 0)
+        json = true;
+    else
+    {
+        printf("drvEtherIP_stats_write: Unknown format '%s', "
+               "use \"json\" or \"prometheus\"\n", format);
+        return false;
+    }
+    if (drvEtherIP_private.lock == 0)
+    {
+        printf("drvEtherIP_stats_write: drvEtherIP_init wasn't called\n");
+        return false;
+    }
+    /* PLCs and sync groups are only added, never removed,
+     * so the driver lock is only needed to count them */
+    EIP_lock_driver();
+    for (plc = DLL_first(PLC,&drvEtherIP_private.PLCs);
+         plc;  plc = DLL_next(PLC,plc))
+        ++num_plcs;
+    for (group = DLL_first(EIPSyncGroup, &drvEtherIP_private.sync_groups);
+         group;  group = DLL_next(EIPSyncGroup, group))
+        ++num_groups;
+    plc = DLL_first(PLC,&drvEtherIP_private.PLCs);
+    group = DLL_first(EIPSyncGroup, &drvEtherIP_private.sync_groups);
+    if (! stats_cache_lock)
+        stats_cache_lock = epicsMutexCreate();
+    EIP_unlock_driver();
+    if (! stats_cache_lock)
+    {
+        EIP_printf(1, "drvEtherIP_stats_write: Cannot create mutex\n");
+        return false;
+    }
+
+    plcs = (StatsPLC *) calloc(num_plcs+1, sizeof(StatsPLC));
+    groups = (StatsGroup *) calloc(num_groups+1, sizeof(StatsGroup));
+    if (!(plcs  &&  groups))
+    {
+        EIP_printf(1, "drvEtherIP_stats_write: No memory\n");
+        if (plcs)
+            free(plcs);
+        if (groups)
+            free(groups);
+        return false;
+    }
+    for (i=0; i<num_plcs  &&  plc;  ++i, plc = DLL_next(PLC,plc))
+        if (! collect_PLC_stats(plc, &plcs[i]))
+            ok = false;
+    for (i=0; i<num_groups  &&  group;
+         ++i, group = DLL_next(EIPSyncGroup, group))
+    {
+        groups[i].group = group;
+        epicsMutexLock(group->lock);
+        groups[i].skew = group->skew;
+        groups[i].max_skew = group->max_skew;
+        groups[i].samples = group->samples;
+        groups[i].incomplete = group->incomplete;
+        epicsMutexUnlock(group->lock);
+    }
+    if (! ok)
+    {
+        EIP_printf(1, "drvEtherIP_stats_write: Cannot collect statistics\n");
+        free_stats(plcs, num_plcs);
+        free(groups);
+        return false;
+    }
+
+    /* No locks held from here on */
+    tmpname = (char *) malloc(strlen(filename) + 5);
+    if (! tmpname)
+    {
+        free_stats(plcs, num_plcs);
+        free(groups);
+        return false;
+    }
+    sprintf(tmpname, "%s.tmp", filename);
+    f = fopen(tmpname, "w");
+    if (! f)
+    {
+        EIP_printf(1, "drvEtherIP_stats_write: Cannot create '%s'\n",
+                   tmpname);
+        ok = false;
+    }
+    else
+    {
+        epicsTimeGetCurrent(&now);
+        epicsTimeToStrftime(tsString, sizeof(tsString),
+                            "%Y-%m-%dT%H:%M:%S.%06f", &now);
+        if (json)
+            write_stats_json(f, tsString, plcs, num_plcs, groups, num_groups);
+        else
+            write_stats_prometheus(f, plcs, num_plcs, groups, num_groups);
+        if (fclose(f) != 0  ||  rename(tmpname, filename) != 0)
+        {
+            EIP_printf(1, "drvEtherIP_stats_write: Cannot write '%s'\n",
+                       filename);
+            remove(tmpname);
+            ok = false;
+        }
+    }
+    free(tmpname);
+    cache_stats(plcs, num_plcs);
+    free(groups);
+    return ok;
+}
+
+#ifdef HAVE_314_API
+/* Settings of the export thread, protected by the driver lock */
+static char   *stats_filename = 0;
+static char   *stats_format = 0;
+static double stats_period = 0.0;
+static epicsThreadId stats_thread = 0;
+
+static void stats_export_task(void *arg)
+{
+    char   *filename, *format;
+    double period;
+
+    while (true)
+    {
+        filename = format = 0;
+        EIP_lock_driver();
+        period = stats_period;
+        if (period > 0.0)
+        {
+            filename = EIP_strdup(stats_filename);
+            format = EIP_strdup(stats_format);
+        }
+        EIP_unlock_driver();
+        if (filename  &&  format)
+            drvEtherIP_stats_write(filename, format);
+        if (filename)
+            free(filename);
+        if (format)
+            free(format);
+        epicsThreadSleep(period > 0.0 ? period : 1.0);
+    }
+}
+
+eip_bool drvEtherIP_stats_export(const char *filename, const char *format,
+                                 double period)
+{
+    char *new_filename = 0, *new_format = 0;
+
+    if (drvEtherIP_private.lock == 0)
+    {
+        printf("drvEtherIP_stats_export: drvEtherIP_init wasn't called\n");
+        return false;
+    }
+    if (period > 0.0)
+    {
+        if (!(filename  &&  filename[0]))
+        {
+            printf("drvEtherIP_stats_export: Missing file name\n");
+            return false;
+        }
+        new_filename = EIP_strdup(filename);
+        new_format = EIP_strdup(format ? format : "json");
+        if (!(new_filename  &&  new_format))
+        {
+            if (new_filename)
+                free(new_filename);
+            if (new_format)
+                free(new_format);
+            return false;
+        }
+    }
+    EIP_lock_driver();
+    if (stats_filename)
+        free(stats_filename);
+    if (stats_format)
+        free(stats_format);
+    stats_filename = new_filename;
+    stats_format = new_format;
+    stats_period = period > 0.0 ? period : 0.0;
+    if (stats_thread == 0  &&  stats_period > 0.0)
+        stats_thread = epicsThreadCreate(
+            "EIPstats", epicsThreadPriorityLow,
+            epicsThreadGetStackSize(epicsThreadStackMedium),
+            (EPICSTHREADFUNC)stats_export_task, 0);
+    EIP_unlock_driver();
+    if (period > 0.0  &&  stats_thread == 0)
+    {
+        printf("drvEtherIP_stats_export: Cannot start thread\n");
+        return false;
+    }
+    return true;
+}
+#endif
+
+/* Copy of the boot timeline, taken under the locks */
+typedef struct
+{
+    const char     *name;
+    epicsTimeStamp connect, connected, sized, scanned;
+}   BootPLC;
+
+typedef struct
+{
+    epicsTimeStamp start, records, done;
+    BootPhase      phase[EIP_BOOT_PHASES];
+    size_t         num_plcs;
+    BootPLC        *plcs;
+}   BootTimeline;
+
+static eip_bool collect_boot(BootTimeline *timeline)
+{
+    PLC    *plc;
+    size_t i;
+
+    memset(timeline, 0, sizeof(BootTimeline));
+    if (drvEtherIP_private.lock == 0  ||  boot.lock == 0)
+        return false;
+    EIP_lock_driver();
+    for (plc = DLL_first(PLC, &drvEtherIP_private.PLCs);  plc;
+         plc = DLL_next(PLC, plc))
+        ++timeline->num_plcs;
+    timeline->plcs = (BootPLC *) calloc(timeline->num_plcs+1, sizeof(BootPLC));
+    if (! timeline->plcs)
+    {
+        EIP_unlock_driver();
+        return false;
+    }
+    for (i=0, plc = DLL_first(PLC, &drvEtherIP_private.PLCs);
+         plc  &&  i < timeline->num_plcs;  plc = DLL_next(PLC, plc), ++i)
+    {
+        EIP_lock_PLC(plc);
+        timeline->plcs[i].name      = plc->name;
+        timeline->plcs[i].connect   = plc->boot_connect;
+        timeline->plcs[i].connected = plc->boot_connected;
+        timeline->plcs[i].sized     = plc->boot_sized;
+        EIP_unlock_PLC(plc);
+        epicsMutexLock(boot.lock);
+        timeline->plcs[i].scanned   = plc->boot_scanned;
+        epicsMutexUnlock(boot.lock);
+    }
+    EIP_unlock_driver();
+    epicsMutexLock(boot.lock);
+    timeline->start   = boot.start;
+    timeline->records = boot.records;
+    timeline->done    = boot.done;
+    memcpy(timeline->phase, boot.phase, sizeof(boot.phase));
+    epicsMutexUnlock(boot.lock);
+    return true;
+}
+
+/* Seconds from drvEtherIP_init to stamp, -1 if not set */
+static double boot_secs(const BootTimeline *timeline,
+                        const epicsTimeStamp *stamp)
+{
+    epicsTimeStamp start = timeline->start, t = *stamp;
+
+    if (! is_time_set(stamp))
+        return -1.0;
+    return epicsTimeDiffInSeconds(&t, &start);
+}
+
+static void boot_print_step(const BootTimeline *timeline, const char *label,
+                            const epicsTimeStamp *from,
+                            const epicsTimeStamp *to)
+{
+    double start = boot_secs(timeline, from), end = boot_secs(timeline, to);
+
+    if (start < 0.0)
+        printf("    %-20s: -\n", label);
+    else if (end < 0.0)
+        printf("    %-20s: %8.3f .. (not done)\n", label, start);
+    else
+        printf("    %-20s: %8.3f .. %8.3f, %.3f secs\n",
+               label, start, end, end - start);
+}
+
+void drvEtherIP_boot_report()
+{
+    BootTimeline timeline;
+    BootPhase    *phase;
+    BootPLC      *plc;
+    size_t       i;
+
+    if (! collect_boot(&timeline))
+    {
+        printf("drvEtherIP_boot_report: No timeline\n");
+        return;
+    }
+    printf("drvEtherIP boot timeline, seconds since drvEtherIP_init:\n");
+    for (i=0; i<EIP_BOOT_PHASES; ++i)
+    {
+        phase = &timeline.phase[i];
+        if (phase->count <= 0)
+            continue;
+        printf("  %-22s: %8.3f .. %8.3f, %lu calls, %.3f secs\n",
+               boot_phase_name[i],
+               boot_secs(&timeline, &phase->first),
+               boot_secs(&timeline, &phase->last),
+               (unsigned long)phase->count, phase->total);
+    }
+    if (is_time_set(&timeline.records))
+        printf("  %-22s: %8.3f\n", "records initialized",
+               boot_secs(&timeline, &timeline.records));
+    for (i=0; i<timeline.num_plcs; ++i)
+    {
+        plc = &timeline.plcs[i];
+        printf("  PLC '%s'\n", plc->name);
+        boot_print_step(&timeline, "connect", &plc->connect, &plc->connected);
+        boot_print_step(&timeline, "tag sizes", &plc->connected, &plc->sized);
+        boot_print_step(&timeline, "first scan", &plc->sized, &plc->scanned);
+    }
+    if (is_time_set(&timeline.done))
+        printf("  %-22s: %8.3f\n", "all PLCs scanned",
+               boot_secs(&timeline, &timeline.done));
+    free(timeline.plcs);
+}
+
+/* Chrome trace events, time in microseconds */
+static void boot_trace_span(FILE *f, const BootTimeline *timeline,
+                            const char *name, int tid,
+                            const epicsTimeStamp *from,
+                            const epicsTimeStamp *to)
+{
+    double start = boot_secs(timeline, from), end = boot_secs(timeline, to);
+
+    if (start < 0.0  ||  end < 0.0)
+        return;
+    fprintf(f, ",\n  {\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, "
+            "\"tid\": %d, \"ts\": %.0f, \"dur\": %.0f}",
+            name, tid, start*1e6, (end-start)*1e6);
+}
+
+static void boot_trace_mark(FILE *f, const BootTimeline *timeline,
+                            const char *name, const epicsTimeStamp *when)
+{
+    double t = boot_secs(timeline, when);
+
+    if (t < 0.0)
+        return;
+    fprintf(f, ",\n  {\"name\": \"%s\", \"ph\": \"i\", \"s\": \"g\", "
+            "\"pid\": 1, \"tid\": 0, \"ts\": %.0f}", name, t*1e6);
+}
+
+eip_bool drvEtherIP_boot_trace(const char *filename)
+{
+    BootTimeline timeline;
+    BootPhase    *phase;
+    BootPLC      *plc;
+    size_t       i;
+    double       start, end;
+    FILE         *f;
+
+    if (!(filename  &&  filename[0]))
+    {
+        printf("drvEtherIP_boot_trace: Missing file name\n");
+        return false;
+    }
+    if (! collect_boot(&timeline))
+    {
+        printf("drvEtherIP_boot_trace: No timeline\n");
+        return false;
+    }
+    f = fopen(filename, "w");
+    if (! f)
+    {
+        printf("drvEtherIP_boot_trace: Cannot create '%s'\n", filename);
+        free(timeline.plcs);
+        return false;
+    }
+    fprintf(f, "{\"displayTimeUnit\": \"ms\",\n\"traceEvents\": [\n");
+    fprintf(f, "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+            "\"tid\": 0, \"args\": {\"name\": \"IOC\"}}");
+    for (i=0; i<EIP_BOOT_PHASES; ++i)
+    {   /* Span from first to last call, total time in args */
+        phase = &timeline.phase[i];
+        if (phase->count <= 0)
+            continue;
+        start = boot_secs(&timeline, &phase->first);
+        end = boot_secs(&timeline, &phase->last);
+        fprintf(f, ",\n  {\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, "
+                "\"tid\": 0, \"ts\": %.0f, \"dur\": %.0f, "
+                "\"args\": {\"calls\": %lu, \"secs\": %.6f}}",
+                boot_phase_name[i], start*1e6, (end-start)*1e6,
+                (unsigned long)phase->count, phase->total);
+    }
+    boot_trace_mark(f, &timeline, "records initialized", &timeline.records);
+    for (i=0; i<timeline.num_plcs; ++i)
+    {
+        plc = &timeline.plcs[i];
+        fprintf(f, ",\n  {\"name\": \"thread_name\", \"ph\": \"M\", "
+                "\"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"PLC ",
+                (int)i+1);
+        print_escaped(f, plc->name);
+        fprintf(f, "\"}}");
+        boot_trace_span(f, &timeline, "connect", (int)i+1,
+                        &plc->connect, &plc->connected);
+        boot_trace_span(f, &timeline, "tag sizes", (int)i+1,
+                        &plc->connected, &plc->sized);
+        boot_trace_span(f, &timeline, "first scan", (int)i+1,
+                        &plc->sized, &plc->scanned);
+    }
+    boot_trace_mark(f, &timeline, "all PLCs scanned", &timeline.done);
+    fprintf(f, "\n]}\n");
+    free(timeline.plcs);
+    if (fclose(f) != 0)
+    {
+        printf("drvEtherIP_boot_trace: Cannot write '%s'\n", filename);
+        return false;
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------
+ * Cluster mode
+ *
+ * Each node periodically writes <directory>/<node>.node,
+ *     time <seconds since EPICS epoch>
+ *     weight <w>
+ *     load <l>
+ *     plc <name>           ... for each PLC that the node scans,
+ * and reads the files of the other nodes.
+ * A PLC belongs to the live node with the highest weighted
+ * rendezvous score for the pair of node and PLC name,
+ * so all nodes agree without further messages,
+ * and when a node joins or dies only its share of the PLCs moves.
+ * A node takes a PLC only when no other live node lists it,
+ * i.e. after the previous owner released it.
+ * ------------------------------------------------------------ */
+#if defined(HAVE_314_API) && !defined(_WIN32)
+/* Settings of the cluster thread, protected by cluster_lock */
+static char   *cluster_directory = 0;
+static char   *cluster_node = 0;
+static double cluster_period = 0.0;
+static double cluster_timeout = 0.0;
+static epicsThreadId cluster_thread = 0;
+/* Protects the settings, so that the cluster thread
+ * doesn't depend on the driver lock.
+ */
+static epicsMutexId cluster_lock = 0;
+
+/* Score of node for plc, based on FNV-1a hash mapped into (0, 1) */
+static double cluster_score(const char *node, const char *plc, double weight)
+{
+    unsigned long hash = 2166136261UL;
+    const char *c;
+
+    for (c = node; *c; ++c)
+        hash = ((hash ^ (unsigned char)*c) * 16777619UL) & 0xFFFFFFFFUL;
+    hash = (hash * 16777619UL) & 0xFFFFFFFFUL; /* separator */
+    for (c = plc; *c; ++c)
+        hash = ((hash ^ (unsigned char)*c) * 16777619UL) & 0xFFFFFFFFUL;
+    /* Mix low into high bits, similar names still differ */
+    hash ^= hash >> 16;
+    hash = (hash * 0x85EBCA6BUL) & 0xFFFFFFFFUL;
+    hash ^= hash >> 13;
+    hash = (hash * 0xC2B2AE35UL) & 0xFFFFFFFFUL;
+    hash ^= hash >> 16;
+    return -weight / log((hash + 0.5) / 4294967296.0);
+}
+
+static double cluster_now()
+{
+    epicsTimeStamp now;
+
+    epicsTimeGetCurrent(&now);
+    return now.secPastEpoch + now.nsec * 1e-9;
+}
+
+/* Read <directory>/<peer>.node, let a live peer bid for the PLCs */
+static void cluster_read_peer(const char *filename, const char *peer,
+                              double timeout, PLC **plcs, size_t num_plcs,
+                              double *best, char (*owner)[EIP_CLUSTER_NODE_LEN],
+                              eip_bool *claimed)
+{
+    FILE   *f;
+    char   line[EIP_MAX_TAG_LENGTH+10];
+    double peer_time = -1.0, weight = -1.0, score;
+    size_t i, len;
+
+    f = fopen(filename, "r");
+    if (! f)
+        return;
+    while (fgets(line, sizeof(line), f))
+    {
+        if (strncmp(line, "time ", 5) == 0)
+            peer_time = strtod(line+5, 0);
+        else if (strncmp(line, "weight ", 7) == 0)
+            weight = strtod(line+7, 0);
+    }
+    if (peer_time < 0.0  ||  weight <= 0.0  ||
+        cluster_now() - peer_time > timeout)
+    {
+        EIP_printf(4, "drvEtherIP cluster: node '%s' is not alive\n", peer);
+        fclose(f);
+        return;
+    }
+    for (i=0; i<num_plcs; ++i)
+    {
+        score = cluster_score(peer, plcs[i]->name, weight);
+        if (score > best[i]  ||
+            (score == best[i]  &&  strcmp(peer, owner[i]) < 0))
+        {
+            best[i] = score;
+            strcpy(owner[i], peer);
+        }
+    }
+    rewind(f);
+    while (fgets(line, sizeof(line), f))
+    {
+        if (strncmp(line, "plc ", 4) != 0)
+            continue;
+        len = strlen(line);
+        while (len > 4  &&  (line[len-1] == '\n'  ||  line[len-1] == '\r'))
+            line[--len] = '\0';
+        for (i=0; i<num_plcs; ++i)
+            if (strcmp(plcs[i]->name, line+4) == 0)
+                claimed[i] = true;
+    }
+    fclose(f);
+}
+
+/* Write <directory>/<node>.node, the heartbeat of this node.
+ * Doesn't lock the PLCs, so it's not delayed by a scan task
+ * that waits for an unreachable PLC.
+ */
+static void cluster_write(const char *directory, const char *node,
+                          double weight, double load,
+                          PLC **plcs, size_t num_plcs)
+{
+    char   *filename, *tmpname;
+    FILE   *f;
+    size_t i, len;
+
+    len = strlen(directory) + EIP_CLUSTER_NODE_LEN + 10;
+    filename = (char *) malloc(len);
+    tmpname = (char *) malloc(len);
+    if (!(filename  &&  tmpname))
+    {
+        EIP_printf(1, "drvEtherIP cluster: No memory\n");
+        goto done;
+    }
+    sprintf(filename, "%s/%s.node", directory, node);
+    sprintf(tmpname, "%s/%s.tmp", directory, node);
+    f = fopen(tmpname, "w");
+    if (! f)
+    {
+        EIP_printf(1, "drvEtherIP cluster: Cannot create '%s'\n", tmpname);
+        goto done;
+    }
+    fprintf(f, "time %.3f\n", cluster_now());
+    fprintf(f, "weight %.3f\n", weight);
+    fprintf(f, "load %.3f\n", load);
+    for (i=0; i<num_plcs; ++i)
+        if (EIP_atomic_get(plcs[i]->owned))
+            fprintf(f, "plc %s\n", plcs[i]->name);
+    if (fclose(f) != 0  ||  rename(tmpname, filename) != 0)
+    {
+        EIP_printf(1, "drvEtherIP cluster: Cannot write '%s'\n", filename);
+        remove(tmpname);
+    }
+done:
+    if (filename)
+        free(filename);
+    if (tmpname)
+        free(tmpname);
+}
+
+/* Update the cluster thread's copy of the PLC list.
+ * The driver lock can be held for a long time by code that waits
+ * for a PLC lock, so keep the previous copy when it's taken.
+ * PLCs are never removed, so the old copy remains valid.
+ */
+static void cluster_get_PLCs(PLC ***plcs, size_t *num_plcs)
+{
+    PLC    *plc, **copy;
+    size_t i, num = 0;
+
+    if (epicsMutexTryLock(drvEtherIP_private.lock) != epicsMutexLockOK)
+        return;
+    for (plc = DLL_first(PLC, &drvEtherIP_private.PLCs);  plc;
+         plc = DLL_next(PLC, plc))
+        ++num;
+    if (num != *num_plcs)
+    {
+        copy = (PLC **) calloc(num+1, sizeof(PLC *));
+        if (copy)
+        {
+            for (i=0, plc = DLL_first(PLC, &drvEtherIP_private.PLCs);
+                 plc  &&  i<num;  plc = DLL_next(PLC, plc))
+                copy[i++] = plc;
+            if (*plcs)
+                free(*plcs);
+            *plcs = copy;
+            *num_plcs = num;
+        }
+    }
+    epicsMutexUnlock(drvEtherIP_private.lock);
+}
+
+/* One turn of the cluster thread:
+ * Publish this node's heartbeat, read the peers,
+ * update which PLCs this node owns.
+ * 'weight' is the last published weight of this node.
+ */
+static void cluster_update(const char *directory, const char *node,
+                           double timeout, double *weight,
+                           PLC **plcs, size_t num_plcs)
+{
+    size_t        i, len;
+    double        *best = 0, load = 0.0, new_weight;
+    char          (*owner)[EIP_CLUSTER_NODE_LEN] = 0;
+    eip_bool      *claimed = 0, owned, changed = false;
+    char          *filename = 0;
+    DIR           *dir;
+    struct dirent *entry;
+
+    /* Load of this node: Fraction of time that its scan tasks
+     * spend in transfers, summed over the PLCs it owns.
+     * Weight changes in coarse steps to avoid moving PLCs back and forth.
+     */
+    for (i=0; i<num_plcs; ++i)
+        if (EIP_atomic_get(plcs[i]->owned))
+            load += EIP_atomic_get(plcs[i]->busy) / 1000.0;
+    new_weight = 1.0 / (1.0 + load);
+    if (fabs(new_weight - *weight) >= 0.1)
+        *weight = new_weight;
+
+    /* Heartbeat first, nothing else may delay it */
+    cluster_write(directory, node, *weight, load, plcs, num_plcs);
+
+    best = (double *) calloc(num_plcs+1, sizeof(double));
+    owner = (char (*)[EIP_CLUSTER_NODE_LEN])
+            calloc(num_plcs+1, EIP_CLUSTER_NODE_LEN);
+    claimed = (eip_bool *) calloc(num_plcs+1, sizeof(eip_bool));
+    filename = (char *) malloc(strlen(directory) + EIP_CLUSTER_NODE_LEN + 10);
+    if (!(best && owner && claimed && filename))
+    {
+        EIP_printf(1, "drvEtherIP cluster: No memory\n");
+        goto done;
+    }
+    /* Bid with the weight that the peers see */
+    for (i=0; i<num_plcs; ++i)
+    {
+        best[i] = cluster_score(node, plcs[i]->name, *weight);
+        strcpy(owner[i], node);
+    }
+    dir = opendir(directory);
+    if (! dir)
+    {
+        EIP_printf(1, "drvEtherIP cluster: Cannot read directory '%s'\n",
+                   directory);
+        goto done;
+    }
+    while ((entry = readdir(dir)))
+    {
+        len = strlen(entry->d_name);
+        if (len <= 5  ||  len-5 >= EIP_CLUSTER_NODE_LEN  ||
+            strcmp(entry->d_name + len-5, ".node") != 0)
+            continue;
+        sprintf(filename, "%s/%s", directory, entry->d_name);
+        entry->d_name[len-5] = '\0';
+        if (strcmp(entry->d_name, node) == 0)
+            continue;
+        cluster_read_peer(filename, entry->d_name, timeout,
+                          plcs, num_plcs, best, owner, claimed);
+    }
+    closedir(dir);
+
+    /* Release PLCs that belong elsewhere, take those that are free.
+     * The scan task reads 'owned' without the PLC lock.
+     */
+    for (i=0; i<num_plcs; ++i)
+    {
+        owned = strcmp(owner[i], node) == 0  &&  !claimed[i];
+        if (EIP_atomic_get(plcs[i]->owned) != owned)
+        {
+            EIP_printf_time(1, "drvEtherIP cluster: %s PLC '%s'\n",
+                            owned ? "Taking" : "Releasing", plcs[i]->name);
+            set_owned(plcs[i], owned);
+            changed = true;
+        }
+        strcpy(plcs[i]->owner, owner[i]);
+    }
+    /* Let peers know right away */
+    if (changed)
+        cluster_write(directory, node, *weight, load, plcs, num_plcs);
+done:
+    if (best)
+        free(best);
+    if (owner)
+        free(owner);
+    if (claimed)
+        free(claimed);
+    if (filename)
+        free(filename);
+}
+
+/* Cluster mode stopped: Remove our file, scan all PLCs */
+static void cluster_leave(const char *directory, const char *node,
+                          PLC **plcs, size_t num_plcs)
+{
+    char   *filename;
+    size_t i;
+
+    filename = (char *) malloc(strlen(directory) + strlen(node) + 10);
+    if (filename)
+    {
+        sprintf(filename, "%s/%s.node", directory, node);
+        remove(filename);
+        free(filename);
+    }
+    for (i=0; i<num_plcs; ++i)
+    {
+        set_owned(plcs[i], true);
+        plcs[i]->owner[0] = '\0';
+    }
+}
+
+static void cluster_task(void *arg)
+{
+    char   *directory = 0, *node = 0;
+    double period, timeout, weight = 1.0;
+    PLC    **plcs = 0;
+    size_t num_plcs = 0;
+
+    while (true)
+    {
+        epicsMutexLock(cluster_lock);
+        period = cluster_period;
+        timeout = cluster_timeout;
+        if (period > 0.0  &&  !(directory  &&  node  &&
+                                strcmp(directory, cluster_directory) == 0  &&
+                                strcmp(node, cluster_node) == 0))
+        {   /* (new) settings */
+            if (directory)
+                free(directory);
+            if (node)
+                free(node);
+            directory = EIP_strdup(cluster_directory);
+            node = EIP_strdup(cluster_node);
+        }
+        epicsMutexUnlock(cluster_lock);
+        cluster_get_PLCs(&plcs, &num_plcs);
+        if (period > 0.0  &&  directory  &&  node)
+            cluster_update(directory, node, timeout, &weight,
+                           plcs, num_plcs);
+        else if (directory  &&  node)
+        {
+            cluster_leave(directory, node, plcs, num_plcs);
+            free(directory);
+            free(node);
+            directory = node = 0;
+        }
+        epicsThreadSleep(period > 0.0 ? period : 1.0);
+    }
+}
+
+eip_bool drvEtherIP_cluster(const char *directory, const char *node,
+                            double period, double timeout)
+{
+    PLC  *plc;
+    char *new_directory = 0, *new_node = 0;
+
+    if (drvEtherIP_private.lock == 0)
+    {
+        printf("drvEtherIP_cluster: drvEtherIP_init wasn't called\n");
+        return false;
+    }
+    if (period > 0.0)
+    {
+        if (!(directory  &&  directory[0]  &&  node  &&  node[0]))
+        {
+            printf("drvEtherIP_cluster: Missing directory or node name\n");
+            return false;
+        }
+        if (strlen(node) >= EIP_CLUSTER_NODE_LEN  ||  strchr(node, '/'))
+        {
+            printf("drvEtherIP_cluster: Invalid node name '%s'\n", node);
+            return false;
+        }
+        if (timeout <= period)
+            timeout = 3 * period;
+        new_directory = EIP_strdup(directory);
+        new_node = EIP_strdup(node);
+        if (!(new_directory  &&  new_node))
+        {
+            if (new_directory)
+                free(new_directory);
+            if (new_node)
+                free(new_node);
+            return false;
+        }
+    }
+    EIP_lock_driver();
+    if (cluster_lock == 0)
+        cluster_lock = epicsMutexCreate();
+    if (cluster_lock == 0)
+    {
+        EIP_unlock_driver();
+        printf("drvEtherIP_cluster: Cannot create mutex\n");
+        if (new_directory)
+            free(new_directory);
+        if (new_node)
+            free(new_node);
+        return false;
+    }
+    if (period > 0.0  &&  !cluster_active)
+    {   /* Stop scanning until the cluster assigns PLCs to this node */
+        for (plc = DLL_first(PLC, &drvEtherIP_private.PLCs);  plc;
+             plc = DLL_next(PLC, plc))
+            set_owned(plc, false);
+    }
+    epicsMutexLock(cluster_lock);
+    if (cluster_directory)
+        free(cluster_directory);
+    if (cluster_node)
+        free(cluster_node);
+    cluster_directory = new_directory;
+    cluster_node = new_node;
+    cluster_period = period > 0.0 ? period : 0.0;
+    cluster_timeout = timeout;
+    epicsMutexUnlock(cluster_lock);
+    cluster_active = period > 0.0;
+    if (cluster_thread == 0  &&  cluster_active)
+        cluster_thread = epicsThreadCreate(
+            "EIPcluster", epicsThreadPriorityLow,
+            epicsThreadGetStackSize(epicsThreadStackMedium),
+            (EPICSTHREADFUNC)cluster_task, 0);
+    EIP_unlock_driver();
+    if (period > 0.0  &&  cluster_thread == 0)
+    {
+        printf("drvEtherIP_cluster: Cannot start thread\n");
+        return false;
+    }
+    return true;
+}
+#elif defined(HAVE_314_API)
+eip_bool drvEtherIP_cluster(const char *directory, const char *node,
+                            double period, double timeout)
+{
+    printf("drvEtherIP_cluster: Not supported on this platform\n");
+    return false;
+}
+#endif
+
+/* Jeff Hill noticed that driver could invoke for example ao record callbacks,
+ * i.e. call scanOnce() on a record, while the IOC is still starting up
+ * and the "onceQ" ring buffer is not initalized.
+ *
+ * drvEtherIP_restart will therefore not perform anything until the database
+ * is available as indicated by the init hook setting databaseIsReady
+ */
+#ifdef HAVE_314_API
+void drvEtherIP_initHook ( initHookState state )
+{
+    if (drvEtherIP_private.lock == 0) return;
+    if ( state == initHookAfterScanInit ) {
+        EIP_lock_driver();
+        databaseIsReady = true;
+        EIP_unlock_driver();
+        if (boot.lock)
+        {
+            epicsMutexLock(boot.lock);
+            epicsTimeGetCurrent(&boot.records);
+            epicsMutexUnlock(boot.lock);
+        }
         drvEtherIP_restart();
     }
 }
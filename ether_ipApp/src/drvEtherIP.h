@@ -25,10 +25,101 @@
 /* TCP timeout in millisec for connection and readback */
 #define ETHERIP_TIMEOUT 5000
 
+/* Number of PLC clock readings kept to estimate the clock offset */
+#define EIP_CLOCK_SAMPLES 8
+
+/* Max. number of tags checked per transfer after a program change */
+#define EIP_REVALIDATE_BATCH 50
+
+/* Stack bytes that the scan task touches when memory is locked */
+#define EIP_PREFAULT_STACK (64*1024)
+
+/* Histogram bins: bin i counts times below EIP_HISTO_BASE * 2^i,
+ * the last bin counts everything above
+ */
+#define EIP_HISTO_BINS 16
+#define EIP_HISTO_BASE 100e-6  /* second */
+
+/* Max. length of a cluster node name, see drvEtherIP_cluster */
+#define EIP_CLUSTER_NODE_LEN 40
+
+/* Boot phases timed per call, see drvEtherIP_boot_report */
+typedef enum
+{
+    EIP_BOOT_LINK,              /* device support parses a record's link */
+    EIP_BOOT_ADD_TAG,           /* drvEtherIP_add_tag                    */
+    EIP_BOOT_PHASES
+}   EIPBootPhase;
+
+typedef struct
+{
+    size_t count;               /* # of samples */
+    double total;               /* sum of samples [secs] */
+    double max;                 /* maximum sample [secs] */
+    size_t bins[EIP_HISTO_BINS];
+}   EIPHistogram;
+
+/* Input record types for the update delay statistics */
+typedef enum
+{
+    EIP_REC_AI,
+    EIP_REC_BI,
+    EIP_REC_MBBI,
+    EIP_REC_MBBI_DIRECT,
+    EIP_REC_STRINGIN,
+    EIP_REC_WAVEFORM,
+    EIP_REC_TYPES
+}   EIPRecordType;
+
+/* Statistics for one class of locks, see drvEtherIP_lock_stats */
+typedef struct
+{
+    epicsMutexId guard;       /* protects the statistics,
+                               * 0 if the instrumented lock does */
+    size_t       count;       /* # of times taken */
+    size_t       contended;   /* # of times that had to wait */
+    EIPHistogram wait_histo;  /* time waited when contended */
+    double       max_hold;    /* longest time held [secs] */
+}   EIPLockStats;
+
+/* Per-lock state for EIPLockStats.
+ * The locks are recursive, only the outermost lock/unlock
+ * of the owning thread is timed.
+ */
+typedef struct
+{
+    epicsTimeStamp since;     /* when the lock was taken */
+    int            depth;     /* # of nested locks while timed */
+}   EIPLockHold;
+
 typedef struct __TagInfo  TagInfo;  /* forwards */
 typedef struct __ScanList ScanList;
 typedef struct __PLC      PLC;
 
+/* Sync group:
+ * Scan lists of several PLCs that are read at the same instant.
+ * The scan tasks record when they sent each sample,
+ * the group tracks how far apart that was.
+ */
+typedef struct
+{
+    DLL_Node       node;
+    char           *name;
+    double         period;       /* of the member scan lists [secs]  */
+    double         phase;        /* within the period [secs]         */
+    size_t         members;      /* # of member scan lists           */
+    epicsMutexId   lock;         /* for the following; taken last    */
+    epicsTimeStamp sample_time;  /* scheduled time of current sample */
+    size_t         reported;     /* members that sent current sample */
+    epicsTimeStamp first_send;   /* earliest and latest send time    */
+    epicsTimeStamp last_send;    /* of current sample                */
+    double         skew;         /* last complete sample: latest minus */
+    double         max_skew;     /* earliest send time [secs], max.  */
+    size_t         samples;      /* # of complete samples            */
+    size_t         incomplete;   /* # of samples missing members     */
+    EIPHistogram   skew_histo;
+}   EIPSyncGroup;
+
 /* THE singleton main structure for this driver
  * Note that each PLC entry has it's own lock
  * for the scanlists & statistics.
@@ -39,7 +130,10 @@ typedef struct __PLC      PLC;
 typedef struct
 {
     DL_List      PLCs; /* List of PLC structs */
+    DL_List      sync_groups; /* List of EIPSyncGroup structs */
     epicsMutexId lock;
+    EIPLockStats lock_stats;
+    EIPLockHold  lock_hold; /* for lock_stats */
 } DrvEtherIP_Private;
 
 /* PLCInfo:
@@ -58,11 +152,74 @@ struct __PLC
     char          *name;        /* symbolic name, used to identify PLC    */
     char          *ip_addr;     /* IP or DNS name that IOC knows          */
     int           slot;         /* slot in ControlLogix Backplane: 0, ... */
+    size_t        index;        /* 0, 1, ... in order of definition       */
     size_t        plc_errors;   /* # of communication errors              */
     size_t        slow_scans;   /* Count: scan task is getting late       */
     EIPConnection *connection;
     DL_List       scanlists;    /* List of struct ScanList */
     epicsThreadId scan_task_id;
+    EIPLockStats  lock_stats;   /* for 'lock'                             */
+    EIPLockHold   lock_hold;    /* for lock_stats                         */
+    EIPLockStats  data_lock_stats; /* for all TagInfo.data_lock           */
+    /* Scan task options, see drvEtherIP_PLC_thread */
+    int           thread_priority; /* >0 real-time, <0 best effort      */
+    char          *thread_cpus; /* CPU list, 0 for any                    */
+    eip_bool      lock_memory;  /* mlockall, prefault stack               */
+    eip_bool      thread_update;/* scan task needs to apply options       */
+    int           verbosity;    /* for scan task, -1 for EIP_verbosity    */
+    /* PLC wall clock, see drvEtherIP_clock_period */
+    epicsTimeStamp clock_time;  /* last clock reading                     */
+    double        clock_offset; /* PLC clock - IOC clock [secs]           */
+    double        clock_delay;  /* round trip of reading used for offset  */
+    double        min_clock_offset;
+    double        max_clock_offset;
+    size_t        clock_errors; /* # of failed clock readings             */
+    size_t        clock_samples;/* # of valid sample_offset/delay entries */
+    double        sample_offset[EIP_CLOCK_SAMPLES];
+    double        sample_delay[EIP_CLOCK_SAMPLES];
+    TagInfo       *timestamp_tag; /* optional, read with each transfer    */
+    /* Program change detection, see drvEtherIP_change_period */
+    epicsTimeStamp status_time; /* last check of controller status        */
+    CN_UINT       plc_status;   /* Identity status of controller          */
+    eip_bool      have_status;  /* plc_status is valid                    */
+    eip_bool      revalidate;   /* tags need to be checked                */
+    size_t        revalidate_index; /* next tag to check                  */
+    size_t        revalidate_single;/* # of tags to check one by one      */
+    size_t        program_changes;  /* # of detected changes              */
+    size_t        changed_tags; /* # of tags found changed                */
+    /* Write latency, see TagInfo.write_request_time */
+    EIPHistogram  write_queue_histo;    /* record..request sent           */
+    EIPHistogram  write_transfer_histo; /* request sent..response         */
+    EIPHistogram  write_callback_histo; /* response..callbacks done       */
+    /* Round trip of scan list transfers, measured by the scan task
+     * and, where supported, from kernel time stamps of the packets */
+    EIPHistogram  transfer_histo;
+    EIPHistogram  wire_histo;
+    /* Delay from receiving data until input record reads it,
+     * per record type. Records lock stats_lock, not the PLC */
+    epicsMutexId  stats_lock;
+    EIPHistogram  update_delay_histo[EIP_REC_TYPES];
+    DL_List       fifos;        /* List of struct EIPFifo */
+    DL_List       aggregates;   /* List of struct EIPAggregate */
+    DL_List       free_callbacks; /* Removed TagCallbacks, for reuse    */
+    size_t        scan_allocs;  /* Allocations after connecting       */
+    size_t        congestion_limit;  /* Effective transfer_buffer_limit,   */
+    size_t        congestion_count;  /* max. requests per transfer (0: any) */
+    size_t        congestion_events; /* # of times they were reduced       */
+    /* Cluster mode, see drvEtherIP_cluster.
+     * 'owned' and 'busy' are accessed via EIP_atomic_get/set
+     * because the cluster thread must not wait for the PLC lock.
+     * 'owned' is changed via set_owned for the boot timeline.
+     */
+    eip_bool      owned;        /* this IOC may scan the PLC              */
+    int           busy;         /* 1/1000 of time in transfers            */
+    char          owner[EIP_CLUSTER_NODE_LEN]; /* node that should scan it */
+    /* Boot timeline, see drvEtherIP_boot_report */
+    epicsTimeStamp boot_connect;   /* first connection attempt            */
+    epicsTimeStamp boot_connected; /* first connection                    */
+    epicsTimeStamp boot_sized;     /* sizes of all tags known             */
+    epicsTimeStamp boot_scanned;   /* all enabled lists scanned once,
+                                    * protected by the boot timeline lock */
 };
 
 /* ScanList:
@@ -75,6 +232,9 @@ struct __ScanList
     PLC            *plc;            /* PLC to which this Scanlist belongs */
     eip_bool       enabled;
     double         period;          /* scan period [secs]  */
+    double         phase;           /* start within period [secs], */
+    double         auto_phase;      /* <0 to use the automatic one */
+    EIPSyncGroup   *sync;           /* sync group or 0 */
     size_t         list_errors;     /* # of communication errors */
     size_t         sched_errors;    /* # of scheduling errors */
     epicsTimeStamp scan_time;       /* stamp of last run time */
@@ -82,6 +242,10 @@ struct __ScanList
     double         min_scan_time;   /* statistics: scan time in seconds */
     double         max_scan_time;   /* minimum, maximum, */
     double         last_scan_time;  /* and most recent scan */
+    double         data_age;        /* statistics: age of data in seconds */
+    double         min_data_age;    /* per PLC's timestamp_tag, */
+    double         max_data_age;    /* 0 when not available */
+    eip_bool       scanned_once;    /* for boot timeline */
     DL_List        taginfos;        /* List of struct TagInfo */
 };
 
@@ -116,26 +280,151 @@ struct __TagInfo
     char       *string_tag;        /* tag as text */
     ParsedTag  *tag;               /* tag, compiled */
     size_t     elements;           /* array elements to read (or 1) */
+    eip_bool   priority;           /* transfer before other tags of list */
     size_t     cip_r_request_size; /* byte-size of read request */
     size_t     cip_r_response_size;/* byte-size of read response */
     size_t     cip_w_request_size; /* byte-size of write request */
     size_t     cip_w_response_size;/* byte-size of write response */
     epicsMutexId data_lock;        /* see "locking" in drvEtherIP.c */
+    EIPLockStats *lock_stats;      /* PLC.data_lock_stats */
+    EIPLockHold lock_hold;         /* for *lock_stats */
     size_t     data_size;          /* total size of data buffer */
     size_t     valid_data_size;    /* used portion of data, 0 for "invalid" */
-    eip_bool   do_write;           /* set by device, reset by driver */
+    eip_bool   do_write;           /* set by device, reset by driver, atomic */
     eip_bool   is_writing;         /* driver copy of do_write for cycle */
+    eip_bool   read_back;          /* driver reads right after writing */
     CN_USINT   *data;              /* CIP data (type, raw data), with buffer capacity of data_size */
     double     transfer_time;      /* time needed for last transfer */
+    double     wire_time;          /* same per kernel time stamps, 0 if unknown */
     DL_List    callbacks;          /* TagCallbacks for new values&write done */
+    epicsTimeStamp update_time;        /* when driver received data */
+    epicsTimeStamp write_request_time; /* set by device with do_write */
+    epicsTimeStamp write_start_time;   /* driver copy for is_writing */
+    double     write_queue_time;   /* last write: record..request sent, */
+    double     write_transfer_time;/* request sent..response, */
+    double     write_callback_time;/* response..callbacks done */
 };
 
+/* EIPFifo:
+ * Circular buffer in the PLC: Array tag of 'size' elements,
+ * and an index tag (DINT) with the element that the PLC will write next.
+ * The index tag is scanned like any other tag.
+ * When it changed, the driver reads only the new elements
+ * and appends them to 'data'.
+ *
+ * 'data' etc. are protected by the data_lock of the index tag.
+ */
+typedef struct
+{
+    DLL_Node   node;
+    char       *string_tag;        /* ring buffer array tag */
+    ParsedTag  *tag;               /* compiled "tag[0]" */
+    ParsedTag  *element;           /* element node in 'tag' */
+    size_t     size;               /* elements in PLC's ring buffer */
+    TagInfo    *index;             /* index tag */
+    CN_UDINT   next;               /* index of next element to read */
+    eip_bool   have_next;          /* 'next' is valid */
+    size_t     element_size;       /* bytes per element, 0 if not known */
+    CN_USINT   *data;              /* CIP type, then up to 'size' elements */
+    size_t     elements;           /* elements in data */
+    size_t     overruns;           /* count of lost elements */
+    DL_List    callbacks;          /* TagCallbacks for new elements */
+    void       *owner;             /* the one user, e.g. record */
+}   EIPFifo;
+
+/* EIPAggregate:
+ * Minimum, maximum, mean and count of one element of a tag
+ * over all reads within 'interval', accumulated by the scan task
+ * after each read and published once per interval.
+ *
+ * Protected by the data_lock of the tag.
+ */
+typedef struct
+{
+    DLL_Node   node;
+    TagInfo    *tag;
+    size_t     element;            /* array element of tag */
+    double     interval;           /* publish period [secs] */
+    epicsTimeStamp start;          /* of current interval */
+    size_t     count;              /* reads in current interval */
+    double     min, max, sum;      /* of current interval */
+    size_t     pub_count;          /* last published interval, */
+    double     pub_min, pub_max, pub_mean; /* valid if pub_count > 0 */
+    DL_List    callbacks;          /* TagCallbacks for published values */
+}   EIPAggregate;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 extern double drvEtherIP_default_rate;
 
+/* Period for reading the PLC wall clock, 0 to disable */
+extern double drvEtherIP_clock_period;
+
+/* Period for checking the controller for program changes, 0 to disable */
+extern double drvEtherIP_change_period;
+
+/* Refuse to allocate buffers in the scan task, see scan_tag_data */
+extern int drvEtherIP_forbid_scan_alloc;
+
+/* Gather lock statistics? */
+extern int drvEtherIP_lock_stats;
+
+/* Spread the scans of lists with the same period over the period? */
+extern int drvEtherIP_stagger;
+
+/* Scan tasks wake this early for lists in sync groups [secs] */
+extern double drvEtherIP_sync_lead;
+
+/* Reduce transfers when PLC reports missing resources? */
+extern int drvEtherIP_congestion;
+
+/* Also reduce them when a transfer takes longer [secs], 0 to disable */
+extern double drvEtherIP_congestion_latency;
+
+/* Read tags in the same transfer that writes them? */
+extern int drvEtherIP_read_after_write;
+
+extern DrvEtherIP_Private drvEtherIP_private;
+
+/* Locks of the driver, with statistics when drvEtherIP_lock_stats is set.
+ * When not set, it's just the plain lock.
+ */
+#ifdef HAVE_314_API
+epicsMutexLockStatus drvEtherIP_lock(epicsMutexId lock, EIPLockStats *stats,
+                                     EIPLockHold *hold);
+void drvEtherIP_unlock(epicsMutexId lock, EIPLockStats *stats,
+                       EIPLockHold *hold);
+/* Unlock also goes through drvEtherIP_unlock when the lock
+ * was timed, even if statistics have been disabled since.
+ */
+#define EIP_LOCK(M,S,H)   (drvEtherIP_lock_stats ? \
+                           drvEtherIP_lock(M,S,H) : epicsMutexLock(M))
+#define EIP_UNLOCK(M,S,H) ((drvEtherIP_lock_stats || (H)->depth > 0) ? \
+                           drvEtherIP_unlock(M,S,H) : epicsMutexUnlock(M))
+#else
+#define EIP_LOCK(M,S,H)   epicsMutexLock(M)
+#define EIP_UNLOCK(M,S,H) epicsMutexUnlock(M)
+#endif
+#define EIP_lock_driver()   EIP_LOCK(drvEtherIP_private.lock, \
+                                     &drvEtherIP_private.lock_stats, \
+                                     &drvEtherIP_private.lock_hold)
+#define EIP_unlock_driver() EIP_UNLOCK(drvEtherIP_private.lock, \
+                                       &drvEtherIP_private.lock_stats, \
+                                       &drvEtherIP_private.lock_hold)
+#define EIP_lock_PLC(P)     EIP_LOCK((P)->lock, &(P)->lock_stats, \
+                                     &(P)->lock_hold)
+#define EIP_unlock_PLC(P)   EIP_UNLOCK((P)->lock, &(P)->lock_stats, \
+                                       &(P)->lock_hold)
+#define EIP_lock_data(I)    EIP_LOCK((I)->data_lock, (I)->lock_stats, \
+                                     &(I)->lock_hold)
+#define EIP_unlock_data(I)  EIP_UNLOCK((I)->data_lock, (I)->lock_stats, \
+                                       &(I)->lock_hold)
+
+/* Show lock statistics */
+void drvEtherIP_lock_report();
+
 void drvEtherIP_help();
 
 void drvEtherIP_init();
@@ -146,13 +435,46 @@ void drvEtherIP_dump();
 
 void drvEtherIP_reset_statistics();
 
+/* Add sample [secs] to histogram, print histogram */
+void drvEtherIP_histogram_add(EIPHistogram *histo, double secs);
+void drvEtherIP_histogram_report(const char *title, const EIPHistogram *histo);
+/* Estimate time below which the given fraction (0..1) of samples fall */
+double drvEtherIP_histogram_percentile(const EIPHistogram *histo,
+                                       double fraction);
+
+/* Called by input device support with the tag's data locked:
+ * Add delay since tag's update_time to the statistics.
+ * Ignored while the tag has no valid data.
+ */
+void drvEtherIP_add_update_delay(TagInfo *tag, EIPRecordType type);
+
+/* Show percentiles of the update delays */
+void drvEtherIP_delay_report();
+
+eip_bool drvEtherIP_PLC_thread(const char *PLC_name, int priority,
+                               const char *cpus, int lock_memory);
+
+/* Verbosity of the PLC's scan task, -1 for EIP_verbosity */
+eip_bool drvEtherIP_PLC_verbosity(const char *PLC_name, int level);
+
 eip_bool drvEtherIP_define_PLC(const char *PLC_name,
                            const char *ip_addr, int slot);
 
 PLC *drvEtherIP_find_PLC(const char *PLC_name);
 
+/* Define a LINT (or DINT[2]) tag that holds the PLC wall clock
+ * in microseconds since 1970, read along with each transfer
+ * to determine the age of the data.
+ */
+eip_bool drvEtherIP_define_timestamp_tag(const char *PLC_name,
+                                         const char *string_tag);
+
 TagInfo *drvEtherIP_add_tag(PLC *plc, double period,
                             const char *string_tag, size_t elements);
+
+/* Transfer tag before the tags without priority in its list */
+void drvEtherIP_set_priority(PLC *plc, TagInfo *tag);
+
 /* Register callbacks for "received new data" and "finished the write".
  * Note: The data is already locked (data_lock taken)
  * when the callback is called!
@@ -162,8 +484,63 @@ void drvEtherIP_add_callback(PLC *plc, TagInfo *tag,
 void drvEtherIP_remove_callback(PLC *plc, TagInfo *tag,
                                 EIPCallback callback, void *arg);
 
+/* Define FIFO for ring buffer 'string_tag' of 'size' elements
+ * with write index in 'index_tag', which is scanned at 'period'.
+ * Reading a FIFO consumes its elements, so it can only have one
+ * 'owner'. Returns 0 when the FIFO is already used by another owner
+ * or with a different index tag or size.
+ */
+EIPFifo *drvEtherIP_add_fifo(PLC *plc, double period,
+                             const char *string_tag,
+                             const char *index_tag, size_t size,
+                             void *owner);
+/* Register callbacks for "received new elements" */
+void drvEtherIP_add_fifo_callback(PLC *plc, EIPFifo *fifo,
+                                  EIPCallback callback, void *arg);
+void drvEtherIP_remove_fifo_callback(PLC *plc, EIPFifo *fifo,
+                                     EIPCallback callback, void *arg);
+/* Remove the first 'elements' from the FIFO's data.
+ * Index tag's data_lock must be taken.
+ */
+void drvEtherIP_fifo_consume(EIPFifo *fifo, size_t elements);
+/* Given the PLC's write 'index', get the number of elements to read
+ * starting at fifo->next, counting overruns.
+ * Returns false when the index went backwards.
+ * After reading them, drvEtherIP_fifo_advance moves fifo->next.
+ * Used by the scan task, public for tests.
+ */
+eip_bool drvEtherIP_fifo_pending(EIPFifo *fifo, CN_UDINT index,
+                                 CN_UDINT *count);
+void drvEtherIP_fifo_advance(EIPFifo *fifo, CN_UDINT index, CN_UDINT count);
+
+/* Define aggregate for element of tag, published every 'interval' secs */
+EIPAggregate *drvEtherIP_add_aggregate(PLC *plc, TagInfo *tag,
+                                       size_t element, double interval);
+/* Register callbacks for "published new aggregate" */
+void drvEtherIP_add_aggregate_callback(PLC *plc, EIPAggregate *agg,
+                                       EIPCallback callback, void *arg);
+void drvEtherIP_remove_aggregate_callback(PLC *plc, EIPAggregate *agg,
+                                          EIPCallback callback, void *arg);
+
 int drvEtherIP_restart();
 
+/* Live reconfiguration, takes effect at the next turn of the scan task */
+eip_bool drvEtherIP_restart_PLC(const char *PLC_name);
+eip_bool drvEtherIP_scanlist_period(const char *PLC_name, double period,
+                                    double new_period);
+eip_bool drvEtherIP_scanlist_enable(const char *PLC_name, double period,
+                                    int enable);
+/* Set start of scans within the period, <0 for automatic */
+eip_bool drvEtherIP_scanlist_phase(const char *PLC_name, double period,
+                                   double phase);
+/* Add the PLC's scan list for period to sync group,
+ * creating the group on first use.
+ */
+eip_bool drvEtherIP_sync_group(const char *group_name, const char *PLC_name,
+                               double period, double phase);
+eip_bool drvEtherIP_move_tag(const char *PLC_name, const char *string_tag,
+                             double period);
+
 /* Command-line communication test,
  * not used by the driver */
 int drvEtherIP_read_tag(const char *ip_addr,
@@ -172,6 +549,47 @@ int drvEtherIP_read_tag(const char *ip_addr,
                         int elements,
                         int timeout);
 
+/* Save the last known data of all tags of a PLC to a file,
+ * restore it into the PLC and verify.
+ * Return number of tags saved resp. verified, -1 on error.
+ */
+int drvEtherIP_snapshot_save(const char *PLC_name, const char *filename);
+int drvEtherIP_snapshot_restore(const char *PLC_name, const char *filename);
+
+/* Write statistics of all PLCs, scan lists and tags to a file,
+ * format "json" or "prometheus".
+ * drvEtherIP_stats_export does that every 'period' seconds
+ * in a separate thread, period 0 to stop.
+ */
+eip_bool drvEtherIP_stats_write(const char *filename, const char *format);
+#ifdef HAVE_314_API
+eip_bool drvEtherIP_stats_export(const char *filename, const char *format,
+                                 double period);
+#endif
+
+/* Boot timeline: Time spent in each boot phase and per PLC,
+ * from drvEtherIP_init until all PLCs were scanned once.
+ * drvEtherIP_boot_phase adds the time since 'start' to a phase,
+ * drvEtherIP_boot_report prints the timeline, which happens
+ * automatically once all PLCs were scanned,
+ * drvEtherIP_boot_trace writes it as Chrome trace JSON.
+ */
+void drvEtherIP_boot_phase(EIPBootPhase phase, const epicsTimeStamp *start);
+void drvEtherIP_boot_report();
+eip_bool drvEtherIP_boot_trace(const char *filename);
+
+/* Cluster mode: IOCs that share 'directory' divide the PLCs among
+ * themselves, each scanning only the PLCs that it owns.
+ * Every 'period' seconds, each node writes its load and its PLCs to
+ * <directory>/<node>.node and reads the files of the other nodes.
+ * Nodes whose file is older than 'timeout' seconds are considered dead.
+ * Period 0 stops cluster mode, the IOC then scans all its PLCs.
+ */
+#ifdef HAVE_314_API
+eip_bool drvEtherIP_cluster(const char *directory, const char *node,
+                            double period, double timeout);
+#endif
+
 #ifdef HAVE_314_API
 void drvEtherIP_Register();
 #endif
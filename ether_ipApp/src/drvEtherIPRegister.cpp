@@ -21,6 +21,69 @@ static void drvEtherIP_default_rateCall(const iocshArgBuf * args) {
 	drvEtherIP_default_rate = args[0].dval;
 }
 
+static const iocshArg drvEtherIP_clock_periodArg0 = {"seconds", iocshArgDouble};
+static const iocshArg *const drvEtherIP_clock_periodArgs[1] = {&drvEtherIP_clock_periodArg0};
+static const iocshFuncDef drvEtherIP_clock_periodDef = {"drvEtherIP_clock_period", 1, drvEtherIP_clock_periodArgs};
+static void drvEtherIP_clock_periodCall(const iocshArgBuf * args) {
+	drvEtherIP_clock_period = args[0].dval;
+}
+
+static const iocshArg drvEtherIP_change_periodArg0 = {"seconds", iocshArgDouble};
+static const iocshArg *const drvEtherIP_change_periodArgs[1] = {&drvEtherIP_change_periodArg0};
+static const iocshFuncDef drvEtherIP_change_periodDef = {"drvEtherIP_change_period", 1, drvEtherIP_change_periodArgs};
+static void drvEtherIP_change_periodCall(const iocshArgBuf * args) {
+	drvEtherIP_change_period = args[0].dval;
+}
+
+static const iocshArg drvEtherIP_staggerArg0 = {"value", iocshArgInt};
+static const iocshArg *const drvEtherIP_staggerArgs[1] = {&drvEtherIP_staggerArg0};
+static const iocshFuncDef drvEtherIP_staggerDef = {"drvEtherIP_stagger", 1, drvEtherIP_staggerArgs};
+static void drvEtherIP_staggerCall(const iocshArgBuf * args) {
+	drvEtherIP_stagger = args[0].ival;
+}
+
+static const iocshArg drvEtherIP_sync_leadArg0 = {"seconds", iocshArgDouble};
+static const iocshArg *const drvEtherIP_sync_leadArgs[1] = {&drvEtherIP_sync_leadArg0};
+static const iocshFuncDef drvEtherIP_sync_leadDef = {"drvEtherIP_sync_lead", 1, drvEtherIP_sync_leadArgs};
+static void drvEtherIP_sync_leadCall(const iocshArgBuf * args) {
+	drvEtherIP_sync_lead = args[0].dval;
+}
+
+static const iocshArg drvEtherIP_congestionArg0 = {"value", iocshArgInt};
+static const iocshArg *const drvEtherIP_congestionArgs[1] = {&drvEtherIP_congestionArg0};
+static const iocshFuncDef drvEtherIP_congestionDef = {"drvEtherIP_congestion", 1, drvEtherIP_congestionArgs};
+static void drvEtherIP_congestionCall(const iocshArgBuf * args) {
+	drvEtherIP_congestion = args[0].ival;
+}
+
+static const iocshArg drvEtherIP_congestion_latencyArg0 = {"seconds", iocshArgDouble};
+static const iocshArg *const drvEtherIP_congestion_latencyArgs[1] = {&drvEtherIP_congestion_latencyArg0};
+static const iocshFuncDef drvEtherIP_congestion_latencyDef = {"drvEtherIP_congestion_latency", 1, drvEtherIP_congestion_latencyArgs};
+static void drvEtherIP_congestion_latencyCall(const iocshArgBuf * args) {
+	drvEtherIP_congestion_latency = args[0].dval;
+}
+
+static const iocshArg drvEtherIP_read_after_writeArg0 = {"value", iocshArgInt};
+static const iocshArg *const drvEtherIP_read_after_writeArgs[1] = {&drvEtherIP_read_after_writeArg0};
+static const iocshFuncDef drvEtherIP_read_after_writeDef = {"drvEtherIP_read_after_write", 1, drvEtherIP_read_after_writeArgs};
+static void drvEtherIP_read_after_writeCall(const iocshArgBuf * args) {
+	drvEtherIP_read_after_write = args[0].ival;
+}
+
+static const iocshArg drvEtherIP_forbid_scan_allocArg0 = {"value", iocshArgInt};
+static const iocshArg *const drvEtherIP_forbid_scan_allocArgs[1] = {&drvEtherIP_forbid_scan_allocArg0};
+static const iocshFuncDef drvEtherIP_forbid_scan_allocDef = {"drvEtherIP_forbid_scan_alloc", 1, drvEtherIP_forbid_scan_allocArgs};
+static void drvEtherIP_forbid_scan_allocCall(const iocshArgBuf * args) {
+	drvEtherIP_forbid_scan_alloc = args[0].ival;
+}
+
+static const iocshArg drvEtherIP_lock_statsArg0 = {"value", iocshArgInt};
+static const iocshArg *const drvEtherIP_lock_statsArgs[1] = {&drvEtherIP_lock_statsArg0};
+static const iocshFuncDef drvEtherIP_lock_statsDef = {"drvEtherIP_lock_stats", 1, drvEtherIP_lock_statsArgs};
+static void drvEtherIP_lock_statsCall(const iocshArgBuf * args) {
+	drvEtherIP_lock_stats = args[0].ival;
+}
+
 static const iocshArg EIP_verbosityArg0 = {"value", iocshArgInt};
 static const iocshArg *const EIP_verbosityArgs[1] = {&EIP_verbosityArg0};
 static const iocshFuncDef EIP_verbosityDef = {"EIP_verbosity", 1, EIP_verbosityArgs};
@@ -28,6 +91,22 @@ static void EIP_verbosityCall(const iocshArgBuf * args) {
 	EIP_verbosity = args[0].ival;
 }
 
+static const iocshArg EIP_log_subsystemsArg0 = {"mask", iocshArgInt};
+static const iocshArg *const EIP_log_subsystemsArgs[1] = {&EIP_log_subsystemsArg0};
+static const iocshFuncDef EIP_log_subsystemsDef = {"EIP_log_subsystems", 1, EIP_log_subsystemsArgs};
+static void EIP_log_subsystemsCall(const iocshArgBuf * args) {
+	EIP_log_subsystems = args[0].ival;
+}
+
+static const iocshArg drvEtherIP_PLC_verbosityArg0 = {"plc_name", iocshArgString};
+static const iocshArg drvEtherIP_PLC_verbosityArg1 = {"level", iocshArgInt};
+static const iocshArg *const drvEtherIP_PLC_verbosityArgs[2] =
+{&drvEtherIP_PLC_verbosityArg0, &drvEtherIP_PLC_verbosityArg1};
+static const iocshFuncDef drvEtherIP_PLC_verbosityDef = {"drvEtherIP_PLC_verbosity", 2, drvEtherIP_PLC_verbosityArgs};
+static void drvEtherIP_PLC_verbosityCall(const iocshArgBuf * args) {
+	drvEtherIP_PLC_verbosity(args[0].sval, args[1].ival);
+}
+
 static const iocshArg EIP_buffer_limitArg0 = {"bytes", iocshArgInt};
 static const iocshArg *const EIP_buffer_limitArgs[1] = {&EIP_buffer_limitArg0};
 static const iocshFuncDef EIP_buffer_limitDef = {"EIP_buffer_limit", 1, EIP_buffer_limitArgs};
@@ -69,6 +148,18 @@ static void drvEtherIP_reset_statisticsCall(const iocshArgBuf * args) {
 	drvEtherIP_reset_statistics();
 }
 
+static const iocshFuncDef drvEtherIP_delay_reportDef =
+    {"drvEtherIP_delay_report", 0, 0};
+static void drvEtherIP_delay_reportCall(const iocshArgBuf * args) {
+	drvEtherIP_delay_report();
+}
+
+static const iocshFuncDef drvEtherIP_lock_reportDef =
+    {"drvEtherIP_lock_report", 0, 0};
+static void drvEtherIP_lock_reportCall(const iocshArgBuf * args) {
+	drvEtherIP_lock_report();
+}
+
 static const iocshArg drvEtherIP_reportArg0 = {"value", iocshArgInt};
 static const iocshArg *const drvEtherIP_reportArgs[1] = {&drvEtherIP_reportArg0};
 static const iocshFuncDef drvEtherIP_reportDef = {"drvEtherIP_report", 1, drvEtherIP_reportArgs};
@@ -86,6 +177,89 @@ static void drvEtherIP_define_PLCCall(const iocshArgBuf * args) {
 	drvEtherIP_define_PLC(args[0].sval, args[1].sval, args[2].ival);
 }
 
+static const iocshArg drvEtherIP_define_timestamp_tagArg0 = {"plc_name", iocshArgString};
+static const iocshArg drvEtherIP_define_timestamp_tagArg1 = {"tag_name", iocshArgString};
+static const iocshArg * const drvEtherIP_define_timestamp_tagArgs[2] =
+{&drvEtherIP_define_timestamp_tagArg0, &drvEtherIP_define_timestamp_tagArg1};
+static const iocshFuncDef drvEtherIP_define_timestamp_tagDef = {"drvEtherIP_define_timestamp_tag", 2, drvEtherIP_define_timestamp_tagArgs};
+static void drvEtherIP_define_timestamp_tagCall(const iocshArgBuf * args) {
+	drvEtherIP_define_timestamp_tag(args[0].sval, args[1].sval);
+}
+
+static const iocshArg drvEtherIP_PLC_threadArg0 = {"plc_name"   , iocshArgString};
+static const iocshArg drvEtherIP_PLC_threadArg1 = {"priority"   , iocshArgInt   };
+static const iocshArg drvEtherIP_PLC_threadArg2 = {"cpus"       , iocshArgString};
+static const iocshArg drvEtherIP_PLC_threadArg3 = {"lock_memory", iocshArgInt   };
+static const iocshArg * const drvEtherIP_PLC_threadArgs[4] =
+{&drvEtherIP_PLC_threadArg0, &drvEtherIP_PLC_threadArg1,
+ &drvEtherIP_PLC_threadArg2, &drvEtherIP_PLC_threadArg3};
+static const iocshFuncDef drvEtherIP_PLC_threadDef = {"drvEtherIP_PLC_thread", 4, drvEtherIP_PLC_threadArgs};
+static void drvEtherIP_PLC_threadCall(const iocshArgBuf * args) {
+	drvEtherIP_PLC_thread(args[0].sval, args[1].ival, args[2].sval, args[3].ival);
+}
+
+static const iocshArg drvEtherIP_restart_PLCArg0 = {"plc_name", iocshArgString};
+static const iocshArg * const drvEtherIP_restart_PLCArgs[1] = {&drvEtherIP_restart_PLCArg0};
+static const iocshFuncDef drvEtherIP_restart_PLCDef = {"drvEtherIP_restart_PLC", 1, drvEtherIP_restart_PLCArgs};
+static void drvEtherIP_restart_PLCCall(const iocshArgBuf * args) {
+	drvEtherIP_restart_PLC(args[0].sval);
+}
+
+static const iocshArg drvEtherIP_scanlist_periodArg0 = {"plc_name"  , iocshArgString};
+static const iocshArg drvEtherIP_scanlist_periodArg1 = {"period"    , iocshArgDouble};
+static const iocshArg drvEtherIP_scanlist_periodArg2 = {"new_period", iocshArgDouble};
+static const iocshArg * const drvEtherIP_scanlist_periodArgs[3] =
+{&drvEtherIP_scanlist_periodArg0, &drvEtherIP_scanlist_periodArg1,
+ &drvEtherIP_scanlist_periodArg2};
+static const iocshFuncDef drvEtherIP_scanlist_periodDef = {"drvEtherIP_scanlist_period", 3, drvEtherIP_scanlist_periodArgs};
+static void drvEtherIP_scanlist_periodCall(const iocshArgBuf * args) {
+	drvEtherIP_scanlist_period(args[0].sval, args[1].dval, args[2].dval);
+}
+
+static const iocshArg drvEtherIP_scanlist_enableArg0 = {"plc_name", iocshArgString};
+static const iocshArg drvEtherIP_scanlist_enableArg1 = {"period"  , iocshArgDouble};
+static const iocshArg drvEtherIP_scanlist_enableArg2 = {"enable"  , iocshArgInt   };
+static const iocshArg * const drvEtherIP_scanlist_enableArgs[3] =
+{&drvEtherIP_scanlist_enableArg0, &drvEtherIP_scanlist_enableArg1,
+ &drvEtherIP_scanlist_enableArg2};
+static const iocshFuncDef drvEtherIP_scanlist_enableDef = {"drvEtherIP_scanlist_enable", 3, drvEtherIP_scanlist_enableArgs};
+static void drvEtherIP_scanlist_enableCall(const iocshArgBuf * args) {
+	drvEtherIP_scanlist_enable(args[0].sval, args[1].dval, args[2].ival);
+}
+
+static const iocshArg drvEtherIP_scanlist_phaseArg0 = {"plc_name", iocshArgString};
+static const iocshArg drvEtherIP_scanlist_phaseArg1 = {"period"  , iocshArgDouble};
+static const iocshArg drvEtherIP_scanlist_phaseArg2 = {"phase"   , iocshArgDouble};
+static const iocshArg * const drvEtherIP_scanlist_phaseArgs[3] =
+{&drvEtherIP_scanlist_phaseArg0, &drvEtherIP_scanlist_phaseArg1,
+ &drvEtherIP_scanlist_phaseArg2};
+static const iocshFuncDef drvEtherIP_scanlist_phaseDef = {"drvEtherIP_scanlist_phase", 3, drvEtherIP_scanlist_phaseArgs};
+static void drvEtherIP_scanlist_phaseCall(const iocshArgBuf * args) {
+	drvEtherIP_scanlist_phase(args[0].sval, args[1].dval, args[2].dval);
+}
+
+static const iocshArg drvEtherIP_sync_groupArg0 = {"group_name", iocshArgString};
+static const iocshArg drvEtherIP_sync_groupArg1 = {"plc_name"  , iocshArgString};
+static const iocshArg drvEtherIP_sync_groupArg2 = {"period"    , iocshArgDouble};
+static const iocshArg drvEtherIP_sync_groupArg3 = {"phase"     , iocshArgDouble};
+static const iocshArg * const drvEtherIP_sync_groupArgs[4] =
+{&drvEtherIP_sync_groupArg0, &drvEtherIP_sync_groupArg1,
+ &drvEtherIP_sync_groupArg2, &drvEtherIP_sync_groupArg3};
+static const iocshFuncDef drvEtherIP_sync_groupDef = {"drvEtherIP_sync_group", 4, drvEtherIP_sync_groupArgs};
+static void drvEtherIP_sync_groupCall(const iocshArgBuf * args) {
+	drvEtherIP_sync_group(args[0].sval, args[1].sval, args[2].dval, args[3].dval);
+}
+
+static const iocshArg drvEtherIP_move_tagArg0 = {"plc_name", iocshArgString};
+static const iocshArg drvEtherIP_move_tagArg1 = {"tag_name", iocshArgString};
+static const iocshArg drvEtherIP_move_tagArg2 = {"period"  , iocshArgDouble};
+static const iocshArg * const drvEtherIP_move_tagArgs[3] =
+{&drvEtherIP_move_tagArg0, &drvEtherIP_move_tagArg1, &drvEtherIP_move_tagArg2};
+static const iocshFuncDef drvEtherIP_move_tagDef = {"drvEtherIP_move_tag", 3, drvEtherIP_move_tagArgs};
+static void drvEtherIP_move_tagCall(const iocshArgBuf * args) {
+	drvEtherIP_move_tag(args[0].sval, args[1].sval, args[2].dval);
+}
+
 static const iocshArg drvEtherIP_read_tagArg0 = {"ip_addr" , iocshArgString};
 static const iocshArg drvEtherIP_read_tagArg1 = {"slot"    , iocshArgInt   };
 static const iocshArg drvEtherIP_read_tagArg2 = {"tag_name", iocshArgString};
@@ -100,18 +274,98 @@ static void drvEtherIP_read_tagCall(const iocshArgBuf * args) {
                             args[3].ival, args[4].ival);
 }
 
+static const iocshArg drvEtherIP_snapshotArg0 = {"plc_name", iocshArgString};
+static const iocshArg drvEtherIP_snapshotArg1 = {"filename", iocshArgString};
+static const iocshArg * const drvEtherIP_snapshotArgs[2] =
+{&drvEtherIP_snapshotArg0, &drvEtherIP_snapshotArg1};
+static const iocshFuncDef drvEtherIP_snapshot_saveDef = {"drvEtherIP_snapshot_save", 2, drvEtherIP_snapshotArgs};
+static void drvEtherIP_snapshot_saveCall(const iocshArgBuf * args) {
+	drvEtherIP_snapshot_save(args[0].sval, args[1].sval);
+}
+static const iocshFuncDef drvEtherIP_snapshot_restoreDef = {"drvEtherIP_snapshot_restore", 2, drvEtherIP_snapshotArgs};
+static void drvEtherIP_snapshot_restoreCall(const iocshArgBuf * args) {
+	drvEtherIP_snapshot_restore(args[0].sval, args[1].sval);
+}
+
+static const iocshArg drvEtherIP_statsArg0 = {"filename", iocshArgString};
+static const iocshArg drvEtherIP_statsArg1 = {"format", iocshArgString};
+static const iocshArg drvEtherIP_statsArg2 = {"period", iocshArgDouble};
+static const iocshArg * const drvEtherIP_statsArgs[3] =
+{&drvEtherIP_statsArg0, &drvEtherIP_statsArg1, &drvEtherIP_statsArg2};
+static const iocshFuncDef drvEtherIP_stats_writeDef = {"drvEtherIP_stats_write", 2, drvEtherIP_statsArgs};
+static void drvEtherIP_stats_writeCall(const iocshArgBuf * args) {
+	drvEtherIP_stats_write(args[0].sval, args[1].sval);
+}
+static const iocshFuncDef drvEtherIP_stats_exportDef = {"drvEtherIP_stats_export", 3, drvEtherIP_statsArgs};
+static void drvEtherIP_stats_exportCall(const iocshArgBuf * args) {
+	drvEtherIP_stats_export(args[0].sval, args[1].sval, args[2].dval);
+}
+
+static const iocshFuncDef drvEtherIP_boot_reportDef =
+    {"drvEtherIP_boot_report", 0, 0};
+static void drvEtherIP_boot_reportCall(const iocshArgBuf * args) {
+	drvEtherIP_boot_report();
+}
+static const iocshArg drvEtherIP_boot_traceArg0 = {"filename", iocshArgString};
+static const iocshArg * const drvEtherIP_boot_traceArgs[1] = {&drvEtherIP_boot_traceArg0};
+static const iocshFuncDef drvEtherIP_boot_traceDef = {"drvEtherIP_boot_trace", 1, drvEtherIP_boot_traceArgs};
+static void drvEtherIP_boot_traceCall(const iocshArgBuf * args) {
+	drvEtherIP_boot_trace(args[0].sval);
+}
+
+static const iocshArg drvEtherIP_clusterArg0 = {"directory", iocshArgString};
+static const iocshArg drvEtherIP_clusterArg1 = {"node", iocshArgString};
+static const iocshArg drvEtherIP_clusterArg2 = {"period", iocshArgDouble};
+static const iocshArg drvEtherIP_clusterArg3 = {"timeout", iocshArgDouble};
+static const iocshArg * const drvEtherIP_clusterArgs[4] =
+{&drvEtherIP_clusterArg0, &drvEtherIP_clusterArg1,
+ &drvEtherIP_clusterArg2, &drvEtherIP_clusterArg3};
+static const iocshFuncDef drvEtherIP_clusterDef = {"drvEtherIP_cluster", 4, drvEtherIP_clusterArgs};
+static void drvEtherIP_clusterCall(const iocshArgBuf * args) {
+	drvEtherIP_cluster(args[0].sval, args[1].sval,
+                           args[2].dval, args[3].dval);
+}
+
 void drvEtherIP_Register() {
 	iocshRegister(&drvEtherIP_default_rateDef, drvEtherIP_default_rateCall);
+	iocshRegister(&drvEtherIP_clock_periodDef, drvEtherIP_clock_periodCall);
+	iocshRegister(&drvEtherIP_change_periodDef, drvEtherIP_change_periodCall);
+	iocshRegister(&drvEtherIP_forbid_scan_allocDef, drvEtherIP_forbid_scan_allocCall);
+	iocshRegister(&drvEtherIP_staggerDef, drvEtherIP_staggerCall);
+	iocshRegister(&drvEtherIP_sync_leadDef, drvEtherIP_sync_leadCall);
+	iocshRegister(&drvEtherIP_congestionDef, drvEtherIP_congestionCall);
+	iocshRegister(&drvEtherIP_congestion_latencyDef, drvEtherIP_congestion_latencyCall);
+	iocshRegister(&drvEtherIP_read_after_writeDef, drvEtherIP_read_after_writeCall);
 	iocshRegister(&EIP_verbosityDef        , EIP_verbosityCall);
+	iocshRegister(&EIP_log_subsystemsDef  , EIP_log_subsystemsCall);
+	iocshRegister(&drvEtherIP_PLC_verbosityDef, drvEtherIP_PLC_verbosityCall);
 	iocshRegister(&EIP_buffer_limitDef     , EIP_buffer_limitCall);
 	iocshRegister(&drvEtherIP_helpDef      , drvEtherIP_helpCall);
 	iocshRegister(&drvEtherIP_initDef      , drvEtherIP_initCall);
 	iocshRegister(&drvEtherIP_restartDef   , drvEtherIP_restartCall);
 	iocshRegister(&drvEtherIP_dumpDef      , drvEtherIP_dumpCall);
 	iocshRegister(&drvEtherIP_reset_statisticsDef, drvEtherIP_reset_statisticsCall);
+	iocshRegister(&drvEtherIP_delay_reportDef, drvEtherIP_delay_reportCall);
+	iocshRegister(&drvEtherIP_lock_statsDef, drvEtherIP_lock_statsCall);
+	iocshRegister(&drvEtherIP_lock_reportDef, drvEtherIP_lock_reportCall);
 	iocshRegister(&drvEtherIP_reportDef    , drvEtherIP_reportCall);
 	iocshRegister(&drvEtherIP_define_PLCDef, drvEtherIP_define_PLCCall);
+	iocshRegister(&drvEtherIP_define_timestamp_tagDef, drvEtherIP_define_timestamp_tagCall);
+	iocshRegister(&drvEtherIP_PLC_threadDef, drvEtherIP_PLC_threadCall);
+	iocshRegister(&drvEtherIP_restart_PLCDef, drvEtherIP_restart_PLCCall);
+	iocshRegister(&drvEtherIP_scanlist_periodDef, drvEtherIP_scanlist_periodCall);
+	iocshRegister(&drvEtherIP_scanlist_enableDef, drvEtherIP_scanlist_enableCall);
+	iocshRegister(&drvEtherIP_scanlist_phaseDef, drvEtherIP_scanlist_phaseCall);
+	iocshRegister(&drvEtherIP_sync_groupDef, drvEtherIP_sync_groupCall);
+	iocshRegister(&drvEtherIP_move_tagDef, drvEtherIP_move_tagCall);
 	iocshRegister(&drvEtherIP_read_tagDef  , drvEtherIP_read_tagCall);
+	iocshRegister(&drvEtherIP_snapshot_saveDef, drvEtherIP_snapshot_saveCall);
+	iocshRegister(&drvEtherIP_snapshot_restoreDef, drvEtherIP_snapshot_restoreCall);
+	iocshRegister(&drvEtherIP_stats_writeDef, drvEtherIP_stats_writeCall);
+	iocshRegister(&drvEtherIP_stats_exportDef, drvEtherIP_stats_exportCall);
+	iocshRegister(&drvEtherIP_boot_reportDef, drvEtherIP_boot_reportCall);
+	iocshRegister(&drvEtherIP_boot_traceDef, drvEtherIP_boot_traceCall);
+	iocshRegister(&drvEtherIP_clusterDef, drvEtherIP_clusterCall);
 }
 #ifdef __cplusplus
 }
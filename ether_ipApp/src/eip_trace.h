@@ -0,0 +1,38 @@
+/* eip_trace.h
+ *
+ * Static trace points ("USDT" probes) for perf, bpftrace, SystemTap.
+ *
+ * When compiled with EIP_USE_SDT on Linux, each EIP_TRACEn() becomes
+ * a 'nop' instruction plus a note in the ELF file that describes
+ * the probe and where to find its arguments.
+ * A tracer that attaches replaces the 'nop', otherwise there is no cost.
+ * Without EIP_USE_SDT, the probes compile to nothing.
+ *
+ * Requires <sys/sdt.h>, for example from the systemtap-sdt-devel
+ * or systemtap-sdt-dev package.
+ * Enable in the Makefile via
+ *     USR_CFLAGS += -DEIP_USE_SDT
+ *
+ * All probes use the provider name "ether_ip".
+ * Arguments should be integers or pointers, strings are passed
+ * as 'const char *' and read by the tracer via str(argN).
+ */
+#ifndef EIP_TRACE_H
+#define EIP_TRACE_H
+
+#if defined(EIP_USE_SDT) && defined(__linux__)
+#include <sys/sdt.h>
+#define EIP_TRACE0(name)             DTRACE_PROBE(ether_ip, name)
+#define EIP_TRACE1(name,a)           DTRACE_PROBE1(ether_ip, name, a)
+#define EIP_TRACE2(name,a,b)         DTRACE_PROBE2(ether_ip, name, a, b)
+#define EIP_TRACE3(name,a,b,c)       DTRACE_PROBE3(ether_ip, name, a, b, c)
+#define EIP_TRACE4(name,a,b,c,d)     DTRACE_PROBE4(ether_ip, name, a, b, c, d)
+#else
+#define EIP_TRACE0(name)             do {} while (0)
+#define EIP_TRACE1(name,a)           do {} while (0)
+#define EIP_TRACE2(name,a,b)         do {} while (0)
+#define EIP_TRACE3(name,a,b,c)       do {} while (0)
+#define EIP_TRACE4(name,a,b,c,d)     do {} while (0)
+#endif
+
+#endif
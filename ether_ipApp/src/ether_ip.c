@@ -13,6 +13,9 @@
  * kasemir@lanl.gov
  */
 
+/* Subsystem for EIP_printf, switched to transport for the connection */
+#define EIP_LOG_SUBSYSTEM EIP_LOG_CODEC
+
 /* System */
 #include<stdio.h>
 #include<stdarg.h>
@@ -26,6 +29,7 @@
 
 /* EPICS */
 #include<epicsTime.h>
+#include<epicsThread.h>
 #include<osiSock.h>
 
 /* Local */
@@ -33,8 +37,52 @@
 
 int EIP_buffer_limit =  EIP_DEFAULT_BUFFER_LIMIT;
 
-static const CN_UINT __endian_test = 0x0001;
-#define is_little_endian (*((const CN_USINT*)&__endian_test))
+/* Typed access to little endian buffer, independent of host byte order.
+ * Compilers turn these into plain loads on little endian hosts,
+ * and into byte-reversed loads (PowerPC lhbrx/lwbrx) or bswaps
+ * on big endian hosts.
+ */
+#define CN_get_UINT(p)  ((CN_UINT)((p)[0] | ((p)[1]<<8)))
+#define CN_get_UDINT(p) ( (CN_UDINT)(p)[0]        | \
+                         ((CN_UDINT)(p)[1] <<  8) | \
+                         ((CN_UDINT)(p)[2] << 16) | \
+                         ((CN_UDINT)(p)[3] << 24))
+
+/* REAL uses the same byte order as UDINT on all supported hosts */
+typedef union
+{
+    CN_UDINT u;
+    CN_REAL  r;
+}   CN_REAL_bits;
+
+static CN_REAL CN_get_REAL(const CN_USINT *p)
+{
+    CN_REAL_bits bits;
+    bits.u = CN_get_UDINT(p);
+    return bits.r;
+}
+
+#define CN_put_UINT(p, v)                      \
+    do {                                        \
+        CN_UINT _v = (v);                       \
+        (p)[0] = (CN_USINT) (_v & 0xFF);        \
+        (p)[1] = (CN_USINT) (_v >> 8);          \
+    } while (0)
+#define CN_put_UDINT(p, v)                     \
+    do {                                        \
+        CN_UDINT _v = (v);                      \
+        (p)[0] = (CN_USINT) (_v & 0xFF);        \
+        (p)[1] = (CN_USINT) ((_v >>  8) & 0xFF);\
+        (p)[2] = (CN_USINT) ((_v >> 16) & 0xFF);\
+        (p)[3] = (CN_USINT) (_v >> 24);         \
+    } while (0)
+
+static void CN_put_REAL(CN_USINT *p, CN_REAL val)
+{
+    CN_REAL_bits bits;
+    bits.r = val;
+    CN_put_UDINT(p, bits.u);
+}
 
 /** Perform some size checks to assert that the protocol can "work" */
 static void check_sizes()
@@ -54,18 +102,15 @@ static void check_sizes()
 
 /* Pack binary data in ControlNet format (little endian)
  *
- * "pack" and "unpack" are modeled after the suggestions
+ * "pack" and "unpack" were modeled after the suggestions
  * in Kerningham/Pike's "Practice of Programming", taking a format argument
- * and a variable list of values:
- *    s   - CN_SINT
- *    i   - CN_INT
- *    d   - CN_DINT
- *    r   - CN_REAL
+ * and a variable list of values.
  *
  * But that didn't work on vxWorks:
  * I couldn't pass CN_USINT for pack(), va_arg (ap, CN_USINT) always took
  * more than one byte from the stack -> one pack_XXX per data type XXX.
- * The unpack seems to work because all var-args are pointer-sized.
+ * The format-parsing unpack was replaced by direct unpack_XXX calls
+ * because it was used for every received message.
  */
 CN_USINT *pack_USINT(CN_USINT *buffer, CN_USINT val)
 {
@@ -75,164 +120,123 @@ CN_USINT *pack_USINT(CN_USINT *buffer, CN_USINT val)
 
 CN_USINT *pack_UINT(CN_USINT *buffer, CN_UINT val)
 {
-    *buffer++ =  val & 0x00FF;
-    *buffer++ = (val & 0xFF00) >> 8;
-    return buffer;
+    CN_put_UINT(buffer, val);
+    return buffer + 2;
 }
 
 CN_USINT *pack_UDINT(CN_USINT *buffer, CN_UDINT val)
 {
-    *buffer++ =  val & 0x000000FF;
-    *buffer++ = (val & 0x0000FF00) >> 8;
-    *buffer++ = (val & 0x00FF0000) >> 16;
-    *buffer++ = (val & 0xFF000000) >> 24;
-    return buffer;
+    CN_put_UDINT(buffer, val);
+    return buffer + 4;
 }
 
 CN_USINT *pack_REAL(CN_USINT *buffer, CN_REAL val)
 {
-    const CN_USINT *p;
-
-    if (is_little_endian)
-    {
-        p = (const CN_USINT *) &val;
-        *buffer++ = *p++;
-        *buffer++ = *p++;
-        *buffer++ = *p++;
-        *buffer++ = *p;
-    }
-    else
-    {
-        p = ((const CN_USINT *) &val)+3;
-        *buffer++ = *p--;
-        *buffer++ = *p--;
-        *buffer++ = *p--;
-        *buffer++ = *p;
-    }
-    return buffer;
+    CN_put_REAL(buffer, val);
+    return buffer + 4;
 }
 
 const CN_USINT *unpack_UINT(const CN_USINT *buffer, CN_UINT *val)
 {
-    *val =  buffer[0]
-         | (buffer[1]<<8);
+    *val = CN_get_UINT(buffer);
     return buffer + 2;
 }
 
 const CN_USINT *unpack_UDINT(const CN_USINT *buffer, CN_UDINT *val)
 {
-    *val =  buffer[0]
-         | (buffer[1]<< 8)
-         | (buffer[2]<<16)
-         | (buffer[3]<<24);
+    *val = CN_get_UDINT(buffer);
     return buffer + 4;
 }
 
 const CN_USINT *unpack_REAL(const CN_USINT *buffer, CN_REAL *val)
 {
-    CN_USINT *p;
-    if (is_little_endian)
-    {
-        p = (CN_USINT *) val;
-        *p++ = *buffer++;
-        *p++ = *buffer++;
-        *p++ = *buffer++;
-        *p   = *buffer++;
-    }
-    else
-    {
-        p = ((CN_USINT *) val)+3;
-        *p-- = *buffer++;
-        *p-- = *buffer++;
-        *p-- = *buffer++;
-        *p   = *buffer++;
-    }
-    return buffer;
+    *val = CN_get_REAL(buffer);
+    return buffer + 4;
 }
 
-/* Format: like pack, but uppercase characters
- * are skipped in buffer, no result is assigned
- */
-static const CN_USINT *unpack(const CN_USINT *buffer, const char *format, ...)
+int EIP_verbosity = 4;
+int EIP_log_subsystems = EIP_LOG_ALL;
+int EIP_log_max_verbosity = -1;
+eip_bool EIP_use_mem_string_file=0;
+
+/* Per-thread verbosity, stored as level+1 so that 0 means 'not set' */
+static epicsThreadOnceId    log_once = EPICS_THREAD_ONCE_INIT;
+static epicsThreadPrivateId log_thread_verbosity = 0;
+
+static void create_log_thread_verbosity(void *unused)
 {
-    va_list  ap;
-    CN_USINT *vs;
-    CN_UINT  *vi;
-    CN_UDINT *vd;
-    CN_REAL  *vr;
+    log_thread_verbosity = epicsThreadPrivateCreate();
+}
 
-    va_start(ap, format);
-    while (*format)
-    {
-        switch (*format)
-        {
-            case 's':
-                vs = va_arg(ap, CN_USINT *);
-                *vs = *buffer;
-                /* drop */
-            case 'S':
-                ++buffer;
-                break;
-            case 'i':
-                vi = va_arg(ap, CN_UINT *);
-                buffer = unpack_UINT(buffer, vi);
-                break;
-            case 'I':
-                buffer += 2;
-                break;
-            case 'd':
-                vd = va_arg(ap, CN_UDINT *);
-                buffer = unpack_UDINT(buffer, vd);
-                break;
-            case 'D':
-                buffer += 4;
-                break;
-            case 'r':
-                vr = va_arg(ap, CN_REAL *);
-                buffer = unpack_REAL(buffer, vr);
-                break;
-            case 'R':
-                buffer += 4;
-                break;
-            default:
-                va_end(ap);
-                return 0;
-        }
-        ++format;
-    }
-    va_end(ap);
+void EIP_log_thread_verbosity(int level)
+{
+    epicsThreadOnce(&log_once, create_log_thread_verbosity, 0);
+    if (log_thread_verbosity)
+        epicsThreadPrivateSet(log_thread_verbosity,
+                              (void *)(size_t)(level < 0 ? 0 : level+1));
+}
 
-    return buffer;
+eip_bool EIP_log_enabled(int subsystem, int level)
+{
+    size_t thread_level = 0;
+
+    if (! (subsystem & EIP_log_subsystems))
+        return false;
+    if (log_thread_verbosity)
+        thread_level = (size_t)epicsThreadPrivateGet(log_thread_verbosity);
+    if (thread_level > 0)
+        return level < (int)thread_level;
+    return level <= EIP_verbosity;
 }
 
-int EIP_verbosity = 4;
-eip_bool EIP_use_mem_string_file=0;
+static void print_time_stamp(void)
+{
+	epicsTimeStamp now;
+    char  tsString[50];
 
-void EIP_printf(int level, const char *format, ...)
+    epicsTimeGetCurrent(&now);
+    epicsTimeToStrftime(tsString, sizeof(tsString),
+                        "%Y/%m/%d %H:%M:%S.%04f", &now);
+    fprintf(stderr, "%s ", tsString);
+}
+
+void EIP_log_printf(const char *format, ...)
 {
     va_list ap;
-    if (level > EIP_verbosity)
-        return;
     va_start(ap, format);
 	vfprintf(stderr, format, ap);
     va_end(ap);
 }
 
+void EIP_log_printf_time(const char *format, ...)
+{
+    va_list ap;
+
+    print_time_stamp();
+    va_start(ap, format);
+	vfprintf(stderr, format, ap);
+    va_end(ap);
+}
 
-void EIP_printf_time(int level, const char *format, ...)
+/* Function versions of the EIP_printf macros,
+ * names in parentheses to keep the macros from expanding
+ */
+void (EIP_printf)(int level, const char *format, ...)
 {
-	epicsTimeStamp now;
-    char  tsString[50];
     va_list ap;
-    if (level > EIP_verbosity)
+    if (! EIP_log_on(EIP_LOG_ALL, level))
         return;
+    va_start(ap, format);
+	vfprintf(stderr, format, ap);
+    va_end(ap);
+}
 
-    /* Time stamp */
-    epicsTimeGetCurrent(&now);
-    epicsTimeToStrftime(tsString, sizeof(tsString),
-                        "%Y/%m/%d %H:%M:%S.%04f", &now);
-    fprintf(stderr, "%s ", tsString);
-    /* Message */
+void (EIP_printf_time)(int level, const char *format, ...)
+{
+    va_list ap;
+    if (! EIP_log_on(EIP_LOG_ALL, level))
+        return;
+    print_time_stamp();
     va_start(ap, format);
 	vfprintf(stderr, format, ap);
     va_end(ap);
@@ -244,7 +248,8 @@ void EIP_hexdump(int level, const void *_data, int len)
     int offset = 0;
     int i;
 
-    if (level > EIP_verbosity)
+    /* Callers check their subsystem */
+    if (! EIP_log_on(EIP_LOG_ALL, level))
         return;
 
 #define NUM 16
@@ -284,6 +289,7 @@ static const char *EIP_class_name(CN_Classes c)
     case C_Identity:            return "Identity";
     case C_MessageRouter:       return "MessageRouter";
     case C_ConnectionManager:   return "ConnectionManager";
+    case C_WallClockTime:       return "WallClockTime";
     default:                    return "<unknown>";
     }
 }
@@ -800,7 +806,7 @@ static eip_bool is_raw_MRResponse_ok(const CN_USINT *response,
     if (general_status == 0)
         return true;
 
-    if (EIP_verbosity >= 2)
+    if (EIP_verbose(2))
         EIP_dump_raw_MR_Response(response, response_size);
 
     return false;
@@ -909,6 +915,7 @@ size_t CIP_Type_size(CIP_Type type)
         case T_CIP_SINT:  return sizeof(CN_USINT);
         case T_CIP_INT:   return sizeof(CN_UINT);
         case T_CIP_DINT:  return sizeof(CN_DINT);
+        case T_CIP_LINT:  return 2*sizeof(CN_UDINT);
         case T_CIP_REAL:  return sizeof(CN_REAL);
         case T_CIP_BITS:  return sizeof(CN_UDINT);
         default:
@@ -934,7 +941,7 @@ CN_USINT *make_CIP_ReadData(CN_USINT *request,
     CN_USINT *buf = make_MR_Request(request, S_CIP_ReadData,
                                     tag_path_size(tag));
     buf = make_tag_path(buf, tag);
-    if (EIP_verbosity >= 10)
+    if (EIP_verbose(10))
     {
         char buffer[EIP_MAX_TAG_LENGTH];
         EIP_copy_ParsedTag(buffer, tag);
@@ -1038,36 +1045,24 @@ void dump_raw_CIP_data(const CN_USINT *raw_type_and_data, size_t elements)
 eip_bool get_CIP_double(const CN_USINT *raw_type_and_data,
                     size_t element, double *result)
 {
-    CN_UINT        type;
-    const CN_USINT *buf;
-    CN_USINT       vs;
-    CN_UINT        vi;
-    CN_UDINT       vd;
-    CN_REAL        vr;
+    CN_UINT        type = CN_get_UINT(raw_type_and_data);
+    const CN_USINT *buf = raw_type_and_data + CIP_Typecode_size;
 
-    buf = unpack_UINT (raw_type_and_data, &type);
-    /* buf now on first, skip to given element */
-    if (element > 0)
-        buf += element*CIP_Type_size(type);
     switch (type)
     {
         case T_CIP_BOOL:
         case T_CIP_SINT:
-            vs = *(buf++);
-            *result = (double) vs;
+            *result = (double) buf[element];
             return true;
         case T_CIP_INT:
-            unpack_UINT(buf, &vi);
-            *result = (double) vi;
+            *result = (double) CN_get_UINT(buf + 2*element);
             return true;
         case T_CIP_DINT:
         case T_CIP_BITS:
-            unpack_UDINT(buf, &vd);
-            *result = (double) vd;
+            *result = (double) CN_get_UDINT(buf + 4*element);
             return true;
         case T_CIP_REAL:
-            unpack_REAL(buf, &vr);
-            *result = (double) vr;
+            *result = (double) CN_get_REAL(buf + 4*element);
             return true;
     }
     EIP_printf(1, "EIP get_CIP_double: unknown type %d\n", (int) type);
@@ -1077,32 +1072,24 @@ eip_bool get_CIP_double(const CN_USINT *raw_type_and_data,
 eip_bool get_CIP_UDINT(const CN_USINT *raw_type_and_data,
                        size_t element, CN_UDINT *result)
 {
-    CN_UINT        type;
-    const CN_USINT *buf;
-    CN_USINT       vs;
-    CN_UINT        vi;
-    CN_REAL        vr;
+    CN_UINT        type = CN_get_UINT(raw_type_and_data);
+    const CN_USINT *buf = raw_type_and_data + CIP_Typecode_size;
 
-    buf = unpack_UINT(raw_type_and_data, &type);
-    buf += element*CIP_Type_size(type);
     switch (type)
     {
         case T_CIP_BOOL:
         case T_CIP_SINT:
-            vs = *buf;
-            *result = (CN_UDINT) vs;
+            *result = (CN_UDINT) buf[element];
             return true;
         case T_CIP_INT:
-            unpack_UINT(buf, &vi);
-            *result = (CN_UDINT) vi;
+            *result = (CN_UDINT) CN_get_UINT(buf + 2*element);
             return true;
         case T_CIP_DINT:
         case T_CIP_BITS:
-            unpack_UDINT(buf, result);
+            *result = CN_get_UDINT(buf + 4*element);
             return true;
         case T_CIP_REAL:
-            unpack_REAL(buf, &vr);
-            *result = (CN_UDINT) vr;
+            *result = (CN_UDINT) CN_get_REAL(buf + 4*element);
             return true;
     }
     EIP_printf(1, "EIP get_CIP_UDINT: unknown type %d\n", (int) type);
@@ -1112,32 +1099,24 @@ eip_bool get_CIP_UDINT(const CN_USINT *raw_type_and_data,
 eip_bool get_CIP_DINT(const CN_USINT *raw_type_and_data,
                       size_t element, CN_DINT *result)
 {
-    CN_UINT        type;
-    const CN_USINT *buf;
-    CN_USINT       vs;
-    CN_INT         vi;
-    CN_REAL        vr;
+    CN_UINT        type = CN_get_UINT(raw_type_and_data);
+    const CN_USINT *buf = raw_type_and_data + CIP_Typecode_size;
 
-    buf = unpack_UINT(raw_type_and_data, &type);
-    buf += element*CIP_Type_size(type);
     switch (type)
     {
         case T_CIP_BOOL:
         case T_CIP_SINT:
-            vs = *buf;
-            *result = (CN_DINT) vs;
+            *result = (CN_DINT) buf[element];
             return true;
         case T_CIP_INT:
-            unpack_UINT(buf, (CN_UINT *)&vi);
-            *result = (CN_DINT) vi;
+            *result = (CN_DINT) (CN_INT) CN_get_UINT(buf + 2*element);
             return true;
         case T_CIP_DINT:
         case T_CIP_BITS:
-            unpack_UDINT(buf, (CN_UDINT *)result);
+            *result = (CN_DINT) CN_get_UDINT(buf + 4*element);
             return true;
         case T_CIP_REAL:
-            unpack_REAL(buf, &vr);
-            *result = (CN_DINT) vr;
+            *result = (CN_DINT) CN_get_REAL(buf + 4*element);
             return true;
     }
     EIP_printf(1, "EIP get_CIP_UDINT: unknown type %d\n", (int) type);
@@ -1147,24 +1126,128 @@ eip_bool get_CIP_DINT(const CN_USINT *raw_type_and_data,
 eip_bool get_CIP_USINT(const CN_USINT *raw_type_and_data,
                        size_t element, CN_USINT *result)
 {
-    CN_UINT        type;
-    const CN_USINT *buf;
-    CN_USINT       vs;
+    CN_UINT        type = CN_get_UINT(raw_type_and_data);
 
-    buf = unpack_UINT(raw_type_and_data, &type);
-    buf += element*CIP_Type_size(type);
     switch (type)
     {
         case T_CIP_BOOL:
         case T_CIP_SINT:
-            vs = *buf;
-            *result = (CN_UDINT) vs;
+            *result = raw_type_and_data[CIP_Typecode_size + element];
             return true;
     }
     EIP_printf(1, "EIP get_CIP_USINT: cannot handle type %d\n", (int) type);
     return false;
 }
 
+/* Array versions: The type is checked once,
+ * then a loop specific to the type converts all elements.
+ */
+eip_bool get_CIP_double_array(const CN_USINT *raw_type_and_data,
+                              size_t element, size_t count, double *result)
+{
+    CN_UINT        type = CN_get_UINT(raw_type_and_data);
+    const CN_USINT *buf = raw_type_and_data + CIP_Typecode_size;
+    size_t         i;
+
+    switch (type)
+    {
+        case T_CIP_BOOL:
+        case T_CIP_SINT:
+            buf += element;
+            for (i=0; i<count; ++i)
+                result[i] = (double) buf[i];
+            return true;
+        case T_CIP_INT:
+            buf += 2*element;
+            for (i=0; i<count; ++i, buf+=2)
+                result[i] = (double) CN_get_UINT(buf);
+            return true;
+        case T_CIP_DINT:
+        case T_CIP_BITS:
+            buf += 4*element;
+            for (i=0; i<count; ++i, buf+=4)
+                result[i] = (double) CN_get_UDINT(buf);
+            return true;
+        case T_CIP_REAL:
+            buf += 4*element;
+            for (i=0; i<count; ++i, buf+=4)
+                result[i] = (double) CN_get_REAL(buf);
+            return true;
+    }
+    EIP_printf(1, "EIP get_CIP_double_array: unknown type %d\n", (int) type);
+    return false;
+}
+
+eip_bool get_CIP_DINT_array(const CN_USINT *raw_type_and_data,
+                            size_t element, size_t count, CN_DINT *result)
+{
+    CN_UINT        type = CN_get_UINT(raw_type_and_data);
+    const CN_USINT *buf = raw_type_and_data + CIP_Typecode_size;
+    size_t         i;
+
+    switch (type)
+    {
+        case T_CIP_BOOL:
+        case T_CIP_SINT:
+            buf += element;
+            for (i=0; i<count; ++i)
+                result[i] = (CN_DINT) buf[i];
+            return true;
+        case T_CIP_INT:
+            buf += 2*element;
+            for (i=0; i<count; ++i, buf+=2)
+                result[i] = (CN_DINT) (CN_INT) CN_get_UINT(buf);
+            return true;
+        case T_CIP_DINT:
+        case T_CIP_BITS:
+            buf += 4*element;
+            for (i=0; i<count; ++i, buf+=4)
+                result[i] = (CN_DINT) CN_get_UDINT(buf);
+            return true;
+        case T_CIP_REAL:
+            buf += 4*element;
+            for (i=0; i<count; ++i, buf+=4)
+                result[i] = (CN_DINT) CN_get_REAL(buf);
+            return true;
+    }
+    EIP_printf(1, "EIP get_CIP_DINT_array: unknown type %d\n", (int) type);
+    return false;
+}
+
+eip_bool get_CIP_USINT_array(const CN_USINT *raw_type_and_data,
+                             size_t element, size_t count, CN_USINT *result)
+{
+    CN_UINT        type = CN_get_UINT(raw_type_and_data);
+
+    switch (type)
+    {
+        case T_CIP_BOOL:
+        case T_CIP_SINT:
+            memcpy(result, raw_type_and_data + CIP_Typecode_size + element,
+                   count);
+            return true;
+    }
+    EIP_printf(1, "EIP get_CIP_USINT_array: cannot handle type %d\n",
+               (int) type);
+    return false;
+}
+
+eip_bool get_CIP_LINT_double(const CN_USINT *raw_type_and_data,
+                             double *result)
+{
+    CN_UINT        type = CN_get_UINT(raw_type_and_data);
+    const CN_USINT *buf = raw_type_and_data + CIP_Typecode_size;
+
+    if (type != T_CIP_LINT  &&  type != T_CIP_DINT)
+    {
+        EIP_printf(1, "EIP get_CIP_LINT_double: unknown type %d\n", (int) type);
+        return false;
+    }
+    *result = (double)CN_get_UDINT(buf+4) * 4294967296.0
+            + (double)CN_get_UDINT(buf);
+    return true;
+}
+
 /* Fill buffer with up to 'size' characters (incl. ending '\0').
  * Return true for success */
 eip_bool get_CIP_STRING(const CN_USINT *raw_type_and_data,
@@ -1200,28 +1283,24 @@ eip_bool get_CIP_STRING(const CN_USINT *raw_type_and_data,
 eip_bool put_CIP_double(const CN_USINT *raw_type_and_data,
                     size_t element, double value)
 {
-    CN_UINT   type;
-    CN_USINT *buf;
+    CN_UINT  type = CN_get_UINT(raw_type_and_data);
+    CN_USINT *buf = (CN_USINT *) raw_type_and_data + CIP_Typecode_size;
 
-    buf = (CN_USINT *) unpack_UINT(raw_type_and_data, &type);
-    /* buf now on first, skip to given element */
-    if (element > 0)
-        buf += element*CIP_Type_size(type);
     switch (type)
     {
         case T_CIP_BOOL:
         case T_CIP_SINT:
-            pack_USINT(buf, (CN_USINT) value);
+            buf[element] = (CN_USINT) value;
             return true;
         case T_CIP_INT:
-            pack_UINT(buf, (CN_INT) value);
+            CN_put_UINT(buf + 2*element, (CN_INT) value);
             return true;
         case T_CIP_DINT:
         case T_CIP_BITS:
-            pack_UDINT(buf, (CN_DINT) value);
+            CN_put_UDINT(buf + 4*element, (CN_DINT) value);
             return true;
         case T_CIP_REAL:
-            pack_REAL(buf, (CN_REAL) value);
+            CN_put_REAL(buf + 4*element, (CN_REAL) value);
             return true;
     }
     EIP_printf(1, "EIP put_CIP_double: unknown type %d\n", (int) type);
@@ -1231,28 +1310,24 @@ eip_bool put_CIP_double(const CN_USINT *raw_type_and_data,
 eip_bool put_CIP_UDINT(const CN_USINT *raw_type_and_data,
                    size_t element, CN_UDINT value)
 {
-    CN_UINT   type;
-    CN_USINT *buf;
+    CN_UINT  type = CN_get_UINT(raw_type_and_data);
+    CN_USINT *buf = (CN_USINT *) raw_type_and_data + CIP_Typecode_size;
 
-    buf = (CN_USINT *) unpack_UINT(raw_type_and_data, &type);
-    /* buf now on first, skip to given element */
-    if (element > 0)
-        buf += element*CIP_Type_size(type);
     switch (type)
     {
         case T_CIP_BOOL:
         case T_CIP_SINT:
-            pack_USINT(buf, (CN_USINT) value);
+            buf[element] = (CN_USINT) value;
             return true;
         case T_CIP_INT:
-            pack_UINT(buf, (CN_UINT) value);
+            CN_put_UINT(buf + 2*element, (CN_UINT) value);
             return true;
         case T_CIP_DINT:
         case T_CIP_BITS:
-            pack_UDINT(buf, value);
+            CN_put_UDINT(buf + 4*element, value);
             return true;
         case T_CIP_REAL:
-            pack_REAL(buf, (CN_REAL) value);
+            CN_put_REAL(buf + 4*element, (CN_REAL) value);
             return true;
     }
     EIP_printf(1, "EIP put_CIP_UDINT: unknown type %d\n", (int) type);
@@ -1262,32 +1337,24 @@ eip_bool put_CIP_UDINT(const CN_USINT *raw_type_and_data,
 eip_bool put_CIP_DINT(const CN_USINT *raw_type_and_data,
                   size_t element, CN_DINT value)
 {
-    CN_UINT   type;
-    CN_USINT *buf;
-    CN_SINT   vs;
-    CN_INT    vi;
+    CN_UINT  type = CN_get_UINT(raw_type_and_data);
+    CN_USINT *buf = (CN_USINT *) raw_type_and_data + CIP_Typecode_size;
 
-    buf = (CN_USINT *) unpack_UINT(raw_type_and_data, &type);
-    /* buf now on first, skip to given element */
-    if (element > 0)
-        buf += element*CIP_Type_size(type);
     switch (type)
     {
         case T_CIP_BOOL:
         case T_CIP_SINT:
-            vs = value;
-            pack_USINT(buf, *((CN_USINT*)&vs));
+            buf[element] = (CN_USINT) (CN_SINT) value;
             return true;
         case T_CIP_INT:
-            vi = value;
-            pack_UINT(buf, *((CN_UINT*)&vi));
+            CN_put_UINT(buf + 2*element, (CN_UINT) (CN_INT) value);
             return true;
         case T_CIP_DINT:
         case T_CIP_BITS:
-            pack_UDINT(buf, *((CN_UDINT*)&value));
+            CN_put_UDINT(buf + 4*element, (CN_UDINT) value);
             return true;
         case T_CIP_REAL:
-            pack_REAL(buf, (CN_REAL) value);
+            CN_put_REAL(buf + 4*element, (CN_REAL) value);
             return true;
     }
     EIP_printf(1, "EIP put_CIP_DINT: unknown type %d\n", (int) type);
@@ -1313,7 +1380,7 @@ const CN_USINT *check_CIP_ReadData_Response(const CN_USINT *response,
  *   CN_UINT    elements;         // number of array elements
  *   CN_???     data;
  */
-static size_t CIP_WriteData_size (const ParsedTag *tag, size_t data_size)
+size_t CIP_WriteData_size (const ParsedTag *tag, size_t data_size)
 {
     return   2
            + 2 * tag_path_size (tag) /* IOI path is in words */
@@ -1336,7 +1403,7 @@ CN_USINT *make_CIP_WriteData (CN_USINT *buf, const ParsedTag *tag,
     buf = pack_UINT (buf, elements);
     memcpy (buf, raw_data, data_size);
 
-    if (EIP_verbosity >= 10)
+    if (EIP_verbose(10))
     {
         char buffer[EIP_MAX_TAG_LENGTH];
         EIP_copy_ParsedTag(buffer, tag);
@@ -1371,7 +1438,7 @@ eip_bool check_CIP_WriteData_Response (const CN_USINT *response,
     CN_USINT service = response[0];
     if ((service & 0x7F) != S_CIP_WriteData)
     {
-        if (EIP_verbosity >= 2)
+        if (EIP_verbose(2))
         {
             EIP_printf(2, "EIP: Expected Response to CIP_WriteData, got:\n");
             EIP_dump_raw_MR_Response(response, response_size);
@@ -1500,7 +1567,7 @@ eip_bool check_CIP_MultiRequest_Response (const CN_USINT *response,
     CN_USINT general_status = response[2];
     if (service == (S_CIP_MultiRequest|0x80)  &&  general_status == 0)
     {
-        if (EIP_verbosity >= 10)
+        if (EIP_verbose(10))
         {
             /* 0 -> show only MR_Response header, not embedded data */
             EIP_dump_raw_MR_Response(response, 0);
@@ -1512,6 +1579,29 @@ eip_bool check_CIP_MultiRequest_Response (const CN_USINT *response,
     return false;
 }
 
+/* Like check_CIP_MultiRequest_Response, but also accepts
+ * general status 0x1E where only some embedded requests failed.
+ * Caller then has to check each single response.
+ */
+eip_bool check_CIP_MultiRequest_Response_partial(const CN_USINT *response,
+                                                 size_t response_size)
+{
+    CN_USINT service        = response[0];
+    CN_USINT general_status = response[2];
+    if (service == (S_CIP_MultiRequest|0x80)  &&
+        (general_status == 0  ||  general_status == 0x1E))
+    {
+        if (EIP_verbose(10))
+        {
+            EIP_dump_raw_MR_Response(response, 0);
+            EIP_printf(0, "    %d subreplies:\n", response[4]);
+        }
+        return true;
+    }
+
+    return false;
+}
+
 void dump_CIP_MultiRequest_Response_Error(const CN_USINT *response,
                                           size_t response_size)
 {
@@ -1585,6 +1675,8 @@ const CN_USINT *get_CIP_MultiRequest_Response (const CN_USINT *response,
 /********************************************************
  * Connection: socket, connect, send/receive buffers, ...
  ********************************************************/
+#undef  EIP_LOG_SUBSYSTEM
+#define EIP_LOG_SUBSYSTEM EIP_LOG_TRANSPORT
 
 void EIP_dump_connection (const EIPConnection *c)
 {
@@ -1641,6 +1733,78 @@ static int connectWithTimeout (EIP_SOCKET s, const struct sockaddr *addr,
 
 #endif
 
+#ifdef EIP_KERNEL_TIMESTAMPS
+/* Ask kernel for software and, where the network interface supports it,
+ * hardware time stamps of sent and received data.
+ * Not fatal when unavailable, we just won't know the wire_time.
+ */
+static void enable_timestamping(EIPConnection *c)
+{
+    int flags = SOF_TIMESTAMPING_SOFTWARE     |
+                SOF_TIMESTAMPING_TX_SOFTWARE  |
+                SOF_TIMESTAMPING_RX_SOFTWARE  |
+                SOF_TIMESTAMPING_RAW_HARDWARE |
+                SOF_TIMESTAMPING_TX_HARDWARE  |
+                SOF_TIMESTAMPING_RX_HARDWARE;
+#ifdef SOF_TIMESTAMPING_OPT_TSONLY
+    flags |= SOF_TIMESTAMPING_OPT_TSONLY;
+#endif
+    c->timestamping = setsockopt(c->sock, SOL_SOCKET, SO_TIMESTAMPING,
+                                 (char *) &flags, sizeof(flags)) == 0;
+    if (! c->timestamping)
+        EIP_printf(5, "EIP kernel time stamps not available\n");
+}
+
+/* Get software resp. hardware time stamp from control messages,
+ * leaving them unchanged if there are none */
+static void get_timestamps(struct msghdr *msg,
+                           struct timespec *sw, struct timespec *hw)
+{
+    struct cmsghdr  *cmsg;
+    struct timespec *ts;
+
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET  ||
+            cmsg->cmsg_type != SCM_TIMESTAMPING)
+            continue;
+        ts = (struct timespec *) CMSG_DATA(cmsg);
+        if (ts[0].tv_sec || ts[0].tv_nsec)
+            *sw = ts[0];
+        if (ts[2].tv_sec || ts[2].tv_nsec)
+            *hw = ts[2];
+    }
+}
+
+/* Read time stamps of sent data from the socket's error queue */
+static void get_send_timestamps(EIPConnection *c,
+                                struct timespec *sw, struct timespec *hw)
+{
+    char          control[256];
+    struct msghdr msg;
+
+    while (true)
+    {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(c->sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+            break;
+        get_timestamps(&msg, sw, hw);
+    }
+}
+
+/* Seconds from start to end, 0 if either is unknown */
+static double timestamp_diff(const struct timespec *end,
+                             const struct timespec *start)
+{
+    if (!(end->tv_sec || end->tv_nsec)  ||  !(start->tv_sec || start->tv_nsec))
+        return 0.0;
+    return (double)(end->tv_sec - start->tv_sec)
+         + (end->tv_nsec - start->tv_nsec) * 1e-9;
+}
+#endif
+
 EIPConnection *EIP_init()
 {
     EIPConnection *c = (EIPConnection *) calloc(1, sizeof(EIPConnection));
@@ -1724,6 +1888,11 @@ eip_bool EIP_connect(EIPConnection *c,
     }
     EIP_printf (9, "EIP connected to %s:0x%04X on socket %d\n",
                 ip_addr, port, c->sock);
+    c->timestamping = false;
+    c->wire_time = 0.0;
+#ifdef EIP_KERNEL_TIMESTAMPS
+    enable_timestamping(c);
+#endif
     return true;
 }
 
@@ -1740,13 +1909,21 @@ eip_bool EIP_send_connection_buffer(EIPConnection *c)
     CN_UINT length;
     int     len;
     eip_bool ok;
+#ifdef EIP_KERNEL_TIMESTAMPS
+    struct timespec stale_sw, stale_hw;
 
+    if (c->timestamping) /* Forget time stamps of earlier requests */
+        get_send_timestamps(c, &stale_sw, &stale_hw);
+#endif
+    c->wire_time = 0.0;
     unpack_UINT(c->buffer+2, &length);
     len = sizeof_EncapsulationHeader + length;
     ok = send(c->sock, (void *)c->buffer, len, 0) == len;
+    EIP_TRACE3(send, c->sock, len, ok);
 
     EIP_printf(9, "Data sent (%d bytes):\n", len);
-    EIP_hexdump(9, c->buffer, len);
+    if (EIP_verbose(9))
+        EIP_hexdump(9, c->buffer, len);
 
     return ok;
 }
@@ -1769,6 +1946,17 @@ eip_bool EIP_read_connection_buffer(EIPConnection *c)
     fd_set fds;
     struct timeval timeout;
     CN_UINT length;
+#ifdef EIP_KERNEL_TIMESTAMPS
+    struct timespec tx_sw, tx_hw, rx_sw, rx_hw;
+    char            control[256];
+    struct msghdr   msg;
+    struct iovec    iov;
+
+    memset(&tx_sw, 0, sizeof(tx_sw));
+    memset(&tx_hw, 0, sizeof(tx_hw));
+    memset(&rx_sw, 0, sizeof(rx_sw));
+    memset(&rx_hw, 0, sizeof(rx_hw));
+#endif
 
     set_nonblock(c->sock, 1);
     do
@@ -1792,6 +1980,25 @@ eip_bool EIP_read_connection_buffer(EIPConnection *c)
          * Once the 'needed' message size is known, maybe
          * we should only read up to that message size?
          */
+#ifdef EIP_KERNEL_TIMESTAMPS
+        if (c->timestamping)
+        {   /* select() also reports time stamps in the error queue */
+            get_send_timestamps(c, &tx_sw, &tx_hw);
+            memset(&msg, 0, sizeof(msg));
+            iov.iov_base = (char *)c->buffer + got;
+            iov.iov_len = EIP_BUFFER_SIZE - got;
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            part = recvmsg(c->sock, &msg, 0);
+            if (part < 0  &&  EIP_SOCKERRNO == EIP_SOCK_EWOULDBLOCK)
+                continue;
+            if (part > 0  &&  got == 0) /* arrival of response */
+                get_timestamps(&msg, &rx_sw, &rx_hw);
+        }
+        else
+#endif
         part = recv(c->sock, ((char *)c->buffer + got), EIP_BUFFER_SIZE - got, 0);
         if (part <= 0)
         {
@@ -1819,9 +2026,22 @@ eip_bool EIP_read_connection_buffer(EIPConnection *c)
     }
     while (got < sizeof_EncapsulationHeader  ||  got < needed);
     set_nonblock (c->sock, 0);
+#ifdef EIP_KERNEL_TIMESTAMPS
+    if (ok  &&  c->timestamping)
+    {   /* Prefer hardware time stamps, but don't mix them with software */
+        get_send_timestamps(c, &tx_sw, &tx_hw);
+        c->wire_time = timestamp_diff(&rx_hw, &tx_hw);
+        if (c->wire_time <= 0.0)
+            c->wire_time = timestamp_diff(&rx_sw, &tx_sw);
+        if (c->wire_time < 0.0)
+            c->wire_time = 0.0;
+    }
+#endif
+    EIP_TRACE3(receive, c->sock, got, ok);
 
     EIP_printf(9, "Data Received (%d bytes):\n", got);
-    EIP_hexdump(9, c->buffer, got);
+    if (EIP_verbose(9))
+        EIP_hexdump(9, c->buffer, got);
 
     return ok;
 }
@@ -1918,7 +2138,7 @@ CN_USINT *make_EncapsulationHeader(EIPConnection *c, CN_UINT command,
     buf = pack_USINT(buf, 'f');
     buf = pack_USINT(buf, 'f');
     buf = pack_UDINT(buf, options);
-    if (EIP_verbosity >= 10)
+    if (EIP_verbose(10))
     {   /* 'header' used to get offset to server_context */
         EIP_printf(0, "EncapsulationHeader:\n");
         EIP_printf(0, "    UINT  command   = 0x%02X (%s)\n",
@@ -1938,25 +2158,16 @@ CN_USINT *make_EncapsulationHeader(EIPConnection *c, CN_UINT command,
 static const CN_USINT *unpack_EncapsulationHeader(const CN_USINT *buf,
                                                   EncapsulationHeader *header)
 {
-    const CN_USINT *next;
-    next = unpack(buf, "iiddssssssssd",
-                  &header->command,
-                  &header->length,
-                  &header->session,
-                  &header->status,
-                  &header->server_context[0],
-                  &header->server_context[1],
-                  &header->server_context[2],
-                  &header->server_context[3],
-                  &header->server_context[4],
-                  &header->server_context[5],
-                  &header->server_context[6],
-                  &header->server_context[7],
-                  &header->options);
-    if (EIP_verbosity >= 10)
+    buf = unpack_UINT(buf, &header->command);
+    buf = unpack_UINT(buf, &header->length);
+    buf = unpack_UDINT(buf, &header->session);
+    buf = unpack_UDINT(buf, &header->status);
+    memcpy(header->server_context, buf, 8);
+    buf = unpack_UDINT(buf + 8, &header->options);
+    if (EIP_verbose(10))
         dump_EncapsulationHeader(header);
 
-    return next;
+    return buf;
 }
 
 
@@ -2001,27 +2212,12 @@ static eip_bool EIP_list_services(EIPConnection *c)
     EIP_printf (10, "    UINT count     = %d\n", reply.count);
     for (i=0; i<reply.count; ++i)
     {
-        buf = unpack (buf, "iiiissssssssssssssss",
-                      &reply.service.type,
-                      &reply.service.length,
-                      &reply.service.version,
-                      &reply.service.flags,
-                      &reply.service.name[ 0],
-                      &reply.service.name[ 1],
-                      &reply.service.name[ 2],
-                      &reply.service.name[ 3],
-                      &reply.service.name[ 4],
-                      &reply.service.name[ 5],
-                      &reply.service.name[ 6],
-                      &reply.service.name[ 7],
-                      &reply.service.name[ 8],
-                      &reply.service.name[ 9],
-                      &reply.service.name[10],
-                      &reply.service.name[11],
-                      &reply.service.name[12],
-                      &reply.service.name[13],
-                      &reply.service.name[14],
-                      &reply.service.name[15]);
+        buf = unpack_UINT(buf, &reply.service.type);
+        buf = unpack_UINT(buf, &reply.service.length);
+        buf = unpack_UINT(buf, &reply.service.version);
+        buf = unpack_UINT(buf, &reply.service.flags);
+        memcpy(reply.service.name, buf, 16);
+        buf += 16;
 
         EIP_printf (10, "    UINT type     = 0x%04X\n",reply.service.type);
         EIP_printf (10, "    UINT length   = %d\n",    reply.service.length);
@@ -2073,7 +2269,7 @@ static eip_bool EIP_register_session(EIPConnection *c)
         data.header.status  != 0)
     {
         EIP_printf(2, "EIP register_session received error\n");
-        if (EIP_verbosity >= 3)
+        if (EIP_verbose(3))
             dump_EncapsulationHeader(&data.header);
         return false;
     }
@@ -2091,6 +2287,8 @@ static eip_bool EIP_unregister_session(EIPConnection *c)
                                     0, 0 /*length, options*/)
         && EIP_send_connection_buffer(c);
 }
+#undef  EIP_LOG_SUBSYSTEM
+#define EIP_LOG_SUBSYSTEM EIP_LOG_CODEC
 
 /* Decode IDs for "Common Packet Type"
  * (address and data IDs)
@@ -2157,14 +2355,13 @@ const CN_USINT *EIP_unpack_RRData (const CN_USINT *buf,
     next = unpack_EncapsulationHeader (buf, &data->header);
     if (! next)
         return 0;
-    next = unpack (next, "diiiiii",
-                   &data->interface_handle,
-                   &data->timeout,
-                   &data->count,
-                   &data->address_type,
-                   &data->address_length,
-                   &data->data_type,
-                   &data->data_length);
+    next = unpack_UDINT(next, &data->interface_handle);
+    next = unpack_UINT(next, &data->timeout);
+    next = unpack_UINT(next, &data->count);
+    next = unpack_UINT(next, &data->address_type);
+    next = unpack_UINT(next, &data->address_length);
+    next = unpack_UINT(next, &data->data_type);
+    next = unpack_UINT(next, &data->data_length);
 
     EIP_printf(10, "Received RR Data\n");
     EIP_printf(10, "    UDINT interface handle  %d\n", data->interface_handle);
@@ -2180,30 +2377,19 @@ const CN_USINT *EIP_unpack_RRData (const CN_USINT *buf,
     return next;
 }
 
-/* Send unconnected GetAttributeSingle service request to class/instance/attr
+/* Send request for Get_Attribute_Single that's already in the buffer,
+ * handle response.
  *
  * Result: ptr to data or 0,
  * len is set to length of data
  */
-void *EIP_Get_Attribute_Single(EIPConnection *c,
-                               CN_Classes cls, CN_USINT instance,
-                               CN_USINT attr, size_t *len)
+static void *get_Attribute_Single_response(EIPConnection *c, size_t *len)
 {
     EncapsulationRRData data;
-    size_t         path_size, request_size;
-    CN_USINT       *request, *path;
     const CN_USINT *response;
     CN_USINT       service, general_status;
     void           *attrib;
 
-    EIP_printf(10, "EIP Reading attribute\n");
-    path_size = CIA_path_size(cls, instance, attr);
-    request_size = MR_Request_size(path_size);
-    request = EIP_make_SendRRData(c, request_size);
-    if (! request)
-        return 0;
-    path = make_MR_Request(request, S_Get_Attribute_Single, path_size);
-    make_CIA_path(path, cls, instance, attr);
     if (! EIP_send_connection_buffer(c))
     {
         EIP_printf(2, "EIP_Get_Attribute_Single: send failed\n");
@@ -2216,22 +2402,99 @@ void *EIP_Get_Attribute_Single(EIPConnection *c,
     }
 
     response = EIP_unpack_RRData((CN_USINT *)c->buffer, &data);
-    unpack(response, "sSs", &service, &general_status);
+    service        = response[0];
+    general_status = response[2];
     if (service != (S_Get_Attribute_Single | 0x80)  ||
         general_status != 0)
     {
         EIP_printf(2, "EIP_Get_Attribute_Single: error in response\n");
-        if (EIP_verbosity >= 3)
+        if (EIP_verbose(3))
             EIP_dump_raw_MR_Response(response, data.data_length);
         return 0;
     }
 
     attrib = EIP_raw_MR_Response_data(response, data.data_length, len);
-    if (EIP_verbosity >= 10)
+    if (EIP_verbose(10))
         EIP_dump_raw_MR_Response(response, data.data_length);
     return attrib;
 }
 
+/* Send unconnected GetAttributeSingle service request to class/instance/attr
+ *
+ * Result: ptr to data or 0,
+ * len is set to length of data
+ */
+void *EIP_Get_Attribute_Single(EIPConnection *c,
+                               CN_Classes cls, CN_USINT instance,
+                               CN_USINT attr, size_t *len)
+{
+    size_t         path_size, request_size;
+    CN_USINT       *request, *path;
+
+    EIP_printf(10, "EIP Reading attribute\n");
+    path_size = CIA_path_size(cls, instance, attr);
+    request_size = MR_Request_size(path_size);
+    request = EIP_make_SendRRData(c, request_size);
+    if (! request)
+        return 0;
+    path = make_MR_Request(request, S_Get_Attribute_Single, path_size);
+    make_CIA_path(path, cls, instance, attr);
+    return get_Attribute_Single_response(c, len);
+}
+
+void *EIP_Get_PLC_Attribute_Single(EIPConnection *c,
+                                   CN_Classes cls, CN_USINT instance,
+                                   CN_USINT attr, size_t *len)
+{
+    size_t         path_size, request_size;
+    CN_USINT       *request, *path;
+
+    EIP_printf(10, "EIP Reading PLC attribute\n");
+    path_size = CIA_path_size(cls, instance, attr);
+    request_size = MR_Request_size(path_size);
+    request = EIP_make_SendRRData(c, CM_Unconnected_Send_size(request_size));
+    if (! request)
+        return 0;
+    request = make_CM_Unconnected_Send(request, request_size, c->slot);
+    if (! request)
+        return 0;
+    path = make_MR_Request(request, S_Get_Attribute_Single, path_size);
+    make_CIA_path(path, cls, instance, attr);
+    return get_Attribute_Single_response(c, len);
+}
+
+/* WallClockTime object, attribute 0x0B "CurrentValue":
+ * LINT, microseconds since 1970-01-01 00:00:00 UTC
+ */
+eip_bool EIP_read_PLC_wallclock(EIPConnection *c, double *usecs)
+{
+    const CN_USINT *data;
+    size_t         len;
+    CN_UDINT       low, high;
+
+    data = (const CN_USINT *)
+        EIP_Get_PLC_Attribute_Single(c, C_WallClockTime, 1, 0x0B, &len);
+    if (! (data  &&  len == 2*sizeof(CN_UDINT)))
+        return false;
+    data = unpack_UDINT(data, &low);
+    unpack_UDINT(data, &high);
+    *usecs = (double)high * 4294967296.0 + (double)low;
+    return true;
+}
+
+eip_bool EIP_read_PLC_status(EIPConnection *c, CN_UINT *status)
+{
+    const CN_USINT *data;
+    size_t         len;
+
+    data = (const CN_USINT *)
+        EIP_Get_PLC_Attribute_Single(c, C_Identity, 1, 5, &len);
+    if (! (data  &&  len == sizeof(CN_UINT)))
+        return false;
+    unpack_UINT(data, status);
+    return true;
+}
+
 static eip_bool EIP_check_interface(EIPConnection *c)
 {
     EIPIdentityInfo  *info = &c->info;
@@ -2275,6 +2538,9 @@ static eip_bool EIP_check_interface(EIPConnection *c)
     return true;
 }
 
+#undef  EIP_LOG_SUBSYSTEM
+#define EIP_LOG_SUBSYSTEM EIP_LOG_TRANSPORT
+
 eip_bool EIP_startup(EIPConnection *c,
                  const char *ip_addr, unsigned short port,
                  int slot,
@@ -2307,6 +2573,8 @@ void EIP_shutdown (EIPConnection *c)
    EIP_unregister_session (c);
    EIP_disconnect (c);
 }
+#undef  EIP_LOG_SUBSYSTEM
+#define EIP_LOG_SUBSYSTEM EIP_LOG_CODEC
 
 
 /* The connected methods:
@@ -2527,12 +2795,12 @@ static void dump_CM_Forward_Open_Response (const MR_Response *response,
     if (response->general_status != 0)
     {
         EIP_printf (2, "Error in dump_CM_Forward_Open_Response:\n");
-        if (EIP_verbosity >= 2)
+        if (EIP_verbose(2))
             EIP_dump_raw_MR_Response (response, response_size);
         return;
     }
 
-    if (EIP_verbosity >= 10)
+    if (EIP_verbose(10))
     {
         EIP_dump_raw_MR_Response (response, offsetof (MR_Response, response));
         data = (CM_Forward_Open_Good_Response *)
@@ -2678,7 +2946,7 @@ const CN_USINT *EIP_read_tag(EIPConnection *c,
     }
 
     response = EIP_unpack_RRData((CN_USINT *)c->buffer, &rr_data);
-    if (EIP_verbosity >= 10)
+    if (EIP_verbose(10))
         EIP_dump_raw_MR_Response(response, rr_data.data_length);
     data = check_CIP_ReadData_Response(response, rr_data.data_length,
                                        data_size);
@@ -2687,7 +2955,7 @@ const CN_USINT *EIP_read_tag(EIPConnection *c,
 
     if (! data)
     {
-        if (EIP_verbosity >= 1)
+        if (EIP_verbose(1))
         {
             char buffer[EIP_MAX_TAG_LENGTH];
             EIP_copy_ParsedTag(buffer, tag);
@@ -2695,7 +2963,7 @@ const CN_USINT *EIP_read_tag(EIPConnection *c,
         }
         return 0;
     }
-    if (EIP_verbosity >= 10)
+    if (EIP_verbose(10))
     {
         EIP_printf(10, "    Data =  ");
         dump_raw_CIP_data(data, elements);
@@ -2742,12 +3010,12 @@ eip_bool EIP_write_tag(EIPConnection *c, const ParsedTag *tag,
     }
 
     response = EIP_unpack_RRData((CN_USINT *)c->buffer, &rr_data);
-    if (EIP_verbosity >= 10)
+    if (EIP_verbose(10))
         EIP_dump_raw_MR_Response(response, rr_data.data_length);
 
     if (!check_CIP_WriteData_Response(response, rr_data.data_length))
     {
-        if (EIP_verbosity >= 1)
+        if (EIP_verbose(1))
         {
             char buffer[EIP_MAX_TAG_LENGTH];
             EIP_copy_ParsedTag(buffer, tag);
@@ -92,11 +92,21 @@ typedef int               EIP_SOCKET;
 #include <sys/filio.h>
 #endif
 
+/* Linux can time stamp network packets in the kernel */
+#ifdef __linux__
+#include <time.h>
+#include <linux/net_tstamp.h>
+#ifdef SO_TIMESTAMPING
+#define EIP_KERNEL_TIMESTAMPS
+#endif
+#endif
+
 /* end of Unix settings */
 #endif
 #endif
 
 #include "eip_bool.h"
+#include "eip_trace.h"
 
 /* This could be an application on its own...
  * Rough idea:
@@ -112,12 +122,86 @@ typedef int               EIP_SOCKET;
  */
 extern int EIP_verbosity;
 
-/* print if EIP_verbosity >= level */
+/* Messages above this level are not compiled,
+ * for example USR_CFLAGS += -DEIP_MAX_VERBOSITY=4
+ */
+#ifndef EIP_MAX_VERBOSITY
+#define EIP_MAX_VERBOSITY 10
+#endif
+
+/* Subsystems for EIP_log_subsystems */
+#define EIP_LOG_TRANSPORT 0x01  /* connection, send, receive */
+#define EIP_LOG_CODEC     0x02  /* CIP encoding and decoding */
+#define EIP_LOG_PLANNER   0x04  /* driver: scan lists, transfers */
+#define EIP_LOG_DEVICE    0x08  /* device support */
+#define EIP_LOG_ALL       0x0F
+
+/* Subsystem of EIP_printf calls in a source file,
+ * define before including this header
+ */
+#ifndef EIP_LOG_SUBSYSTEM
+#define EIP_LOG_SUBSYSTEM EIP_LOG_ALL
+#endif
+
+/* Mask of subsystems that may print, default: EIP_LOG_ALL */
+extern int EIP_log_subsystems;
+
+/* Highest verbosity of any thread, see EIP_log_thread_verbosity */
+extern int EIP_log_max_verbosity;
+
+/* Use 'level' instead of EIP_verbosity for messages of the calling
+ * thread, for example the scan task of one PLC. -1 to use EIP_verbosity.
+ * Caller also needs to maintain EIP_log_max_verbosity.
+ */
+void EIP_log_thread_verbosity(int level);
+
+/* Check subsystem mask and verbosity of calling thread */
+eip_bool EIP_log_enabled(int subsystem, int level);
+
+/* Would a message of subsystem and level print?
+ * Cheap test of the level first, so arguments of messages
+ * that don't print are never evaluated.
+ */
+#define EIP_log_on(subsystem, level)                                \
+    ((level) <= EIP_MAX_VERBOSITY  &&                               \
+     ((level) <= EIP_verbosity  ||  (level) <= EIP_log_max_verbosity)  && \
+     EIP_log_enabled(subsystem, level))
+
+/* Print unconditionally, with time stamp */
+void EIP_log_printf(const char *format, ...);
+void EIP_log_printf_time(const char *format, ...);
+
+/* print if EIP_verbosity >= level.
+ * The functions check the level and the calling thread, but
+ * cannot tell the subsystem of the caller: They are only
+ * quiet when EIP_log_subsystems disables all subsystems.
+ */
 void EIP_printf(int level, const char *format, ...);
 
 /* print with time stamp if EIP_verbosity >= level */
 void EIP_printf_time(int level, const char *format, ...);
 
+/* With C99 variadic macros, EIP_printf and EIP_printf_time
+ * check level and EIP_LOG_SUBSYSTEM before the arguments
+ * are evaluated. Older compilers and C++ call the functions.
+ */
+#if defined(__STDC_VERSION__)  &&  __STDC_VERSION__ >= 199901L
+#define EIP_log(subsystem, level, ...)                              \
+    do { if (EIP_log_on(subsystem, level))                          \
+            EIP_log_printf(__VA_ARGS__); } while (0)
+#define EIP_log_time(subsystem, level, ...)                         \
+    do { if (EIP_log_on(subsystem, level))                          \
+            EIP_log_printf_time(__VA_ARGS__); } while (0)
+
+#define EIP_printf(level, ...) \
+    EIP_log(EIP_LOG_SUBSYSTEM, level, __VA_ARGS__)
+#define EIP_printf_time(level, ...) \
+    EIP_log_time(EIP_LOG_SUBSYSTEM, level, __VA_ARGS__)
+#endif
+
+/* EIP_verbosity >= level, considering subsystem and thread */
+#define EIP_verbose(level) EIP_log_on(EIP_LOG_SUBSYSTEM, level)
+
 void EIP_hexdump(int level, const void *_data, int len);
 
 /* There is a limit for the PLC transfer buffer.
@@ -208,7 +292,8 @@ typedef enum
 {
     C_Identity             = 0x01,
     C_MessageRouter        = 0x02,
-    C_ConnectionManager    = 0x06
+    C_ConnectionManager    = 0x06,
+    C_WallClockTime        = 0x8B   /* Logix controller */
 }   CN_Classes;
 
 /********************************************************
@@ -403,6 +488,7 @@ typedef enum
     T_CIP_SINT   = 0x00C2,
     T_CIP_INT    = 0x00C3,
     T_CIP_DINT   = 0x00C4,
+    T_CIP_LINT   = 0x00C5,
     T_CIP_REAL   = 0x00CA,
     T_CIP_BITS   = 0x00D3,
     T_CIP_STRUCT = 0x02A0
@@ -440,12 +526,16 @@ ParsedTag *EIP_parse_tag(const char *tag);
 void EIP_copy_ParsedTag(char *buffer, const ParsedTag *tag);
 void EIP_free_ParsedTag(ParsedTag *tag);
 
+size_t CIP_ReadData_size(const ParsedTag *tag);
 CN_USINT *make_CIP_ReadData(CN_USINT *request,
                             const ParsedTag *tag, size_t elements);
 const CN_USINT *check_CIP_ReadData_Response(const CN_USINT *response,
                                             size_t response_size,
                                             size_t *data_size);
 
+/* Size of CIP WriteData request for tag and raw data (w/o type) */
+size_t CIP_WriteData_size(const ParsedTag *tag, size_t data_size);
+
 /* Fill buffer with CIP WriteData request
  * for tag, type of CIP data, given number of elements.
  * Also copies data into buffer,
@@ -469,6 +559,8 @@ CN_USINT *CIP_MultiRequest_item(CN_USINT *request,
 
 eip_bool check_CIP_MultiRequest_Response(const CN_USINT *response,
                                      size_t response_size);
+eip_bool check_CIP_MultiRequest_Response_partial(const CN_USINT *response,
+                                                 size_t response_size);
 void dump_CIP_MultiRequest_Response_Error(const CN_USINT *response,
                                           size_t response_size);
 const CN_USINT *get_CIP_MultiRequest_Response(const CN_USINT *response,
@@ -486,6 +578,18 @@ eip_bool get_CIP_DINT(const CN_USINT *raw_type_and_data,
                   size_t element, CN_DINT *result);
 eip_bool get_CIP_USINT(const CN_USINT *raw_type_and_data,
                        size_t element, CN_USINT *result);
+/* Get 'count' elements, starting at 'element'.
+ * The type is checked once, not per element */
+eip_bool get_CIP_double_array(const CN_USINT *raw_type_and_data,
+                              size_t element, size_t count, double *result);
+eip_bool get_CIP_DINT_array(const CN_USINT *raw_type_and_data,
+                            size_t element, size_t count, CN_DINT *result);
+eip_bool get_CIP_USINT_array(const CN_USINT *raw_type_and_data,
+                             size_t element, size_t count, CN_USINT *result);
+/* Get LINT, or DINT[2] with the low word first, as double.
+ * Exact up to 2^53, which is enough for microsecond time stamps */
+eip_bool get_CIP_LINT_double(const CN_USINT *raw_type_and_data,
+                             double *result);
 /* Fill buffer with up to 'size' characters (incl. ending '\0').
  * Return true for success */
 eip_bool get_CIP_STRING(const CN_USINT *raw_type_and_data,
@@ -644,6 +748,9 @@ typedef struct
     size_t                  millisec_timeout; /* .. for socket calls */
     CN_UDINT                session;    /* session ID, generated by target */
     CN_USINT                *buffer;    /* buffer for read/write, EIP_BUFFER_SIZE */
+    eip_bool                timestamping; /* kernel time stamps enabled? */
+    double                  wire_time;  /* last request..response per kernel
+                                         * time stamps [secs], 0 if unknown */
     EIPIdentityInfo         info;
     EIPConnectionParameters params;
 }   EIPConnection;
@@ -716,4 +823,19 @@ void *EIP_Get_Attribute_Single(EIPConnection *c,
                                CN_Classes cls, CN_USINT instance,
                                CN_USINT attr, size_t *len);
 
+/* Like EIP_Get_Attribute_Single, but sent via Unconnected_Send
+ * to the controller in the connection's slot instead of the ENET
+ */
+void *EIP_Get_PLC_Attribute_Single(EIPConnection *c,
+                                   CN_Classes cls, CN_USINT instance,
+                                   CN_USINT attr, size_t *len);
+
+/* Read controller's wall clock: microseconds since 1970 (UTC) */
+eip_bool EIP_read_PLC_wallclock(EIPConnection *c, double *usecs);
+
+/* Read Identity status of the controller (not the ENET module).
+ * Changes e.g. when the controller is put into program mode
+ * for a download */
+eip_bool EIP_read_PLC_status(EIPConnection *c, CN_UINT *status);
+
 /* EOF ether_ip.h */
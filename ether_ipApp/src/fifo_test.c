@@ -0,0 +1,56 @@
+/* fifo_test.c
+ *
+ * Unit test for the FIFO index arithmetic of drvEtherIP:
+ * Ring index that wraps within the buffer, free-running counter,
+ * overruns.
+ */
+#include <string.h>
+#include <epicsUnitTest.h>
+#include <testMain.h>
+#include "drvEtherIP.h"
+
+/* Simulate scans where the PLC's index is 'index',
+ * assuming each read gets all pending elements
+ */
+static CN_UDINT scan(EIPFifo *fifo, CN_UDINT index)
+{
+    CN_UDINT count;
+
+    if (! drvEtherIP_fifo_pending(fifo, index, &count))
+        return (CN_UDINT) -1;
+    drvEtherIP_fifo_advance(fifo, index, count);
+    return count;
+}
+
+MAIN(fifo_test)
+{
+    EIPFifo fifo;
+    int     i;
+
+    testPlan(13);
+
+    memset(&fifo, 0, sizeof(fifo));
+    fifo.size = 100;
+    fifo.next = 90;
+    testOk(scan(&fifo, 95) == 5, "ring: 5 new elements");
+    testOk(scan(&fifo, 5) == 10, "ring: 10 elements across the wrap");
+    testOk(fifo.next == 5, "ring: next wrapped to 5");
+    testOk(scan(&fifo, 5) == 0, "ring: nothing new");
+    testOk(scan(&fifo, 4) == 99, "ring: 99 elements, almost full turn");
+    for (i=0; i<5; ++i)
+        scan(&fifo, (fifo.next + 60) % 100);
+    testOk(fifo.next < fifo.size, "ring: next stays within ring");
+    testOk(fifo.overruns == 0, "ring: no overruns counted");
+
+    memset(&fifo, 0, sizeof(fifo));
+    fifo.size = 100;
+    fifo.next = 95;
+    testOk(scan(&fifo, 99) == 4, "counter below size: handled as ring");
+    testOk(scan(&fifo, 105) == 6, "counter passes size");
+    testOk(fifo.next == 105, "counter: next follows counter");
+    testOk(scan(&fifo, 355) == 100, "counter: read at most one buffer");
+    testOk(fifo.overruns == 150, "counter: 150 elements lost");
+    testOk(scan(&fifo, 200) == (CN_UDINT) -1, "counter went backwards");
+
+    return testDone();
+}